@@ -9,6 +9,7 @@
 #include <thread>
 #include <iostream>
 #include <fstream>
+#include <string>
 
 #include <nlohmann/json.hpp>
 #include "utils/zipfian_int_distribution.hpp"
@@ -19,7 +20,9 @@
 #include "../lib/BTree/coro_btree_olc.h"
 #include "../lib/BTree/coro_btree_olc_optimized.h"
 #include "../lib/BTree/coro_lines_btree_olc.h"
+#include "../lib/BTree/coro_interpolation_btree_olc.h"
 #include "../lib/BTree/btree_vectorized_helper.h"
+#include "../lib/BTree/olc_stats.h"
 #include "numa/numa_memory_resource_no_jemalloc.hpp"
 #include "../lib/utils/simple_continuous_allocator.hpp"
 #include "../../config.hpp"
@@ -28,6 +31,8 @@ uintptr_t SWPrefetcher::reliability_mask = 0;
 struct BTreeBenchmarkConfig
 {
     size_t tree_node_size;
+    size_t inner_node_size;
+    size_t leaf_node_size;
     size_t num_threads;
     size_t coroutines;
     size_t num_lookups;
@@ -60,6 +65,17 @@ void log_system_resources()
     }
 }
 
+nlohmann::json olc_stats_to_json(const btreeolc::stats::OLCStats &stats)
+{
+    return nlohmann::json{
+        {"restarts", stats.restarts()},
+        {"restarts_per_level", stats.restarts_per_level},
+        {"upgrade_failures", stats.upgrade_failures},
+        {"pause_spins", stats.pause_spins},
+        {"inner_splits", stats.inner_splits},
+        {"leaf_splits", stats.leaf_splits}};
+}
+
 template <typename BTree>
 void build_tree(
     unsigned thread_id, const size_t offset, const size_t inserts_per_thread, const BTreeBenchmarkConfig &config,
@@ -81,6 +97,7 @@ void build_tree(
         {
             vec_insert(offset, offset + inserts_per_thread, btree, kv_pairs);
         }
+        btreeolc::stats::flush();
     }
     catch (const std::exception &e)
     {
@@ -125,6 +142,7 @@ void benchmark_btree_lookups(
         {
             vectorized_get<BTree>(offset, offset + lookups_per_thread, btree, kv_pairs);
         }
+        btreeolc::stats::flush();
         if (config.profile)
         {
             event_counter.stop(thread_id);
@@ -159,6 +177,7 @@ void benchmark_wrapper(BTreeBenchmarkConfig &config, nlohmann::json &results)
 
     SWPrefetcher::reliability_mask = (config.reliability) ? uintptr_t(1) << 60 : 0;
     BTree btree{allocator};
+    btreeolc::stats::reset();
 
     auto start_build = std::chrono::high_resolution_clock::now();
     size_t build_threads = 16;
@@ -187,6 +206,11 @@ void benchmark_wrapper(BTreeBenchmarkConfig &config, nlohmann::json &results)
     auto end_build = std::chrono::high_resolution_clock::now();
     auto build_runtime = std::chrono::duration<double>(end_build - start_build).count();
     results["build_runtime"] = build_runtime;
+    if constexpr (btreeolc::stats::enabled)
+    {
+        results["olc"]["build"] = olc_stats_to_json(btreeolc::stats::collect());
+        btreeolc::stats::reset();
+    }
 
     //       === LOOKUP PHASE ===
 
@@ -248,20 +272,25 @@ void benchmark_wrapper(BTreeBenchmarkConfig &config, nlohmann::json &results)
         durations[measurement_id] = lookup_runtime;
     }
     generate_stats(results, durations, "lookup_");
-    std::cout << config.BTree_variant << ";" << config.tree_node_size << "B;" << config.key_distribution << " lookup took: " << results["lookup_runtime"] << " seconds" << std::endl;
+    if constexpr (btreeolc::stats::enabled)
+    {
+        // accumulated over all repetitions of the lookup measurement
+        results["olc"]["lookup"] = olc_stats_to_json(btreeolc::stats::collect());
+    }
+    std::cout << config.BTree_variant << ";" << config.inner_node_size << "B/" << config.leaf_node_size << "B;" << config.key_distribution << " lookup took: " << results["lookup_runtime"] << " seconds" << std::endl;
 }
 
-template <const size_t node_size>
+template <const size_t inner_node_size, const size_t leaf_node_size>
 void run_benchmark_cacheline_size(BTreeBenchmarkConfig &config, nlohmann::json &results)
 {
     const size_t cache_line_size = get_cache_line_size();
     if (cache_line_size == 64)
     {
-        run_benchmark_variant<node_size, 64>(config, results);
+        run_benchmark_variant<inner_node_size, leaf_node_size, 64>(config, results);
     }
     else if (cache_line_size == 256)
     {
-        run_benchmark_variant<node_size, 256>(config, results);
+        run_benchmark_variant<inner_node_size, leaf_node_size, 256>(config, results);
     }
     else
     {
@@ -269,29 +298,33 @@ void run_benchmark_cacheline_size(BTreeBenchmarkConfig &config, nlohmann::json &
     }
 }
 
-template <const size_t node_size, const size_t cache_line_size>
+template <const size_t inner_node_size, const size_t leaf_node_size, const size_t cache_line_size>
 void run_benchmark_variant(BTreeBenchmarkConfig &config, nlohmann::json &results)
 {
     const uintptr_t reliability_mask = (config.reliability) ? uintptr_t(1) << 60 : 0;
     if (config.BTree_variant == "normal")
     {
-        benchmark_wrapper<btreeolc::BTree<std::uint64_t, std::uint64_t, node_size>>(config, results);
+        benchmark_wrapper<btreeolc::BTree<std::uint64_t, std::uint64_t, inner_node_size, leaf_node_size>>(config, results);
     }
     else if (config.BTree_variant == "coro_full_node")
     {
-        benchmark_wrapper<btreeolc::coro_base::BTree<std::uint64_t, std::uint64_t, node_size, cache_line_size>>(config, results);
+        benchmark_wrapper<btreeolc::coro_base::BTree<std::uint64_t, std::uint64_t, inner_node_size, leaf_node_size, cache_line_size>>(config, results);
     }
     else if (config.BTree_variant == "coro_half_node")
     {
-        benchmark_wrapper<btreeolc::coro::BTree<std::uint64_t, std::uint64_t, node_size, cache_line_size>>(config, results);
+        benchmark_wrapper<btreeolc::coro::BTree<std::uint64_t, std::uint64_t, inner_node_size, leaf_node_size, cache_line_size>>(config, results);
     }
     else if (config.BTree_variant == "coro_half_node_optimized")
     {
-        benchmark_wrapper<btreeolc::coro_optimized::BTree<std::uint64_t, std::uint64_t, node_size, cache_line_size>>(config, results);
+        benchmark_wrapper<btreeolc::coro_optimized::BTree<std::uint64_t, std::uint64_t, inner_node_size, leaf_node_size, cache_line_size>>(config, results);
     }
     else if (config.BTree_variant == "coro_lines_node")
     {
-        benchmark_wrapper<btreeolc::coro_lines::BTree<std::uint64_t, std::uint64_t, node_size, cache_line_size>>(config, results);
+        benchmark_wrapper<btreeolc::coro_lines::BTree<std::uint64_t, std::uint64_t, inner_node_size, leaf_node_size, cache_line_size>>(config, results);
+    }
+    else if (config.BTree_variant == "coro_interpolation_node")
+    {
+        benchmark_wrapper<btreeolc::coro_interpolation::BTree<std::uint64_t, std::uint64_t, inner_node_size, leaf_node_size, cache_line_size>>(config, results);
     }
     else
     {
@@ -299,6 +332,46 @@ void run_benchmark_variant(BTreeBenchmarkConfig &config, nlohmann::json &results
     }
 }
 
+// A list of node sizes that are dispatched to, and listed in the error message for any other size.
+template <const size_t... sizes>
+struct NodeSizes
+{
+    static std::string to_string()
+    {
+        std::string list;
+        ((list += (list.empty() ? "" : ", ") + std::to_string(sizes)), ...);
+        return list;
+    }
+};
+
+using EqualNodeSizes = NodeSizes<128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536, 131072>;
+#if defined(BTREE_MIXED_NODE_SIZES)
+// Every combination instantiates all BTree variants and multiplies the compile time, so differing inner and leaf node
+// sizes are limited to this grid and only built with cmake -DBTREE_MIXED_NODE_SIZES=ON.
+using InnerNodeSizes = NodeSizes<256, 512, 1024, 2048, 4096>;
+using LeafNodeSizes = NodeSizes<256, 512, 1024, 2048, 4096, 16384, 65536>;
+#endif
+
+template <const size_t... node_sizes>
+bool run_benchmark_equal_node_sizes(BTreeBenchmarkConfig &config, nlohmann::json &results, NodeSizes<node_sizes...>)
+{
+    return ((config.inner_node_size == node_sizes && (run_benchmark_cacheline_size<node_sizes, node_sizes>(config, results), true)) || ...);
+}
+
+#if defined(BTREE_MIXED_NODE_SIZES)
+template <const size_t inner_node_size, const size_t... leaf_node_sizes>
+bool run_benchmark_leaf_node_size(BTreeBenchmarkConfig &config, nlohmann::json &results, NodeSizes<leaf_node_sizes...>)
+{
+    return ((config.leaf_node_size == leaf_node_sizes && (run_benchmark_cacheline_size<inner_node_size, leaf_node_sizes>(config, results), true)) || ...);
+}
+
+template <const size_t... inner_node_sizes>
+bool run_benchmark_node_sizes(BTreeBenchmarkConfig &config, nlohmann::json &results, NodeSizes<inner_node_sizes...>)
+{
+    return ((config.inner_node_size == inner_node_sizes && run_benchmark_leaf_node_size<inner_node_sizes>(config, results, LeafNodeSizes{})) || ...);
+}
+#endif
+
 int main(int argc, char **argv)
 {
     auto &benchmark_config = Prefetching::get().runtime_config;
@@ -307,7 +380,9 @@ int main(int argc, char **argv)
 
     // clang-format off
     benchmark_config.add_options()
-        ("tree_node_size", "Tree Node size in Bytes", cxxopts::value<std::vector<size_t>>()->default_value("512"))
+        ("tree_node_size", "Tree Node size in Bytes, used for inner and leaf nodes unless set separately", cxxopts::value<std::vector<size_t>>()->default_value("512"))
+        ("inner_node_size", "Inner node size in Bytes (0 -> tree_node_size)", cxxopts::value<std::vector<size_t>>()->default_value("0"))
+        ("leaf_node_size", "Leaf node size in Bytes (0 -> tree_node_size)", cxxopts::value<std::vector<size_t>>()->default_value("0"))
         ("num_threads", "Number of num_threads", cxxopts::value<std::vector<size_t>>()->default_value("1"))
         ("num_lookups", "Number of lookups", cxxopts::value<std::vector<size_t>>()->default_value("5000000"))
         ("num_elements", "Number of elements to fill the BTree with", cxxopts::value<std::vector<size_t>>()->default_value("50000000"))
@@ -316,7 +391,7 @@ int main(int argc, char **argv)
         ("run_remote_memory", "Attempts to load remote memory NumaSetting from config.", cxxopts::value<std::vector<bool>>()->default_value("true,false"))
         ("run_on_node", "Which NUMA node to run the benchmark on.", cxxopts::value<std::vector<NodeID>>()->default_value("0"))
         ("alloc_on_node", "Which NUMA node to alloc memory on.", cxxopts::value<std::vector<NodeID>>()->default_value("0"))
-        ("btree_variant", "Which BTree to use (normal,coro_full_node,coro_half_node,coro_half_node_optimized,coro_lines_node)", cxxopts::value<std::vector<std::string>>()->default_value("normal,coro_full_node,coro_half_node,coro_lines_node"))
+        ("btree_variant", "Which BTree to use (normal,coro_full_node,coro_half_node,coro_half_node_optimized,coro_lines_node,coro_interpolation_node)", cxxopts::value<std::vector<std::string>>()->default_value("normal,coro_full_node,coro_half_node,coro_lines_node"))
         ("key_distribution", "Kind of key distribution used for lookups (uniform, zip)", cxxopts::value<std::vector<std::string>>()->default_value("uniform"))
         ("use_explicit_huge_pages", "Use huge pages during allocation", cxxopts::value<std::vector<bool>>()->default_value("false"))
         ("madvise_huge_pages", "Madvise kernel to create huge pages on mem regions", cxxopts::value<std::vector<bool>>()->default_value("true"))
@@ -331,6 +406,8 @@ int main(int argc, char **argv)
     for (auto &runtime_config : benchmark_config.get_runtime_configs())
     {
         auto tree_node_size = convert<size_t>(runtime_config["tree_node_size"]);
+        auto inner_node_size = convert<size_t>(runtime_config["inner_node_size"]);
+        auto leaf_node_size = convert<size_t>(runtime_config["leaf_node_size"]);
         auto num_threads = convert<size_t>(runtime_config["num_threads"]);
         auto coroutines = convert<size_t>(runtime_config["coroutines"]);
         auto num_lookups = convert<size_t>(runtime_config["num_lookups"]);
@@ -371,10 +448,20 @@ int main(int argc, char **argv)
         {
             repeat_lookup_measurement = 1;
         }
+        if (inner_node_size == 0)
+        {
+            inner_node_size = tree_node_size;
+        }
+        if (leaf_node_size == 0)
+        {
+            leaf_node_size = tree_node_size;
+        }
 
         BTreeBenchmarkConfig config =
             {
                 tree_node_size,
+                inner_node_size,
+                leaf_node_size,
                 num_threads,
                 coroutines,
                 num_lookups,
@@ -393,6 +480,8 @@ int main(int argc, char **argv)
 
         nlohmann::json results;
         results["config"]["tree_node_size"] = config.tree_node_size;
+        results["config"]["inner_node_size"] = config.inner_node_size;
+        results["config"]["leaf_node_size"] = config.leaf_node_size;
         results["config"]["num_threads"] = config.num_threads;
         results["config"]["coroutines"] = config.coroutines;
         results["config"]["num_lookups"] = config.num_lookups;
@@ -408,44 +497,20 @@ int main(int argc, char **argv)
         results["config"]["reliability"] = config.reliability;
         results["config"]["profile"] = config.profile;
 
-        switch (config.tree_node_size)
+        if (config.inner_node_size != config.leaf_node_size)
+        {
+#if defined(BTREE_MIXED_NODE_SIZES)
+            if (!run_benchmark_node_sizes(config, results, InnerNodeSizes{}))
+            {
+                std::cerr << "Invalid inner_node_size/leaf_node_size combination: " << config.inner_node_size << "/" << config.leaf_node_size << ". Valid inner sizes are " << InnerNodeSizes::to_string() << ", valid leaf sizes " << LeafNodeSizes::to_string() << "." << std::endl;
+            }
+#else
+            std::cerr << "Differing inner_node_size/leaf_node_size (" << config.inner_node_size << "/" << config.leaf_node_size << ") need a build with cmake -DBTREE_MIXED_NODE_SIZES=ON." << std::endl;
+#endif
+        }
+        else if (!run_benchmark_equal_node_sizes(config, results, EqualNodeSizes{}))
         {
-        case 128:
-            run_benchmark_cacheline_size<128>(config, results);
-            break;
-        case 256:
-            run_benchmark_cacheline_size<256>(config, results);
-            break;
-        case 512:
-            run_benchmark_cacheline_size<512>(config, results);
-            break;
-        case 1024:
-            run_benchmark_cacheline_size<1024>(config, results);
-            break;
-        case 2048:
-            run_benchmark_cacheline_size<2048>(config, results);
-            break;
-        case 4096:
-            run_benchmark_cacheline_size<4096>(config, results);
-            break;
-        case 8192:
-            run_benchmark_cacheline_size<8192>(config, results);
-            break;
-        case 16384:
-            run_benchmark_cacheline_size<16384>(config, results);
-            break;
-        case 32768:
-            run_benchmark_cacheline_size<32768>(config, results);
-            break;
-        case 65536:
-            run_benchmark_cacheline_size<65536>(config, results);
-            break;
-        case 131072:
-            run_benchmark_cacheline_size<131072>(config, results);
-            break;
-        default:
-            std::cerr << "Invalid tree_node_size: " << config.tree_node_size << ". Valid sizes are 256, 512, 1024, 4096, 8192, 16384, and 32768." << std::endl;
-            break;
+            std::cerr << "Invalid node size: " << config.inner_node_size << ". Valid sizes are " << EqualNodeSizes::to_string() << "." << std::endl;
         }
 
         nlohmann::json output_json;
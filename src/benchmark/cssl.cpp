@@ -16,12 +16,18 @@
 
 #include <stdio.h>
 #include <algorithm>
+#include <atomic>
 #include <random>
 #include <string.h>
 #include <sys/resource.h>
 #include <sys/time.h>
+#include <thread>
 
+#include "prefetching.hpp"
 #include "../lib/skiplist.hpp"
+#include "../lib/cssl_skiplist.hpp"
+#include "numa/numa_memory_resource_no_jemalloc.hpp"
+#include "../lib/utils/simple_continuous_allocator.hpp"
 
 static double gettime(void)
 {
@@ -38,16 +44,32 @@ int compare_ints(const void *a, const void *b)
   return (*da > *db) - (*da < *db);
 }
 
+static void pin_to_node(NodeID node)
+{
+  auto &cpus = Prefetching::get().numa_manager.node_to_available_cpus[node];
+  if (cpus.size() > 0)
+    pin_to_cpus(cpus);
+}
+
 int main(int argc, const char *argv[])
 {
-  if (argc != 4)
+  if (argc < 4 || argc > 7)
   {
-    printf("Usage: %s num_elements 0|1 (0=dense, 1=sparse)\n", argv[0]);
+    printf("Usage: %s num_elements 0|1 (0=dense, 1=sparse) 0-6 (0=prefetched, 1=plain, 2=gp, 3=amac, 4=coroutine, 5=templated 64 bit, 6=concurrent inserts) [group_size] [run_on_node] [alloc_on_node]\n", argv[0]);
     return 1;
   }
 
   uint16_t use_prefetched = atoi(argv[3]);
-  _CSSL_SkipList *slist = createSkipList(12, 5);
+  // at least one lookup per group, GP batches of 0 keys would never advance
+  uint32_t group_size = std::max(1, (argc >= 5) ? atoi(argv[4]) : 32);
+  NodeID run_on_node = (argc >= 6) ? atoi(argv[5]) : 0;
+  NodeID alloc_on_node = (argc >= 7) ? atoi(argv[6]) : 0;
+
+  // nodes are bump-allocated on transparent huge pages of alloc_on_node, the lanes are placed there by first touch
+  pin_to_node(alloc_on_node);
+  NumaMemoryResourceNoJemalloc mem_res{alloc_on_node, false, true};
+  SimpleContinuousAllocator allocator(mem_res, 2048l * (1 << 20), 512l * (1 << 20));
+  _CSSL_SkipList *slist = createSkipList(12, 5, &allocator);
   uint32_t n = atoi(argv[1]);
   uint32_t *keys = reinterpret_cast<uint32_t *>(malloc(sizeof(uint32_t) * n));
 
@@ -73,6 +95,7 @@ int main(int argc, const char *argv[])
   for (uint32_t i = 0; i < n; i++)
     insertElement(slist, keys[i]);
   printf("Insertion: %d ops/s.\n", (int)(n / (gettime() - start)));
+  pin_to_node(run_on_node);
 
   // Execute a large amount of single-key lookups using random search keys
   std::shuffle(keys, keys + n, gen);
@@ -81,7 +104,137 @@ int main(int argc, const char *argv[])
   if (repeat < 1)
     repeat = 1;
 
-  if (use_prefetched)
+  if (use_prefetched == 5)
+  {
+    // templated list with the keys in the upper half of 64 bit keys and the original key as payload
+    pin_to_node(alloc_on_node);
+    CSSLSkipList<uint64_t, uint32_t> tlist(12, 5, allocator);
+    std::vector<uint64_t> wide_keys(keys, keys + n);
+    std::sort(wide_keys.begin(), wide_keys.end());
+    wide_keys.erase(std::unique(wide_keys.begin(), wide_keys.end()), wide_keys.end());
+    start = gettime();
+    for (uint64_t key : wide_keys)
+      tlist.insert(key << 32, static_cast<uint32_t>(key));
+    printf("Insertion64: %d ops/s.\n", (int)(wide_keys.size() / (gettime() - start)));
+    pin_to_node(run_on_node);
+
+    start = gettime();
+    volatile uint32_t dummy = 0;
+    for (uint16_t r = 0; r < repeat; r++)
+    {
+      for (uint32_t i = 0; i < done_requests; i++)
+      {
+        dummy = dummy + *tlist.find(static_cast<uint64_t>(keys[i] + dummy) << 32);
+        dummy = dummy - keys[i];
+        assert(dummy == 0);
+      }
+    }
+    printf("Lookup64:    %d ops/s.\n", (int)(done_requests * repeat / (gettime() - start)));
+  }
+  else if (use_prefetched == 6)
+  {
+    // half of the keys are loaded, then a writer inserts the other half while lookups of the loaded half run
+    // the builder returns the chunks of replaced snapshots, so the list allocates from mem_res directly
+    pin_to_node(alloc_on_node);
+    _CSSL_ConcurrentSkipList *clist = createConcurrentSkipList(12, 5, std::max(n / 100, 1024u), &mem_res);
+    const uint32_t loaded = n / 2;
+    for (uint32_t i = 0; i < loaded; i++)
+      insertElementConcurrent(clist, keys[i]);
+    pin_to_node(run_on_node);
+
+    // lookups on the loaded keys in batches of 1024 that share acquired fast lanes
+    auto lookup_batches = [&](uint32_t num_batches) {
+      const uint32_t batch_size = std::min(1024u, loaded);
+      for (uint32_t b = 0; b < num_batches; b++)
+      {
+        uint32_t epoch;
+        _CSSL_SkipList *lanes = acquireFastLanes(clist, &epoch);
+        uint32_t first = (b * batch_size) % (loaded - batch_size + 1);
+        for (uint32_t i = first; i < first + batch_size; i++)
+        {
+          if (searchElementConcurrent(clist, lanes, keys[i]) != keys[i])
+          {
+            printf("concurrent lookup missed a loaded key.\n");
+            exit(1);
+          }
+        }
+        releaseFastLanes(clist, epoch);
+      }
+      return (uint64_t)num_batches * batch_size;
+    };
+
+    start = gettime();
+    uint64_t lookups = lookup_batches(std::max(done_requests / 1024, 1u));
+    printf("LookupConcurrent:    %d ops/s. (no inserts)\n", (int)(lookups / (gettime() - start)));
+
+    std::atomic<bool> inserting = true;
+    double insert_time = 0;
+    std::thread writer([&]() {
+      double insert_start = gettime();
+      for (uint32_t i = loaded; i < n; i++)
+        insertElementConcurrent(clist, keys[i]);
+      insert_time = gettime() - insert_start;
+      inserting = false;
+    });
+    lookups = 0;
+    start = gettime();
+    while (inserting)
+      lookups += lookup_batches(16);
+    double lookup_time = gettime() - start;
+    writer.join();
+    printf("LookupConcurrent:    %d ops/s. (during %d inserts/s)\n", (int)(lookups / lookup_time),
+           (int)((n - loaded) / insert_time));
+
+    uint32_t epoch;
+    _CSSL_SkipList *lanes = acquireFastLanes(clist, &epoch);
+    for (uint32_t i = 0; i < n; i++)
+    {
+      if (searchElementConcurrent(clist, lanes, keys[i]) != keys[i])
+      {
+        printf("concurrent insert lost a key.\n");
+        return 1;
+      }
+    }
+    releaseFastLanes(clist, epoch);
+    destroyConcurrentSkipList(clist);
+  }
+  else if (use_prefetched >= 2)
+  {
+    // batched lookups, results are checked after the timed section
+    const uint32_t batch_size = 1024;
+    uint32_t *results = reinterpret_cast<uint32_t *>(malloc(sizeof(uint32_t) * done_requests));
+    start = gettime();
+    for (uint16_t r = 0; r < repeat; r++)
+    {
+      for (uint32_t i = 0; i < done_requests; i += batch_size)
+      {
+        uint32_t count = std::min(batch_size, done_requests - i);
+        if (use_prefetched == 2)
+        {
+          // group prefetching advances the whole batch in lockstep, so its batch is one group
+          for (uint32_t g = 0; g < count; g += group_size)
+            searchElementsGP(slist, keys + i + g, results + i + g, std::min(group_size, count - g));
+        }
+        else if (use_prefetched == 3)
+          searchElementsAMAC(slist, keys + i, results + i, count, group_size);
+        else
+          searchElementsCoroutine(slist, keys + i, results + i, count, group_size);
+      }
+    }
+    const char *names[] = {"LookupGP", "LookupAMAC", "LookupCoroutine"};
+    printf("%s:    %d ops/s. (group size: %d)\n", names[std::min(use_prefetched, (uint16_t)4) - 2],
+           (int)(done_requests * repeat / (gettime() - start)), group_size);
+    for (uint32_t i = 0; i < done_requests; i++)
+    {
+      if (results[i] != keys[i])
+      {
+        printf("batched lookup returned wrong value.\n");
+        return 1;
+      }
+    }
+    free(results);
+  }
+  else if (use_prefetched)
   {
     start = gettime();
     volatile uint32_t dummy = 0;
@@ -114,24 +267,59 @@ int main(int argc, const char *argv[])
     printf("LookupPrefteched:    %d ops/s.\n", (int)(done_requests * repeat / (gettime() - start)));
   }
 
-  // return 0;
-
-  return 0;
-  uint32_t m = 10000000;
-  uint32_t r_size = n / 10;
-  uint32_t *rkeys = reinterpret_cast<uint32_t *>(malloc(sizeof(uint32_t) * m));
-  for (int i = 0; i < m; i++)
+  // Range queries over range_length consecutive keys with random start keys
+  std::sort(keys, keys + n);
+  const uint32_t m = 1000000;
+  const uint32_t range_length = std::min(100u, n);
+  uint32_t *start_keys = reinterpret_cast<uint32_t *>(malloc(sizeof(uint32_t) * m));
+  uint32_t *end_keys = reinterpret_cast<uint32_t *>(malloc(sizeof(uint32_t) * m));
+  for (uint32_t i = 0; i < m; i++)
   {
-    rkeys[i] = keys[rand() % n];
+    uint32_t first = gen() % (n - range_length + 1);
+    start_keys[i] = keys[first];
+    end_keys[i] = keys[first + range_length - 1];
   }
+
   start = gettime();
-  for (int i = 0; i < m; i++)
+  for (uint32_t i = 0; i < m; i++)
   {
-    _CSSL_RangeSearchResult res = searchRange(slist, rkeys[i], (rkeys[i] + r_size));
-    assert(res.start->key >= rkeys[i] && res.end->key <= (rkeys[i] + r_size));
+    _CSSL_RangeSearchResult res = searchRange(slist, start_keys[i], end_keys[i]);
+    assert(res.start->key >= start_keys[i] && res.end->key <= end_keys[i]);
   }
   printf("Range:     %d ops/s. (Range size: %d)\n",
-         (int)(m / (gettime() - start)), r_size);
+         (int)(m / (gettime() - start)), range_length);
+
+  // materialized scans, range i is copied to buffer + i * range_length
+  const uint32_t batch_size = 1024;
+  uint32_t *buffer = reinterpret_cast<uint32_t *>(malloc(sizeof(uint32_t) * batch_size * range_length));
+  uint32_t *counts = reinterpret_cast<uint32_t *>(malloc(sizeof(uint32_t) * m));
+  start = gettime();
+  for (uint32_t i = 0; i < m; i++)
+    counts[i] = scanRange(slist, start_keys[i], end_keys[i], buffer + (i % batch_size) * range_length, range_length);
+  printf("RangeScan: %d ops/s. (Range size: %d)\n",
+         (int)(m / (gettime() - start)), range_length);
+
+  start = gettime();
+  for (uint32_t i = 0; i < m; i += batch_size)
+  {
+    uint32_t count = std::min(batch_size, m - i);
+    scanRangesAMAC(slist, start_keys + i, end_keys + i, count, buffer, range_length, counts + i, group_size);
+  }
+  printf("RangeScanAMAC: %d ops/s. (Range size: %d, group size: %d)\n",
+         (int)(m / (gettime() - start)), range_length, group_size);
+
+  // the last batch is still in the buffer, duplicate keys may fill a range early
+  for (uint32_t i = m - 1 - (m - 1) % batch_size; i < m; i++)
+  {
+    uint32_t *range = buffer + (i % batch_size) * range_length;
+    const uint32_t *lower = std::lower_bound(keys, keys + n, start_keys[i]);
+    if (counts[i] != std::min<uint32_t>(range_length, std::upper_bound(keys, keys + n, end_keys[i]) - lower) ||
+        !std::equal(range, range + counts[i], lower))
+    {
+      printf("range scan returned wrong keys.\n");
+      return 1;
+    }
+  }
 
   return 0;
 }
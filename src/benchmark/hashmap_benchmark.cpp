@@ -7,44 +7,146 @@
 #include <assert.h>
 #include <nlohmann/json.hpp>
 #include <fstream>
+#include <thread>
+#include <atomic>
+#include <optional>
 
 #include "zipfian_int_distribution.hpp"
 #include "numa/static_numa_memory_resource.hpp"
+#include "../lib/utils/utils.hpp"
 
-const int TOTAL_QUERIES = 25'000'000;
-const int GROUP_SIZE = 32;
-const int AMAC_REQUESTS_SIZE = 1024;
+struct HashMapBenchmarkConfig
+{
+    std::string hashmap;
+    std::string build;
+    std::string key_distribution;
+    double zipf_theta;
+    // Keys [0, num_keys) are in the map, a miss looks up a key from [num_keys, 2 * num_keys).
+    long num_keys;
+    double miss_ratio;
+    size_t number_buckets;
+    double max_load_factor;
+    size_t bloom_bits_per_key;
+    size_t num_threads;
+    size_t num_lookups;
+    size_t group_size;
+    size_t batch_size;
+    size_t prefetch_distance;
+    NodeID run_on_node;
+    NodeID alloc_on_node;
+    bool freeze;
+    NodeID freeze_on_node;
+    bool madvise_huge_pages;
+    bool profile;
+};
 
-template <typename Function>
-void measure_vectorized_operation(HashMap<uint32_t, uint32_t> &openMap, Function func, const std::string &op_name, int invoke_vector_size, auto gen, auto dis, nlohmann::json &metrics)
+// Lookup keys of one thread, split into the batches passed to the lookup function.
+std::vector<std::vector<uint32_t>> generate_requests(const HashMapBenchmarkConfig &config, size_t thread_id, size_t invoke_vector_size)
 {
-    openMap.profiler.reset();
-    auto start = std::chrono::high_resolution_clock::now();
-    auto end = std::chrono::high_resolution_clock::now();
-    double total_time = 0;
+    std::mt19937 gen(thread_id);
+    std::bernoulli_distribution miss_dis(config.miss_ratio);
+    std::uniform_int_distribution<uint32_t> uniform_dis(0, config.num_keys - 1);
+    // Constructing the zipfian distribution computes zeta over all keys, so only do it when needed.
+    std::optional<zipfian_int_distribution<int>> zipfian_dis;
+    if (config.key_distribution == "zipfian")
+    {
+        zipfian_dis.emplace(zipfian_int_distribution<int>::param_type(0, config.num_keys - 1, config.zipf_theta));
+    }
 
-    std::vector<uint32_t> requests(invoke_vector_size);
-    std::vector<uint32_t> results(invoke_vector_size);
-    for (int i = 0; i < TOTAL_QUERIES; i += invoke_vector_size)
+    const size_t lookups_per_thread = config.num_lookups / config.num_threads;
+    std::vector<std::vector<uint32_t>> batches;
+    for (size_t i = 0; i < lookups_per_thread; i += invoke_vector_size)
     {
-        for (int j = 0; j < invoke_vector_size; j++)
+        auto &batch = batches.emplace_back(std::min(invoke_vector_size, lookups_per_thread - i));
+        for (auto &request : batch)
         {
-            int random_number = dis(gen); // will generate duplicates, we don't care
-            requests.at(j) = random_number;
+            // will generate duplicates, we don't care
+            const uint32_t key = zipfian_dis ? (*zipfian_dis)(gen) : uniform_dis(gen);
+            request = miss_dis(gen) ? config.num_keys + key : key;
         }
+    }
+    return batches;
+}
 
-        start = std::chrono::high_resolution_clock::now();
-        func(requests, results, GROUP_SIZE);
-        end = std::chrono::high_resolution_clock::now();
-        total_time += std::chrono::duration<double>(end - start).count();
+template <typename Map, typename Function>
+void measure_vectorized_operation(Map &openMap, Function func, const std::string &op_name, size_t invoke_vector_size, nlohmann::json &metrics, const HashMapBenchmarkConfig &config)
+{
+    openMap.profiler.reset();
+    auto &perf_manager = Prefetching::get().perf_manager;
+    auto mt_event_counter = perf_manager.get_mt_event_counter(config.num_threads);
 
-        for (int j = 0; j < invoke_vector_size; j++)
-        {
-            assert(results.at(j) == requests.at(j) + 1);
-        }
+    // Every thread issues its share of the lookups, the slowest thread determines the total time.
+    std::vector<double> thread_times(config.num_threads, 0);
+    std::vector<std::jthread> threads;
+    std::atomic<size_t> threads_ready = 0;
+    std::atomic<bool> start_lookups = false;
+    for (size_t t = 0; t < config.num_threads; ++t)
+    {
+        threads.emplace_back([&, t]()
+                             {
+            pin_to_cpu(Prefetching::get().numa_manager.node_to_available_cpus[config.run_on_node][t]);
+
+            // Keys are generated and result buffers allocated before the timed section.
+            auto requests = generate_requests(config, t, invoke_vector_size);
+            std::vector<std::vector<uint32_t>> results(requests.size());
+            std::vector<std::vector<bool>> found(requests.size());
+            for (size_t b = 0; b < requests.size(); ++b)
+            {
+                results[b].resize(requests[b].size());
+            }
+
+            threads_ready++;
+            while (!start_lookups)
+            {
+                wait_cycles(100);
+            }
+
+            if (config.profile)
+            {
+                mt_event_counter.start(t);
+            }
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t b = 0; b < requests.size(); ++b)
+            {
+                func(requests[b], results[b], found[b], config.group_size);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            if (config.profile)
+            {
+                mt_event_counter.stop(t);
+            }
+            thread_times[t] = std::chrono::duration<double>(end - start).count();
+
+            for (size_t b = 0; b < requests.size(); ++b)
+            {
+                for (size_t j = 0; j < requests[b].size(); j++)
+                {
+                    if (found[b].at(j) != (requests[b].at(j) < config.num_keys))
+                    {
+                        perror("hashmap lookup reported a wrong hit or miss.");
+                        exit(-1);
+                    }
+                    if (found[b].at(j) && results[b].at(j) != requests[b].at(j) + 1)
+                    {
+                        perror("hashmap lookup returned wrong value.");
+                        exit(-1);
+                    }
+                }
+            } });
+    }
+    while (threads_ready < config.num_threads)
+    {
+        wait_cycles(100);
+    }
+    start_lookups = true;
+    for (auto &thread : threads)
+    {
+        thread.join();
     }
 
-    double throughput = TOTAL_QUERIES / total_time;
+    const size_t total_lookups = config.num_lookups / config.num_threads * config.num_threads;
+    double total_time = *std::max_element(thread_times.begin(), thread_times.end());
+    double throughput = total_lookups / total_time;
 
     std::cout << std::endl;
     std::cout << op_name << std::endl;
@@ -53,86 +155,273 @@ void measure_vectorized_operation(HashMap<uint32_t, uint32_t> &openMap, Function
     metrics[op_name]["time"] = total_time;
     metrics[op_name]["throughput"] = throughput;
     metrics[op_name]["profiler"] = openMap.profiler.return_metrics();
+    if (config.profile)
+    {
+        perf_manager.result(mt_event_counter, metrics[op_name], total_lookups);
+    }
 }
 
-nlohmann::json execute_benchmark(HashMap<uint32_t, uint32_t> &openMap, int GROUP_SIZE, int AMAC_REQUEST_SIZE, auto gen, auto dis)
+template <typename Map>
+nlohmann::json execute_benchmark(Map &openMap, const HashMapBenchmarkConfig &config)
 {
     nlohmann::json results;
     measure_vectorized_operation(
-        openMap, [&](auto &a, auto &b, auto &c)
-        { openMap.vectorized_get_amac(a, b, c); },
-        "Vectorized_get_amac()", AMAC_REQUESTS_SIZE, gen, dis, results);
+        openMap, [&](auto &a, auto &b, auto &f, auto c)
+        { openMap.vectorized_get_amac(a, b, f, c); },
+        "Vectorized_get_amac()", config.batch_size, results, config);
     measure_vectorized_operation(
-        openMap, [&](auto &a, auto &b, auto &c)
-        { openMap.vectorized_get_coroutine(a, b, c); },
-        "Vectorized_get_co()", AMAC_REQUESTS_SIZE, gen, dis, results);
+        openMap, [&](auto &a, auto &b, auto &f, auto c)
+        { openMap.vectorized_get_coroutine(a, b, f, c); },
+        "Vectorized_get_co()", config.batch_size, results, config);
+    // Group prefetching interleaves the whole batch, so its batch is one group.
     measure_vectorized_operation(
-        openMap, [&](auto &a, auto &b, auto &c)
-        { openMap.vectorized_get_gp(a, b); },
-        "Vectorized_get_gp()", GROUP_SIZE, gen, dis, results);
+        openMap, [&](auto &a, auto &b, auto &f, auto c)
+        { openMap.vectorized_get_gp(a, b, f); },
+        "Vectorized_get_gp()", config.group_size, results, config);
     measure_vectorized_operation(
-        openMap, [&](auto &a, auto &b, auto &c)
-        { openMap.vectorized_get(a, b); },
-        "Vectorized_get()", GROUP_SIZE, gen, dis, results);
-    measure_vectorized_operation(
-        openMap, [&](auto &a, auto &b, auto &c)
-        { openMap.vectorized_get_coroutine_exp(a, b, c); },
-        "vectorized_get_coroutine_exp()", AMAC_REQUESTS_SIZE, gen, dis, results);
-    measure_vectorized_operation(
-        openMap, [&](auto &a, auto &b, auto &c)
-        { openMap.profile_vectorized_get_coroutine_exp(a, b, c); },
-        "profile_vectorized_get_coroutine_exp()", AMAC_REQUESTS_SIZE, gen, dis, results);
+        openMap, [&](auto &a, auto &b, auto &f, auto c)
+        { openMap.vectorized_get(a, b, f); },
+        "Vectorized_get()", config.group_size, results, config);
+    if constexpr (requires(std::vector<uint32_t> &keys, std::vector<bool> &found) { openMap.vectorized_get_rolling(keys, keys, found, 0); })
+    {
+        measure_vectorized_operation(
+            openMap, [&](auto &a, auto &b, auto &f, auto c)
+            { openMap.vectorized_get_rolling(a, b, f, config.prefetch_distance); },
+            "Vectorized_get_rolling()", config.batch_size, results, config);
+    }
+    if constexpr (requires(std::vector<uint32_t> &keys, std::vector<bool> &found) { openMap.vectorized_get_reorder(keys, keys, found); })
+    {
+        measure_vectorized_operation(
+            openMap, [&](auto &a, auto &b, auto &f, auto c)
+            { openMap.vectorized_get_reorder(a, b, f, BatchReorder::page_shift); },
+            "Vectorized_get_reorder_page()", config.batch_size, results, config);
+        measure_vectorized_operation(
+            openMap, [&](auto &a, auto &b, auto &f, auto c)
+            { openMap.vectorized_get_reorder(a, b, f, BatchReorder::huge_page_shift); },
+            "Vectorized_get_reorder_huge_page()", config.batch_size, results, config);
+    }
+    if constexpr (std::is_same_v<Map, HashMap<uint32_t, uint32_t>>)
+    {
+        measure_vectorized_operation(
+            openMap, [&](auto &a, auto &b, auto &f, auto c)
+            { openMap.vectorized_get_coroutine_exp(a, b, f, c); },
+            "vectorized_get_coroutine_exp()", config.batch_size, results, config);
+        measure_vectorized_operation(
+            openMap, [&](auto &a, auto &b, auto &f, auto c)
+            { openMap.profile_vectorized_get_coroutine_exp(a, b, f, c); },
+            "profile_vectorized_get_coroutine_exp()", config.batch_size, results, config);
+    }
     return results;
 };
 
+template <typename Map>
+void build(Map &openMap, const HashMapBenchmarkConfig &config)
+{
+    auto &manager = Prefetching::get().numa_manager;
+    if constexpr (std::is_same_v<Map, ConcurrentHashMap<uint32_t, uint32_t>>)
+    {
+        // The concurrent map is filled by all threads at once.
+        std::vector<std::jthread> threads;
+        for (size_t t = 0; t < config.num_threads; ++t)
+        {
+            threads.emplace_back([&, t]()
+                                 {
+                pin_to_cpu(manager.node_to_available_cpus[config.run_on_node][t]);
+                for (uint32_t i = t; i < config.num_keys; i += config.num_threads)
+                {
+                    openMap.insert(i, i + 1);
+                } });
+        }
+        return;
+    }
+    else if constexpr (std::is_same_v<Map, HashMap<uint32_t, uint32_t>>)
+    {
+        if (config.build != "serial")
+        {
+            std::vector<uint32_t> keys;
+            std::vector<uint32_t> values;
+            for (uint32_t i = 0; i < config.num_keys; i += config.batch_size)
+            {
+                keys.clear();
+                values.clear();
+                for (uint32_t key = i; key < std::min<long>(i + config.batch_size, config.num_keys); ++key)
+                {
+                    keys.push_back(key);
+                    values.push_back(key + 1);
+                }
+                if (config.build == "gp")
+                {
+                    openMap.vectorized_insert_gp(keys, values);
+                }
+                else if (config.build == "amac")
+                {
+                    openMap.vectorized_insert_amac(keys, values, config.group_size);
+                }
+                else
+                {
+                    openMap.vectorized_insert_coroutine(keys, values, config.group_size);
+                }
+            }
+            return;
+        }
+    }
+    for (uint32_t i = 0; i < config.num_keys; i++)
+    {
+        openMap.insert(i, i + 1);
+    }
+}
+
+template <typename Map>
+void run(Map &openMap, const HashMapBenchmarkConfig &config, nlohmann::json &results)
+{
+    pin_to_cpu(Prefetching::get().numa_manager.node_to_available_cpus[config.run_on_node][0]);
+    auto build_start = std::chrono::high_resolution_clock::now();
+    build(openMap, config);
+    auto build_end = std::chrono::high_resolution_clock::now();
+    results["build_time"] = std::chrono::duration<double>(build_end - build_start).count();
+    std::cout << "Build time (" << config.build << "): " << results["build_time"] << " seconds" << std::endl;
+
+    std::cout << "----- Measuring " << config.key_distribution << " Accesses (" << config.hashmap << ") -----" << std::endl;
+    if constexpr (std::is_same_v<Map, HashMap<uint32_t, uint32_t>>)
+    {
+        if (config.freeze)
+        {
+            auto freeze_start = std::chrono::high_resolution_clock::now();
+            auto frozenMap = openMap.freeze(config.freeze_on_node, false, config.madvise_huge_pages);
+            auto freeze_end = std::chrono::high_resolution_clock::now();
+            results["freeze_time"] = std::chrono::duration<double>(freeze_end - freeze_start).count();
+            results["frozen_bytes"] = frozenMap.memory_usage();
+            results["lookups"] = execute_benchmark(frozenMap, config);
+            return;
+        }
+    }
+    results["lookups"] = execute_benchmark(openMap, config);
+}
+
 int main(int argc, char **argv)
 {
     auto &manager = Prefetching::get().numa_manager;
     auto &benchmark_config = Prefetching::get().runtime_config;
     // clang-format off
     benchmark_config.add_options()
-        ("d,distribution", "Type of distribution", cxxopts::value<std::vector<std::string>>()->default_value("uniform,zipfian"))
+        ("hashmap", "Hash map implementation (chained,bucketized,cuckoo,concurrent)", cxxopts::value<std::vector<std::string>>()->default_value("chained,bucketized,cuckoo,concurrent"))
+        ("build", "How the chained hashmap is filled (serial,gp,amac,coroutine), the other maps are filled serially", cxxopts::value<std::vector<std::string>>()->default_value("serial"))
+        ("d,distribution", "Type of distribution (uniform,zipfian)", cxxopts::value<std::vector<std::string>>()->default_value("uniform,zipfian"))
+        ("zipf_theta", "Skew of the zipfian distribution", cxxopts::value<std::vector<double>>()->default_value("0.99"))
+        ("miss_ratio", "Fraction of lookups for keys that are not in the hashmap", cxxopts::value<std::vector<double>>()->default_value("0"))
         ("number_keys", "Number of keys to fill the hashmap with", cxxopts::value<std::vector<long>>()->default_value("10000000"))
-        ("number_buckets", "Number of buckets in the hashmap", cxxopts::value<std::vector<size_t>>()->default_value("500000"));
+        ("number_buckets", "Number of buckets in the chained hashmap", cxxopts::value<std::vector<size_t>>()->default_value("500000"))
+        ("max_load_factor", "Load factor at which the chained hashmap grows incrementally (0 keeps number_buckets fixed)", cxxopts::value<std::vector<double>>()->default_value("0"))
+        ("bloom_bits_per_key", "Bits per key of the Bloom filter in front of the chained hashmap (0 disables it)", cxxopts::value<std::vector<size_t>>()->default_value("0"))
+        ("num_threads", "Number of lookup threads", cxxopts::value<std::vector<size_t>>()->default_value("1"))
+        ("num_lookups", "Number of lookups across all threads", cxxopts::value<std::vector<size_t>>()->default_value("25000000"))
+        ("group_size", "Number of interleaved lookups (AMAC, coroutines), batch size of group prefetching", cxxopts::value<std::vector<size_t>>()->default_value("32"))
+        ("batch_size", "Number of keys per call of the AMAC, coroutine and reordered lookups and batched inserts", cxxopts::value<std::vector<size_t>>()->default_value("1024"))
+        ("prefetch_distance", "Number of keys the rolling lookups prefetch ahead", cxxopts::value<std::vector<size_t>>()->default_value("16"))
+        ("run_on_node", "NUMA node whose CPUs the threads are pinned to", cxxopts::value<std::vector<NodeID>>()->default_value("0"))
+        ("alloc_on_node", "NUMA node the hashmap is allocated on", cxxopts::value<std::vector<NodeID>>()->default_value("0"))
+        ("freeze", "Measure lookups on a frozen copy of the chained hashmap", cxxopts::value<std::vector<bool>>()->default_value("false"))
+        ("freeze_on_node", "NUMA node the frozen hashmap is allocated on", cxxopts::value<std::vector<NodeID>>()->default_value("0"))
+        ("madvise_huge_pages", "Madvise kernel to create huge pages on mem regions", cxxopts::value<std::vector<bool>>()->default_value("true"))
+        ("profile", "Collect perf counters per lookup variant", cxxopts::value<std::vector<bool>>()->default_value("false"));
     // clang-format on
     benchmark_config.parse(argc, argv);
 
     int benchmark_run = 0;
     for (auto &runtime_config : benchmark_config.get_runtime_configs())
     {
-        auto num_keys = convert<long>(runtime_config["number_keys"]);
+        HashMapBenchmarkConfig config{
+            runtime_config["hashmap"],
+            runtime_config["build"],
+            runtime_config["distribution"],
+            convert<double>(runtime_config["zipf_theta"]),
+            convert<long>(runtime_config["number_keys"]),
+            convert<double>(runtime_config["miss_ratio"]),
+            convert<size_t>(runtime_config["number_buckets"]),
+            convert<double>(runtime_config["max_load_factor"]),
+            convert<size_t>(runtime_config["bloom_bits_per_key"]),
+            convert<size_t>(runtime_config["num_threads"]),
+            convert<size_t>(runtime_config["num_lookups"]),
+            convert<size_t>(runtime_config["group_size"]),
+            convert<size_t>(runtime_config["batch_size"]),
+            convert<size_t>(runtime_config["prefetch_distance"]),
+            convert<NodeID>(runtime_config["run_on_node"]),
+            convert<NodeID>(runtime_config["alloc_on_node"]),
+            convert<bool>(runtime_config["freeze"]),
+            convert<NodeID>(runtime_config["freeze_on_node"]),
+            convert<bool>(runtime_config["madvise_huge_pages"]),
+            convert<bool>(runtime_config["profile"])};
+
+        if (config.num_threads > manager.node_to_available_cpus[config.run_on_node].size())
+        {
+            std::cout << "Not enough CPUs on node " << config.run_on_node << " for " << config.num_threads << " threads." << std::endl;
+            continue;
+        }
+        if (config.key_distribution != "uniform" && config.key_distribution != "zipfian")
+        {
+            std::cout << "Unknown Distribution Defined: " << config.key_distribution << std::endl;
+            continue;
+        }
+        if (config.build != "serial" && config.build != "gp" && config.build != "amac" && config.build != "coroutine")
+        {
+            std::cout << "Unknown Build Defined: " << config.build << std::endl;
+            continue;
+        }
+        // Only the chained map has batched inserts and can be frozen.
+        if ((config.build != "serial" || config.freeze) && config.hashmap != "chained")
+        {
+            continue;
+        }
 
         PrefetchProfiler profiler{30};
-        StaticNumaMemoryResource mem_res{0};
-        HashMap<uint32_t, uint32_t> openMap{convert<size_t>(runtime_config["number_buckets"]), profiler, mem_res};
+        StaticNumaMemoryResource mem_res{config.alloc_on_node, false, config.madvise_huge_pages};
 
         nlohmann::json results;
-        std::random_device rd;
-        std::mt19937 gen(rd());
-
-        std::uniform_int_distribution<> uniform_dis(0, num_keys - 1);
-
-        zipfian_int_distribution<int>::param_type p(0, num_keys - 1, 0.99, 27.000);
-        zipfian_int_distribution<int> zipfian_distribution(p);
+        results["config"]["hashmap"] = config.hashmap;
+        results["config"]["build"] = config.build;
+        results["config"]["distribution"] = config.key_distribution;
+        results["config"]["zipf_theta"] = config.zipf_theta;
+        results["config"]["miss_ratio"] = config.miss_ratio;
+        results["config"]["number_keys"] = config.num_keys;
+        results["config"]["number_buckets"] = config.number_buckets;
+        results["config"]["max_load_factor"] = config.max_load_factor;
+        results["config"]["bloom_bits_per_key"] = config.bloom_bits_per_key;
+        results["config"]["num_threads"] = config.num_threads;
+        results["config"]["num_lookups"] = config.num_lookups;
+        results["config"]["group_size"] = config.group_size;
+        results["config"]["batch_size"] = config.batch_size;
+        results["config"]["prefetch_distance"] = config.prefetch_distance;
+        results["config"]["run_on_node"] = config.run_on_node;
+        results["config"]["alloc_on_node"] = config.alloc_on_node;
+        results["config"]["freeze"] = config.freeze;
+        results["config"]["freeze_on_node"] = config.freeze_on_node;
+        results["config"]["madvise_huge_pages"] = config.madvise_huge_pages;
+        results["config"]["profile"] = config.profile;
 
-        for (uint32_t i = 0; i < num_keys; i++)
+        if (config.hashmap == "chained")
         {
-            openMap.insert(i, i + 1);
+            HashMap<uint32_t, uint32_t> openMap{config.number_buckets, profiler, mem_res, config.max_load_factor, config.num_keys * config.bloom_bits_per_key};
+            run(openMap, config, results);
         }
-
-        if (runtime_config["distribution"] == "uniform")
+        else if (config.hashmap == "bucketized")
+        {
+            BucketizedHashMap<uint32_t, uint32_t> openMap{static_cast<size_t>(config.num_keys), profiler, mem_res};
+            run(openMap, config, results);
+        }
+        else if (config.hashmap == "cuckoo")
         {
-            std::cout << "----- Measuring Uniform Accesses -----" << std::endl;
-            results["uniform"] = execute_benchmark(openMap, GROUP_SIZE, AMAC_REQUESTS_SIZE, gen, uniform_dis);
+            CuckooHashMap<uint32_t, uint32_t> openMap{static_cast<size_t>(config.num_keys), profiler, mem_res};
+            run(openMap, config, results);
         }
-        else if (runtime_config["distribution"] == "zipfian")
+        else if (config.hashmap == "concurrent")
         {
-            std::cout << "----- Measuring Zipfian Accesses -----" << std::endl;
-            results["zipfian"] = execute_benchmark(openMap, GROUP_SIZE, AMAC_REQUESTS_SIZE, gen, zipfian_distribution);
+            ConcurrentHashMap<uint32_t, uint32_t> openMap{static_cast<size_t>(config.num_keys), profiler, mem_res};
+            run(openMap, config, results);
         }
         else
         {
-            std::cout << "Unknown Distribution Defined: " << runtime_config["distribution"] << std::endl;
+            std::cout << "Unknown Hash Map Defined: " << config.hashmap << std::endl;
+            continue;
         }
 
         auto results_file = std::ofstream{"hashmap_benchmark_" + std::to_string(benchmark_run++) + ".json"};
@@ -140,4 +429,4 @@ int main(int argc, char **argv)
     }
 
     return 0;
-}
\ No newline at end of file
+}
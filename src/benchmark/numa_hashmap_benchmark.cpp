@@ -0,0 +1,189 @@
+#include "hashmap.hpp"
+#include "prefetching.hpp"
+
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <nlohmann/json.hpp>
+#include <fstream>
+
+#include "../lib/utils/utils.hpp"
+
+/**
+ * Compares the two lookup paths of the NumaPartitionedHashMap: delegating the per-partition batches to the workers
+ * on the owning nodes versus looking them up from the calling threads with (remote) prefetching.
+ */
+
+struct NumaHashMapBenchmarkConfig
+{
+    std::string mode;
+    size_t batch_size;
+    size_t group_size;
+    size_t num_threads;
+    size_t num_lookups;
+    NodeID run_on_node;
+};
+
+double run_lookups(NumaPartitionedHashMap<uint32_t, uint32_t> &map, const NumaHashMapBenchmarkConfig &config, long num_keys)
+{
+    // Every thread issues its share of the lookups, the slowest thread determines the total time.
+    std::vector<double> thread_times(config.num_threads, 0);
+    std::vector<std::jthread> threads;
+    std::atomic<size_t> threads_ready = 0;
+    std::atomic<bool> start_lookups = false;
+    const size_t lookups_per_thread = config.num_lookups / config.num_threads;
+    for (size_t t = 0; t < config.num_threads; ++t)
+    {
+        threads.emplace_back([&, t]()
+                             {
+            pin_to_cpu(Prefetching::get().numa_manager.node_to_available_cpus[config.run_on_node][t]);
+
+            // Keys are generated and result buffers allocated before the timed section.
+            std::mt19937 gen(t);
+            std::uniform_int_distribution<uint32_t> dis(0, num_keys - 1);
+            std::vector<std::vector<uint32_t>> requests;
+            for (size_t i = 0; i < lookups_per_thread; i += config.batch_size)
+            {
+                auto &batch = requests.emplace_back(std::min(config.batch_size, lookups_per_thread - i));
+                for (auto &request : batch)
+                {
+                    request = dis(gen);
+                }
+            }
+            std::vector<std::vector<uint32_t>> results(requests.size());
+            std::vector<std::vector<bool>> found(requests.size());
+            for (size_t b = 0; b < requests.size(); ++b)
+            {
+                results[b].resize(requests[b].size());
+            }
+
+            threads_ready++;
+            while (!start_lookups)
+            {
+                wait_cycles(100);
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t b = 0; b < requests.size(); ++b)
+            {
+                if (config.mode == "delegation")
+                {
+                    map.vectorized_get_delegated(requests[b], results[b], found[b], config.group_size);
+                }
+                else
+                {
+                    map.vectorized_get_remote(requests[b], results[b], found[b], config.group_size);
+                }
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            thread_times[t] = std::chrono::duration<double>(end - start).count();
+
+            // All requested keys were inserted with value key + 1.
+            for (size_t b = 0; b < requests.size(); ++b)
+            {
+                for (size_t j = 0; j < requests[b].size(); j++)
+                {
+                    if (!found[b].at(j))
+                    {
+                        perror("partitioned hashmap lookup missed an inserted key.");
+                        exit(-1);
+                    }
+                    if (results[b].at(j) != requests[b].at(j) + 1)
+                    {
+                        perror("partitioned hashmap lookup returned wrong value.");
+                        exit(-1);
+                    }
+                }
+            } });
+    }
+    while (threads_ready < config.num_threads)
+    {
+        wait_cycles(100);
+    }
+    start_lookups = true;
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    return *std::max_element(thread_times.begin(), thread_times.end());
+}
+
+int main(int argc, char **argv)
+{
+    auto &manager = Prefetching::get().numa_manager;
+    auto &benchmark_config = Prefetching::get().runtime_config;
+    // clang-format off
+    benchmark_config.add_options()
+        ("mode", "Lookup path (delegation,remote)", cxxopts::value<std::vector<std::string>>()->default_value("delegation,remote"))
+        ("batch_size", "Number of keys per lookup batch", cxxopts::value<std::vector<size_t>>()->default_value("64,256,1024,4096"))
+        ("group_size", "Number of interleaved coroutines per partition batch", cxxopts::value<std::vector<size_t>>()->default_value("32"))
+        ("num_threads", "Number of client threads", cxxopts::value<std::vector<size_t>>()->default_value("1"))
+        ("workers_per_node", "Number of delegation workers per node", cxxopts::value<std::vector<size_t>>()->default_value("1"))
+        ("run_on_node", "NUMA node the client threads are pinned to", cxxopts::value<std::vector<NodeID>>()->default_value("0"))
+        ("number_keys", "Number of keys to fill the hashmap with", cxxopts::value<std::vector<long>>()->default_value("10000000"))
+        ("number_buckets", "Number of buckets across all partitions", cxxopts::value<std::vector<size_t>>()->default_value("10000000"))
+        ("num_lookups", "Number of lookups across all client threads", cxxopts::value<std::vector<size_t>>()->default_value("25000000"));
+    // clang-format on
+    benchmark_config.parse(argc, argv);
+
+    int benchmark_run = 0;
+    for (auto &runtime_config : benchmark_config.get_runtime_configs())
+    {
+        NumaHashMapBenchmarkConfig config{
+            runtime_config["mode"],
+            convert<size_t>(runtime_config["batch_size"]),
+            convert<size_t>(runtime_config["group_size"]),
+            convert<size_t>(runtime_config["num_threads"]),
+            convert<size_t>(runtime_config["num_lookups"]),
+            convert<NodeID>(runtime_config["run_on_node"])};
+        auto num_keys = convert<long>(runtime_config["number_keys"]);
+        auto workers_per_node = convert<size_t>(runtime_config["workers_per_node"]);
+
+        if (config.mode != "delegation" && config.mode != "remote")
+        {
+            std::cout << "Unknown Mode Defined: " << config.mode << std::endl;
+            continue;
+        }
+        if (workers_per_node == 0)
+        {
+            std::cout << "At least one worker per node is needed to serve delegated batches." << std::endl;
+            continue;
+        }
+        // Workers occupy the last CPUs of every node, the clients the first ones.
+        if (config.num_threads + workers_per_node > manager.node_to_available_cpus[config.run_on_node].size())
+        {
+            std::cout << "Not enough CPUs on node " << config.run_on_node << " for " << config.num_threads << " clients and " << workers_per_node << " workers." << std::endl;
+            continue;
+        }
+
+        PrefetchProfiler profiler{30};
+        NumaPartitionedHashMap<uint32_t, uint32_t> map{manager.active_nodes, convert<size_t>(runtime_config["number_buckets"]), workers_per_node, profiler};
+        for (uint32_t i = 0; i < num_keys; i++)
+        {
+            map.insert(i, i + 1);
+        }
+
+        const double total_time = run_lookups(map, config, num_keys);
+        const double throughput = config.num_lookups / config.num_threads * config.num_threads / total_time;
+        std::cout << config.mode << " batch_size " << config.batch_size << ": " << throughput << " lookups/second" << std::endl;
+
+        nlohmann::json results;
+        results["config"]["mode"] = config.mode;
+        results["config"]["batch_size"] = config.batch_size;
+        results["config"]["group_size"] = config.group_size;
+        results["config"]["num_threads"] = config.num_threads;
+        results["config"]["workers_per_node"] = workers_per_node;
+        results["config"]["run_on_node"] = config.run_on_node;
+        results["config"]["partition_nodes"] = manager.active_nodes;
+        results["config"]["number_keys"] = num_keys;
+        results["time"] = total_time;
+        results["throughput"] = throughput;
+
+        auto results_file = std::ofstream{"numa_hashmap_benchmark_" + std::to_string(benchmark_run++) + ".json"};
+        results_file << results.dump(-1) << std::flush;
+    }
+
+    return 0;
+}
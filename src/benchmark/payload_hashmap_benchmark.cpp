@@ -0,0 +1,165 @@
+#include "hashmap.hpp"
+#include "prefetching.hpp"
+
+#include <random>
+#include <chrono>
+#include <cstring>
+#include <nlohmann/json.hpp>
+#include <fstream>
+
+#include "numa/static_numa_memory_resource.hpp"
+#include "../lib/utils/utils.hpp"
+
+/**
+ * Lookups of out-of-line payloads: the hash map stores PayloadArena handles, every hit copies its record into a
+ * result buffer. Sweeps the record size for the lookup without prefetching, for the AMAC and coroutine lookups,
+ * which prefetch the record lines in a separate stage, and for the rolling lookup, which pipelines the bucket and the
+ * materialization stage with a fixed prefetch distance.
+ */
+
+struct PayloadBenchmarkConfig
+{
+    std::string mode;
+    size_t payload_size;
+    size_t batch_size;
+    size_t group_size;
+    size_t prefetch_distance;
+    size_t num_lookups;
+};
+
+double run_lookups(HashMap<uint32_t, uint32_t> &map, const PayloadArena &arena, const PayloadBenchmarkConfig &config, long num_keys)
+{
+    std::mt19937 gen(0);
+    std::uniform_int_distribution<uint32_t> dis(0, num_keys - 1);
+    std::vector<uint32_t> requests(config.batch_size);
+    std::vector<bool> found(config.batch_size);
+    std::vector<char> sink(config.batch_size * config.payload_size);
+
+    double total_time = 0;
+    for (size_t i = 0; i < config.num_lookups; i += config.batch_size)
+    {
+        for (auto &request : requests)
+        {
+            request = dis(gen);
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        if (config.mode == "naive")
+        {
+            map.vectorized_get_payload(requests, arena, sink.data(), found);
+        }
+        else if (config.mode == "amac")
+        {
+            map.vectorized_get_payload_amac(requests, arena, sink.data(), found, config.group_size);
+        }
+        else if (config.mode == "coroutine")
+        {
+            map.vectorized_get_payload_coroutine(requests, arena, sink.data(), found, config.group_size);
+        }
+        else
+        {
+            map.vectorized_get_payload_rolling(requests, arena, sink.data(), found, config.prefetch_distance);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        total_time += std::chrono::duration<double>(end - start).count();
+
+        for (size_t j = 0; j < requests.size(); ++j)
+        {
+            uint32_t key;
+            std::memcpy(&key, sink.data() + j * config.payload_size, sizeof(key));
+            if (!found[j])
+            {
+                perror("payload lookup missed an inserted key.");
+                exit(-1);
+            }
+            if (key != requests[j])
+            {
+                perror("payload lookup returned wrong record.");
+                exit(-1);
+            }
+        }
+    }
+    return total_time;
+}
+
+int main(int argc, char **argv)
+{
+    auto &manager = Prefetching::get().numa_manager;
+    auto &benchmark_config = Prefetching::get().runtime_config;
+    // clang-format off
+    benchmark_config.add_options()
+        ("mode", "Lookup (naive,amac,coroutine,rolling)", cxxopts::value<std::vector<std::string>>()->default_value("naive,amac,coroutine,rolling"))
+        ("payload_size", "Size of a payload record in bytes", cxxopts::value<std::vector<size_t>>()->default_value("64,128,256,512"))
+        ("batch_size", "Number of keys per lookup batch", cxxopts::value<std::vector<size_t>>()->default_value("1024"))
+        ("group_size", "Number of interleaved lookups", cxxopts::value<std::vector<size_t>>()->default_value("32"))
+        ("prefetch_distance", "Number of keys and records the rolling lookup prefetches ahead", cxxopts::value<std::vector<size_t>>()->default_value("16"))
+        ("number_keys", "Number of keys to fill the hashmap with", cxxopts::value<std::vector<long>>()->default_value("2000000"))
+        ("number_buckets", "Number of buckets in the chained hashmap", cxxopts::value<std::vector<size_t>>()->default_value("2000000"))
+        ("num_lookups", "Number of lookups", cxxopts::value<std::vector<size_t>>()->default_value("10000000"))
+        ("run_on_node", "NUMA node the lookup thread is pinned to", cxxopts::value<std::vector<NodeID>>()->default_value("0"))
+        ("alloc_on_node", "NUMA node the hashmap and the payloads are allocated on", cxxopts::value<std::vector<NodeID>>()->default_value("0"))
+        ("madvise_huge_pages", "Madvise kernel to create huge pages on mem regions", cxxopts::value<std::vector<bool>>()->default_value("true"));
+    // clang-format on
+    benchmark_config.parse(argc, argv);
+
+    int benchmark_run = 0;
+    for (auto &runtime_config : benchmark_config.get_runtime_configs())
+    {
+        PayloadBenchmarkConfig config{
+            runtime_config["mode"],
+            convert<size_t>(runtime_config["payload_size"]),
+            convert<size_t>(runtime_config["batch_size"]),
+            convert<size_t>(runtime_config["group_size"]),
+            convert<size_t>(runtime_config["prefetch_distance"]),
+            convert<size_t>(runtime_config["num_lookups"])};
+        auto num_keys = convert<long>(runtime_config["number_keys"]);
+        auto run_on_node = convert<NodeID>(runtime_config["run_on_node"]);
+        auto alloc_on_node = convert<NodeID>(runtime_config["alloc_on_node"]);
+
+        if (config.mode != "naive" && config.mode != "amac" && config.mode != "coroutine" && config.mode != "rolling")
+        {
+            std::cout << "Unknown Mode Defined: " << config.mode << std::endl;
+            continue;
+        }
+        if (config.payload_size < sizeof(uint32_t))
+        {
+            std::cout << "Payloads have to hold at least the key." << std::endl;
+            continue;
+        }
+        pin_to_cpu(manager.node_to_available_cpus[run_on_node][0]);
+
+        PrefetchProfiler profiler{30};
+        StaticNumaMemoryResource mem_res{alloc_on_node, false, convert<bool>(runtime_config["madvise_huge_pages"])};
+        PayloadArena arena{config.payload_size, static_cast<size_t>(num_keys), mem_res};
+        HashMap<uint32_t, uint32_t> map{convert<size_t>(runtime_config["number_buckets"]), profiler, mem_res};
+
+        // Every record starts with its key, so that lookups can be validated.
+        std::vector<char> record(config.payload_size, 0);
+        for (uint32_t i = 0; i < num_keys; i++)
+        {
+            std::memcpy(record.data(), &i, sizeof(i));
+            map.insert(i, arena.append(record.data()));
+        }
+
+        const double total_time = run_lookups(map, arena, config, num_keys);
+        const double throughput = config.num_lookups / total_time;
+        std::cout << config.mode << " payload_size " << config.payload_size << ": " << throughput << " lookups/second" << std::endl;
+
+        nlohmann::json results;
+        results["config"]["mode"] = config.mode;
+        results["config"]["payload_size"] = config.payload_size;
+        results["config"]["batch_size"] = config.batch_size;
+        results["config"]["group_size"] = config.group_size;
+        results["config"]["prefetch_distance"] = config.prefetch_distance;
+        results["config"]["number_keys"] = num_keys;
+        results["config"]["run_on_node"] = run_on_node;
+        results["config"]["alloc_on_node"] = alloc_on_node;
+        results["time"] = total_time;
+        results["throughput"] = throughput;
+
+        auto results_file = std::ofstream{"payload_hashmap_benchmark_" + std::to_string(benchmark_run++) + ".json"};
+        results_file << results.dump(-1) << std::flush;
+    }
+
+    return 0;
+}
@@ -1,96 +1,332 @@
 #include "random_access.hpp"
+#include "prefetching.hpp"
 
 #include <random>
 #include <functional>
 #include <chrono>
 #include <assert.h>
-#include "zipfian_int_distribution.hpp"
+#include <nlohmann/json.hpp>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <optional>
 #include <iostream>
 
-const int NUM_VALUES = 6'000'000; // ~ roughly 24MB seems to be the sweet-spot for low tlb misses, high cache misses
-const int TOTAL_QUERIES = 25'000'000;
-const int GROUP_SIZE = 32;
-const int AMAC_REQUESTS_SIZE = 1024;
+#include "zipfian_int_distribution.hpp"
+#include "numa/numa_memory_resource_no_jemalloc.hpp"
+#include "../lib/utils/utils.hpp"
 
-template <typename Function>
-void measure_vectorized_operation(RandomAccess<uint8_t> &random_access, Function func, const std::string &op_name, int invoke_vector_size, auto gen, auto dis)
+struct RandomReadBenchmarkConfig
 {
-    auto start = std::chrono::high_resolution_clock::now();
-    auto end = std::chrono::high_resolution_clock::now();
-    double total_time = 0;
+    std::string distribution;
+    double zipf_theta;
+    size_t element_size;
+    // ~ 6M 32 bit elements (roughly 24MB) seem to be the sweet-spot for low tlb misses, high cache misses
+    size_t num_elements;
+    size_t num_threads;
+    size_t num_queries;
+    size_t group_size;
+    size_t batch_size;
+    size_t gather_prefetch_distance;
+    size_t prefetch_distance;
+    bool prefetch_all_lines;
+    NodeID run_on_node;
+    NodeID alloc_on_node;
+    bool use_explicit_huge_pages;
+    bool madvise_huge_pages;
+    bool profile;
+};
+
+// Positions read by one thread, split into the batches passed to the read function.
+std::vector<std::vector<size_t>> generate_requests(const RandomReadBenchmarkConfig &config, size_t thread_id, size_t invoke_vector_size)
+{
+    std::mt19937 gen(thread_id);
+    std::uniform_int_distribution<size_t> uniform_dis(0, config.num_elements - 1);
+    // Constructing the zipfian distribution computes zeta over all positions, so only do it when needed.
+    std::optional<zipfian_int_distribution<int>> zipfian_dis;
+    if (config.distribution == "zipfian")
+    {
+        zipfian_dis.emplace(zipfian_int_distribution<int>::param_type(0, config.num_elements - 1, config.zipf_theta));
+    }
 
-    std::vector<size_t> requests(invoke_vector_size);
-    std::vector<uint8_t> results(invoke_vector_size);
-    for (int i = 0; i < TOTAL_QUERIES; i += invoke_vector_size)
+    const size_t queries_per_thread = config.num_queries / config.num_threads;
+    std::vector<std::vector<size_t>> batches;
+    for (size_t i = 0; i < queries_per_thread; i += invoke_vector_size)
     {
-        for (int j = 0; j < invoke_vector_size; j++)
+        auto &batch = batches.emplace_back(std::min(invoke_vector_size, queries_per_thread - i));
+        for (auto &request : batch)
         {
-            int random_number = dis(gen); // will generate duplicates, we don't care
-            requests.at(j) = random_number;
+            // will generate duplicates, we don't care
+            request = zipfian_dis ? (*zipfian_dis)(gen) : uniform_dis(gen);
         }
+    }
+    return batches;
+}
 
-        start = std::chrono::high_resolution_clock::now();
-        func(requests, results, GROUP_SIZE);
-        end = std::chrono::high_resolution_clock::now();
-        total_time += std::chrono::duration<double>(end - start).count();
+template <typename V, typename Function>
+void measure_vectorized_operation(RandomAccess<V> &random_access, Function func, const std::string &op_name, size_t invoke_vector_size, nlohmann::json &metrics, const RandomReadBenchmarkConfig &config)
+{
+    auto &perf_manager = Prefetching::get().perf_manager;
+    auto mt_event_counter = perf_manager.get_mt_event_counter(config.num_threads);
 
-        for (int j = 0; j < invoke_vector_size; j++)
-        {
-            if (!(results.at(j) == (requests.at(j) % 256)))
+    // Every thread issues its share of the reads, the slowest thread determines the total time.
+    std::vector<double> thread_times(config.num_threads, 0);
+    std::vector<std::jthread> threads;
+    std::atomic<size_t> threads_ready = 0;
+    std::atomic<bool> start_reads = false;
+    for (size_t t = 0; t < config.num_threads; ++t)
+    {
+        threads.emplace_back([&, t]()
+                             {
+            pin_to_cpu(Prefetching::get().numa_manager.node_to_available_cpus[config.run_on_node][t]);
+
+            // Positions are generated before the timed section. All batches reuse one result buffer that stays
+            // cache resident, as the reads of a batch would in a real operator.
+            auto requests = generate_requests(config, t, invoke_vector_size);
+            std::vector<V> results(invoke_vector_size);
+
+            threads_ready++;
+            while (!start_reads)
             {
-                perror("random read returned wrong value.");
-                exit(-1);
+                wait_cycles(100);
             }
-        }
+
+            if (config.profile)
+            {
+                mt_event_counter.start(t);
+            }
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t b = 0; b < requests.size(); ++b)
+            {
+                results.resize(requests[b].size());
+                func(requests[b], results, config.group_size);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            if (config.profile)
+            {
+                mt_event_counter.stop(t);
+            }
+            thread_times[t] = std::chrono::duration<double>(end - start).count();
+
+            // The buffer only holds the last batch, so the batches are read again for validation, untimed.
+            for (size_t b = 0; b < requests.size(); ++b)
+            {
+                results.resize(requests[b].size());
+                func(requests[b], results, config.group_size);
+                for (size_t j = 0; j < requests[b].size(); j++)
+                {
+                    if (!(results.at(j) == static_cast<V>(requests[b].at(j))))
+                    {
+                        perror("random read returned wrong value.");
+                        exit(-1);
+                    }
+                }
+            } });
+    }
+    while (threads_ready < config.num_threads)
+    {
+        wait_cycles(100);
+    }
+    start_reads = true;
+    for (auto &thread : threads)
+    {
+        thread.join();
     }
 
-    double throughput = TOTAL_QUERIES / total_time;
+    const size_t total_queries = config.num_queries / config.num_threads * config.num_threads;
+    double total_time = *std::max_element(thread_times.begin(), thread_times.end());
+    double throughput = total_queries / total_time;
 
     std::cout << std::endl;
     std::cout << op_name << std::endl;
     std::cout << "Total time taken: " << total_time << " seconds" << std::endl;
     std::cout << "Throughput: " << throughput << " queries/second" << std::endl;
+    metrics[op_name]["time"] = total_time;
+    metrics[op_name]["throughput"] = throughput;
+    if (config.profile)
+    {
+        perf_manager.result(mt_event_counter, metrics[op_name], total_queries);
+    }
 }
 
-void execute_benchmark(RandomAccess<uint8_t> &random_access, int GROUP_SIZE, int AMAC_REQUEST_SIZE, auto gen, auto dis)
+template <typename V>
+nlohmann::json execute_benchmark(RandomAccess<V> &random_access, const RandomReadBenchmarkConfig &config)
 {
+    nlohmann::json results;
     measure_vectorized_operation(
-        random_access, [&](auto &a, auto &b, auto &c)
+        random_access, [&](auto &a, auto &b, auto c)
         { random_access.vectorized_get_amac(a, b, c); },
-        "Vectorized_get_amac()", AMAC_REQUESTS_SIZE, gen, dis);
+        "Vectorized_get_amac()", config.batch_size, results, config);
     measure_vectorized_operation(
-        random_access, [&](auto &a, auto &b, auto &c)
+        random_access, [&](auto &a, auto &b, auto c)
         { random_access.vectorized_get_coroutine(a, b, c); },
-        "Vectorized_get_co()", AMAC_REQUESTS_SIZE, gen, dis);
+        "Vectorized_get_co()", config.batch_size, results, config);
     measure_vectorized_operation(
-        random_access, [&](auto &a, auto &b, auto &c)
+        random_access, [&](auto &a, auto &b, auto c)
         { random_access.vectorized_get_gp(a, b); },
-        "Vectorized_get_gp()", GROUP_SIZE, gen, dis);
+        "Vectorized_get_gp()", config.group_size, results, config);
     measure_vectorized_operation(
-        random_access, [&](auto &a, auto &b, auto &c)
+        random_access, [&](auto &a, auto &b, auto c)
         { random_access.vectorized_get(a, b); },
-        "Vectorized_get()", GROUP_SIZE, gen, dis);
+        "Vectorized_get()", config.group_size, results, config);
     measure_vectorized_operation(
-        random_access, [&](auto &a, auto &b, auto &c)
+        random_access, [&](auto &a, auto &b, auto c)
         { random_access.vectorized_get_coroutine_exp(a, b, c); },
-        "vectorized_get_coroutine_exp()", AMAC_REQUESTS_SIZE, gen, dis);
-};
+        "vectorized_get_coroutine_exp()", config.batch_size, results, config);
+    measure_vectorized_operation(
+        random_access, [&](auto &a, auto &b, auto c)
+        { random_access.vectorized_get_rolling(a, b, config.prefetch_distance); },
+        "Vectorized_get_rolling()", config.batch_size, results, config);
+    // Sweep batch_size to find the crossover between reordering and interleaving.
+    measure_vectorized_operation(
+        random_access, [&](auto &a, auto &b, auto c)
+        { random_access.vectorized_get_reorder(a, b, BatchReorder::page_shift); },
+        "Vectorized_get_reorder_page()", config.batch_size, results, config);
+    measure_vectorized_operation(
+        random_access, [&](auto &a, auto &b, auto c)
+        { random_access.vectorized_get_reorder(a, b, BatchReorder::huge_page_shift); },
+        "Vectorized_get_reorder_huge_page()", config.batch_size, results, config);
+    // Hardware gathers only exist for 32 and 64 bit elements.
+    if constexpr (sizeof(V) == 4 || sizeof(V) == 8)
+    {
+        measure_vectorized_operation(
+            random_access, [&](auto &a, auto &b, auto c)
+            { random_access.vectorized_get_gather(a, b); },
+            "Vectorized_get_gather()", config.batch_size, results, config);
+        measure_vectorized_operation(
+            random_access, [&](auto &a, auto &b, auto c)
+            { random_access.vectorized_get_gather(a, b, config.gather_prefetch_distance); },
+            "Vectorized_get_gather_prefetch()", config.batch_size, results, config);
+    }
+    return results;
+}
 
-int main()
+template <typename V>
+void run(const RandomReadBenchmarkConfig &config, nlohmann::json &results)
 {
-    RandomAccess<uint8_t> random_access{size_t{NUM_VALUES}};
+    // Pages are bound to alloc_on_node by the memory resource, filling them from that node avoids remote first touches.
+    auto &alloc_cpus = Prefetching::get().numa_manager.node_to_available_cpus[config.alloc_on_node];
+    if (alloc_cpus.size() > 0)
+    {
+        pin_to_cpus(alloc_cpus);
+    }
+    NumaMemoryResourceNoJemalloc mem_res{config.alloc_on_node, config.use_explicit_huge_pages, config.madvise_huge_pages};
+    RandomAccess<V> random_access{config.num_elements, mem_res};
+    random_access.set_prefetch_all_lines(config.prefetch_all_lines);
 
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> uniform_dis(0, NUM_VALUES - 1);
+    std::cout << "----- Measuring " << config.distribution << " Accesses (" << config.element_size << " byte elements, " << config.num_threads << " threads) -----" << std::endl;
+    results["reads"] = execute_benchmark(random_access, config);
+}
 
-    zipfian_int_distribution<int>::param_type p(1, 1e6, 0.99, 27.000);
-    zipfian_int_distribution<int> zipfian_distribution(p);
+int main(int argc, char **argv)
+{
+    auto &manager = Prefetching::get().numa_manager;
+    auto &benchmark_config = Prefetching::get().runtime_config;
+    // clang-format off
+    benchmark_config.add_options()
+        ("d,distribution", "Type of distribution (uniform,zipfian)", cxxopts::value<std::vector<std::string>>()->default_value("uniform,zipfian"))
+        ("zipf_theta", "Skew of the zipfian distribution", cxxopts::value<std::vector<double>>()->default_value("0.99"))
+        ("element_size", "Size of an element in bytes (1,2,4,8 or records of 64,128,256,512)", cxxopts::value<std::vector<size_t>>()->default_value("1"))
+        ("num_elements", "Number of elements to read from", cxxopts::value<std::vector<size_t>>()->default_value("6000000"))
+        ("num_threads", "Number of reading threads", cxxopts::value<std::vector<size_t>>()->default_value("1"))
+        ("num_queries", "Number of reads across all threads", cxxopts::value<std::vector<size_t>>()->default_value("25000000"))
+        ("group_size", "Number of interleaved reads (AMAC, coroutines), batch size of group prefetching", cxxopts::value<std::vector<size_t>>()->default_value("32"))
+        ("batch_size", "Number of positions per call of the AMAC, coroutine, gather and reordered reads", cxxopts::value<std::vector<size_t>>()->default_value("1024"))
+        ("gather_prefetch_distance", "Number of positions the prefetching gather prefetches ahead", cxxopts::value<std::vector<size_t>>()->default_value("64"))
+        ("prefetch_distance", "Number of elements the rolling reads prefetch ahead", cxxopts::value<std::vector<size_t>>()->default_value("16"))
+        ("prefetch_all_lines", "Prefetch every cache line of multi-line records instead of only the first one", cxxopts::value<std::vector<bool>>()->default_value("true"))
+        ("run_on_node", "NUMA node whose CPUs the threads are pinned to", cxxopts::value<std::vector<NodeID>>()->default_value("0"))
+        ("alloc_on_node", "NUMA node the elements are allocated on", cxxopts::value<std::vector<NodeID>>()->default_value("0"))
+        ("use_explicit_huge_pages", "Use huge pages during allocation", cxxopts::value<std::vector<bool>>()->default_value("false"))
+        ("madvise_huge_pages", "Madvise kernel to create huge pages on mem regions", cxxopts::value<std::vector<bool>>()->default_value("true"))
+        ("profile", "Collect perf counters per read variant", cxxopts::value<std::vector<bool>>()->default_value("false"));
+    // clang-format on
+    benchmark_config.parse(argc, argv);
 
-    std::cout << "----- Measuring Uniform Accesses -----" << std::endl;
-    execute_benchmark(random_access, GROUP_SIZE, AMAC_REQUESTS_SIZE, gen, uniform_dis);
-    std::cout << "----- Measuring Zipfian Accesses -----" << std::endl;
-    execute_benchmark(random_access, GROUP_SIZE, AMAC_REQUESTS_SIZE, gen, zipfian_distribution);
+    int benchmark_run = 0;
+    for (auto &runtime_config : benchmark_config.get_runtime_configs())
+    {
+        RandomReadBenchmarkConfig config{
+            runtime_config["distribution"],
+            convert<double>(runtime_config["zipf_theta"]),
+            convert<size_t>(runtime_config["element_size"]),
+            convert<size_t>(runtime_config["num_elements"]),
+            convert<size_t>(runtime_config["num_threads"]),
+            convert<size_t>(runtime_config["num_queries"]),
+            convert<size_t>(runtime_config["group_size"]),
+            convert<size_t>(runtime_config["batch_size"]),
+            convert<size_t>(runtime_config["gather_prefetch_distance"]),
+            convert<size_t>(runtime_config["prefetch_distance"]),
+            convert<bool>(runtime_config["prefetch_all_lines"]),
+            convert<NodeID>(runtime_config["run_on_node"]),
+            convert<NodeID>(runtime_config["alloc_on_node"]),
+            convert<bool>(runtime_config["use_explicit_huge_pages"]),
+            convert<bool>(runtime_config["madvise_huge_pages"]),
+            convert<bool>(runtime_config["profile"])};
+
+        if (config.num_threads > manager.node_to_available_cpus[config.run_on_node].size())
+        {
+            std::cout << "Not enough CPUs on node " << config.run_on_node << " for " << config.num_threads << " threads." << std::endl;
+            continue;
+        }
+        if (config.distribution != "uniform" && config.distribution != "zipfian")
+        {
+            std::cout << "Unknown Distribution Defined: " << config.distribution << std::endl;
+            continue;
+        }
+
+        nlohmann::json results;
+        results["config"]["distribution"] = config.distribution;
+        results["config"]["zipf_theta"] = config.zipf_theta;
+        results["config"]["element_size"] = config.element_size;
+        results["config"]["num_elements"] = config.num_elements;
+        results["config"]["num_threads"] = config.num_threads;
+        results["config"]["num_queries"] = config.num_queries;
+        results["config"]["group_size"] = config.group_size;
+        results["config"]["batch_size"] = config.batch_size;
+        results["config"]["gather_prefetch_distance"] = config.gather_prefetch_distance;
+        results["config"]["prefetch_distance"] = config.prefetch_distance;
+        results["config"]["prefetch_all_lines"] = config.prefetch_all_lines;
+        results["config"]["run_on_node"] = config.run_on_node;
+        results["config"]["alloc_on_node"] = config.alloc_on_node;
+        results["config"]["use_explicit_huge_pages"] = config.use_explicit_huge_pages;
+        results["config"]["madvise_huge_pages"] = config.madvise_huge_pages;
+        results["config"]["profile"] = config.profile;
+
+        switch (config.element_size)
+        {
+        case 1:
+            run<uint8_t>(config, results);
+            break;
+        case 2:
+            run<uint16_t>(config, results);
+            break;
+        case 4:
+            run<uint32_t>(config, results);
+            break;
+        case 8:
+            run<uint64_t>(config, results);
+            break;
+        case 64:
+            run<Record<64>>(config, results);
+            break;
+        case 128:
+            run<Record<128>>(config, results);
+            break;
+        case 256:
+            run<Record<256>>(config, results);
+            break;
+        case 512:
+            run<Record<512>>(config, results);
+            break;
+        default:
+            std::cout << "Unsupported Element Size: " << config.element_size << std::endl;
+            continue;
+        }
+
+        auto results_file = std::ofstream{"random_read_benchmark_" + std::to_string(benchmark_run++) + ".json"};
+        results_file << results.dump(-1) << std::flush;
+    }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -6,6 +6,7 @@
 #include <iostream>
 #include <sched.h>
 #include "builtin.h"
+#include "olc_stats.h"
 
 #include "../utils/simple_continuous_allocator.hpp"
 
@@ -30,6 +31,7 @@ namespace btreeolc
             version = typeVersionLockObsolete.load();
             if (isLocked(version) || isObsolete(version))
             {
+                stats::pause_spin();
                 builtin::pause();
                 needRestart = true;
             }
@@ -56,6 +58,7 @@ namespace btreeolc
             }
             else
             {
+                stats::upgrade_failure();
                 builtin::pause();
                 needRestart = true;
             }
@@ -75,7 +78,7 @@ namespace btreeolc
         void writeUnlockObsolete() { typeVersionLockObsolete.fetch_add(0b11); }
     };
 
-    template <const uint64_t pageSize>
+    template <const uint64_t innerSize, const uint64_t leafSize>
     struct NodeBase : public OptLock
     {
         PageType type;
@@ -84,16 +87,16 @@ namespace btreeolc
         virtual ~NodeBase() = default;
     };
 
-    template <const uint64_t pageSize>
-    struct BTreeLeafBase : public NodeBase<pageSize>
+    template <const uint64_t innerSize, const uint64_t leafSize>
+    struct BTreeLeafBase : public NodeBase<innerSize, leafSize>
     {
         static const PageType typeMarker = PageType::BTreeLeaf;
 
         virtual ~BTreeLeafBase() = default;
     };
 
-    template <class Key, class Payload, const uint64_t pageSize>
-    struct BTreeLeaf : public BTreeLeafBase<pageSize>
+    template <class Key, class Payload, const uint64_t innerSize, const uint64_t leafSize>
+    struct BTreeLeaf : public BTreeLeafBase<innerSize, leafSize>
     {
         struct Entry
         {
@@ -101,7 +104,7 @@ namespace btreeolc
             Payload p;
         };
 
-        static const uint64_t maxEntries = (pageSize - sizeof(NodeBase<pageSize>)) / (sizeof(Key) + sizeof(Payload));
+        static const uint64_t maxEntries = (leafSize - sizeof(NodeBase<innerSize, leafSize>)) / (sizeof(Key) + sizeof(Payload));
 
         Key keys[maxEntries];
         Payload payloads[maxEntries];
@@ -177,10 +180,10 @@ namespace btreeolc
             this->count++;
         }
 
-        BTreeLeaf<Key, Payload, pageSize> *split(Key &sep, SimpleContinuousAllocator &allocator)
+        BTreeLeaf<Key, Payload, innerSize, leafSize> *split(Key &sep, SimpleContinuousAllocator &allocator)
         {
-            void *new_leaf_memory = allocator.allocate(sizeof(BTreeLeaf<Key, Payload, pageSize>), alignof(BTreeLeaf<Key, Payload, pageSize>));
-            BTreeLeaf<Key, Payload, pageSize> *newLeaf = new (new_leaf_memory) BTreeLeaf<Key, Payload, pageSize>();
+            void *new_leaf_memory = allocator.allocate(sizeof(BTreeLeaf<Key, Payload, innerSize, leafSize>), alignof(BTreeLeaf<Key, Payload, innerSize, leafSize>));
+            BTreeLeaf<Key, Payload, innerSize, leafSize> *newLeaf = new (new_leaf_memory) BTreeLeaf<Key, Payload, innerSize, leafSize>();
             newLeaf->count = this->count - (this->count / 2);
             this->count = this->count - newLeaf->count;
             memcpy(newLeaf->keys, keys + this->count, sizeof(Key) * newLeaf->count);
@@ -190,19 +193,19 @@ namespace btreeolc
         }
     };
 
-    template <const uint64_t pageSize>
-    struct BTreeInnerBase : public NodeBase<pageSize>
+    template <const uint64_t innerSize, const uint64_t leafSize>
+    struct BTreeInnerBase : public NodeBase<innerSize, leafSize>
     {
         static const PageType typeMarker = PageType::BTreeInner;
 
         virtual ~BTreeInnerBase() = default;
     };
 
-    template <class Key, const uint64_t pageSize>
-    struct BTreeInner : public BTreeInnerBase<pageSize>
+    template <class Key, const uint64_t innerSize, const uint64_t leafSize>
+    struct BTreeInner : public BTreeInnerBase<innerSize, leafSize>
     {
-        static const uint64_t maxEntries = (pageSize - sizeof(NodeBase<pageSize>)) / (sizeof(Key) + sizeof(NodeBase<pageSize> *));
-        NodeBase<pageSize> *children[maxEntries];
+        static const uint64_t maxEntries = (innerSize - sizeof(NodeBase<innerSize, leafSize>)) / (sizeof(Key) + sizeof(NodeBase<innerSize, leafSize> *));
+        NodeBase<innerSize, leafSize> *children[maxEntries];
         Key keys[maxEntries];
 
         BTreeInner()
@@ -260,24 +263,24 @@ namespace btreeolc
             return lower;
         }
 
-        BTreeInner<Key, pageSize> *split(Key &sep, SimpleContinuousAllocator &allocator)
+        BTreeInner<Key, innerSize, leafSize> *split(Key &sep, SimpleContinuousAllocator &allocator)
         {
-            void *new_inner_memory = allocator.allocate(sizeof(BTreeInner<Key, pageSize>), alignof(BTreeInner<Key, pageSize>));
-            BTreeInner<Key, pageSize> *newInner = new (new_inner_memory) BTreeInner<Key, pageSize>();
+            void *new_inner_memory = allocator.allocate(sizeof(BTreeInner<Key, innerSize, leafSize>), alignof(BTreeInner<Key, innerSize, leafSize>));
+            BTreeInner<Key, innerSize, leafSize> *newInner = new (new_inner_memory) BTreeInner<Key, innerSize, leafSize>();
             newInner->count = this->count - (this->count / 2);
             this->count = this->count - newInner->count - 1;
             sep = keys[this->count];
             memcpy(newInner->keys, keys + this->count + 1, sizeof(Key) * (newInner->count + 1));
-            memcpy(newInner->children, children + this->count + 1, sizeof(NodeBase<pageSize> *) * (newInner->count + 1));
+            memcpy(newInner->children, children + this->count + 1, sizeof(NodeBase<innerSize, leafSize> *) * (newInner->count + 1));
             return newInner;
         }
 
-        void insert(Key k, NodeBase<pageSize> *child)
+        void insert(Key k, NodeBase<innerSize, leafSize> *child)
         {
             assert(this->count < maxEntries - 1);
             unsigned pos = lowerBound(k);
             memmove(keys + pos + 1, keys + pos, sizeof(Key) * (this->count - pos + 1));
-            memmove(children + pos + 1, children + pos, sizeof(NodeBase<pageSize> *) * (this->count - pos + 1));
+            memmove(children + pos + 1, children + pos, sizeof(NodeBase<innerSize, leafSize> *) * (this->count - pos + 1));
             keys[pos] = k;
             children[pos] = child;
             std::swap(children[pos], children[pos + 1]);
@@ -285,24 +288,24 @@ namespace btreeolc
         }
     };
 
-    template <class Key, class Value, const uint64_t pageSize>
+    template <class Key, class Value, const uint64_t innerSize, const uint64_t leafSize>
     struct BTree
     {
-        std::atomic<NodeBase<pageSize> *> root;
+        std::atomic<NodeBase<innerSize, leafSize> *> root;
         SimpleContinuousAllocator &allocator;
 
         BTree(SimpleContinuousAllocator &allocator) : allocator(allocator)
         {
-            void *new_leaf_memory = allocator.allocate(sizeof(BTreeLeaf<Key, Value, pageSize>), alignof(BTreeLeaf<Key, Value, pageSize>));
-            root = new (new_leaf_memory) BTreeLeaf<Key, Value, pageSize>();
+            void *new_leaf_memory = allocator.allocate(sizeof(BTreeLeaf<Key, Value, innerSize, leafSize>), alignof(BTreeLeaf<Key, Value, innerSize, leafSize>));
+            root = new (new_leaf_memory) BTreeLeaf<Key, Value, innerSize, leafSize>();
         }
 
         ~BTree() { root.load()->~NodeBase(); }
 
-        void makeRoot(Key k, NodeBase<pageSize> *leftChild, NodeBase<pageSize> *rightChild)
+        void makeRoot(Key k, NodeBase<innerSize, leafSize> *leftChild, NodeBase<innerSize, leafSize> *rightChild)
         {
-            void *new_inner_memory = allocator.allocate(sizeof(BTreeInner<Key, pageSize>), alignof(BTreeInner<Key, pageSize>));
-            auto inner = new (new_inner_memory) BTreeInner<Key, pageSize>();
+            void *new_inner_memory = allocator.allocate(sizeof(BTreeInner<Key, innerSize, leafSize>), alignof(BTreeInner<Key, innerSize, leafSize>));
+            auto inner = new (new_inner_memory) BTreeInner<Key, innerSize, leafSize>();
             inner->count = 1;
             inner->keys[0] = k;
             inner->children[0] = leftChild;
@@ -315,30 +318,38 @@ namespace btreeolc
             if (count > 3)
                 sched_yield();
             else
+            {
+                stats::pause_spin();
                 builtin::pause();
+            }
         }
 
         void insert(Key k, Value v)
         {
             int restartCount = 0;
+            unsigned level = 0;
         restart:
             if (restartCount++)
+            {
+                stats::restart(level);
                 yield(restartCount);
+            }
+            level = 0;
             bool needRestart = false;
 
             // Current node
-            NodeBase<pageSize> *node = root;
+            NodeBase<innerSize, leafSize> *node = root;
             uint64_t versionNode = node->readLockOrRestart(needRestart);
             if (needRestart || (node != root))
                 goto restart;
 
             // Parent of current node
-            BTreeInner<Key, pageSize> *parent = nullptr;
+            BTreeInner<Key, innerSize, leafSize> *parent = nullptr;
             uint64_t versionParent;
 
             while (node->type == PageType::BTreeInner)
             {
-                auto inner = static_cast<BTreeInner<Key, pageSize> *>(node);
+                auto inner = static_cast<BTreeInner<Key, innerSize, leafSize> *>(node);
 
                 // Split eagerly if full
                 if (inner->isFull())
@@ -364,7 +375,8 @@ namespace btreeolc
                     }
                     // Split
                     Key sep;
-                    BTreeInner<Key, pageSize> *newInner = inner->split(sep, allocator);
+                    BTreeInner<Key, innerSize, leafSize> *newInner = inner->split(sep, allocator);
+                    stats::inner_split();
                     if (parent)
                         parent->insert(sep, newInner);
                     else
@@ -387,6 +399,7 @@ namespace btreeolc
                 versionParent = versionNode;
 
                 node = inner->children[inner->lowerBound(k)];
+                level++;
                 inner->checkOrRestart(versionNode, needRestart);
                 if (needRestart)
                     goto restart;
@@ -395,7 +408,7 @@ namespace btreeolc
                     goto restart;
             }
 
-            auto leaf = static_cast<BTreeLeaf<Key, Value, pageSize> *>(node);
+            auto leaf = static_cast<BTreeLeaf<Key, Value, innerSize, leafSize> *>(node);
 
             // Split leaf if full
             if (leaf->count == leaf->maxEntries)
@@ -421,7 +434,8 @@ namespace btreeolc
                 }
                 // Split
                 Key sep;
-                BTreeLeaf<Key, Value, pageSize> *newLeaf = leaf->split(sep, allocator);
+                BTreeLeaf<Key, Value, innerSize, leafSize> *newLeaf = leaf->split(sep, allocator);
+                stats::leaf_split();
                 if (parent)
                     parent->insert(sep, newLeaf);
                 else
@@ -456,23 +470,28 @@ namespace btreeolc
         bool lookup(Key k, Value &result)
         {
             int restartCount = 0;
+            unsigned level = 0;
         restart:
             if (restartCount++)
+            {
+                stats::restart(level);
                 yield(restartCount);
+            }
+            level = 0;
             bool needRestart = false;
 
-            NodeBase<pageSize> *node = root;
+            NodeBase<innerSize, leafSize> *node = root;
             uint64_t versionNode = node->readLockOrRestart(needRestart);
             if (needRestart || (node != root))
                 goto restart;
 
             // Parent of current node
-            BTreeInner<Key, pageSize> *parent = nullptr;
+            BTreeInner<Key, innerSize, leafSize> *parent = nullptr;
             uint64_t versionParent;
 
             while (node->type == PageType::BTreeInner)
             {
-                auto inner = static_cast<BTreeInner<Key, pageSize> *>(node);
+                auto inner = static_cast<BTreeInner<Key, innerSize, leafSize> *>(node);
 
                 if (parent)
                 {
@@ -485,6 +504,7 @@ namespace btreeolc
                 versionParent = versionNode;
 
                 node = inner->children[inner->lowerBound(k)];
+                level++;
                 inner->checkOrRestart(versionNode, needRestart);
                 if (needRestart)
                     goto restart;
@@ -493,7 +513,7 @@ namespace btreeolc
                     goto restart;
             }
 
-            BTreeLeaf<Key, Value, pageSize> *leaf = static_cast<BTreeLeaf<Key, Value, pageSize> *>(node);
+            BTreeLeaf<Key, Value, innerSize, leafSize> *leaf = static_cast<BTreeLeaf<Key, Value, innerSize, leafSize> *>(node);
             unsigned pos = leaf->lowerBound(k);
             bool success;
             if ((pos < leaf->count) && (leaf->keys[pos] == k))
@@ -517,23 +537,28 @@ namespace btreeolc
         uint64_t scan(Key k, int range, Value *output)
         {
             int restartCount = 0;
+            unsigned level = 0;
         restart:
             if (restartCount++)
+            {
+                stats::restart(level);
                 yield(restartCount);
+            }
+            level = 0;
             bool needRestart = false;
 
-            NodeBase<pageSize> *node = root;
+            NodeBase<innerSize, leafSize> *node = root;
             uint64_t versionNode = node->readLockOrRestart(needRestart);
             if (needRestart || (node != root))
                 goto restart;
 
             // Parent of current node
-            BTreeInner<Key, pageSize> *parent = nullptr;
+            BTreeInner<Key, innerSize, leafSize> *parent = nullptr;
             uint64_t versionParent;
 
             while (node->type == PageType::BTreeInner)
             {
-                auto inner = static_cast<BTreeInner<Key, pageSize> *>(node);
+                auto inner = static_cast<BTreeInner<Key, innerSize, leafSize> *>(node);
 
                 if (parent)
                 {
@@ -546,6 +571,7 @@ namespace btreeolc
                 versionParent = versionNode;
 
                 node = inner->children[inner->lowerBound(k)];
+                level++;
                 inner->checkOrRestart(versionNode, needRestart);
                 if (needRestart)
                     goto restart;
@@ -554,7 +580,7 @@ namespace btreeolc
                     goto restart;
             }
 
-            BTreeLeaf<Key, Value, pageSize> *leaf = static_cast<BTreeLeaf<Key, Value, pageSize> *>(node);
+            BTreeLeaf<Key, Value, innerSize, leafSize> *leaf = static_cast<BTreeLeaf<Key, Value, innerSize, leafSize> *>(node);
             unsigned pos = leaf->lowerBound(k);
             int count = 0;
             for (unsigned i = pos; i < leaf->count; i++)
@@ -8,6 +8,7 @@
 #include <coroutine>
 #include "prefetch.h"
 #include "builtin.h"
+#include "olc_stats.h"
 
 #include "../utils/simple_continuous_allocator.hpp"
 
@@ -74,6 +75,7 @@ struct OptLock
         version = typeVersionLockObsolete.load();
         if (isLocked(version) || isObsolete(version))
         {
+            stats::pause_spin();
             builtin::pause();
             needRestart = true;
         }
@@ -100,6 +102,7 @@ struct OptLock
         }
         else
         {
+            stats::upgrade_failure();
             builtin::pause();
             needRestart = true;
         }
@@ -119,30 +122,40 @@ struct OptLock
     void writeUnlockObsolete() { typeVersionLockObsolete.fetch_add(0b11); }
 };
 
-template <const uint64_t pageSize, const uint64_t cacheLineSize>
+template <const uint64_t innerSize, const uint64_t leafSize, const uint64_t cacheLineSize>
 struct NodeBase : public OptLock
 {
     PageType type;
+    // Type of the children, only maintained for inner nodes. Inner and leaf nodes differ in size, so the parent has
+    // to know how many lines to prefetch before the child's header is in cache.
+    PageType childType;
     uint16_t count;
 
-    void prefetch_node()
+    void prefetch_node(PageType nodeType)
     {
-        SWPrefetcher::prefetch<0U, pageSize / cacheLineSize, SWPrefetcher::Target::ALL>(this);
+        if (nodeType == PageType::BTreeInner)
+        {
+            SWPrefetcher::prefetch<0U, innerSize / cacheLineSize, SWPrefetcher::Target::ALL>(this);
+        }
+        else
+        {
+            SWPrefetcher::prefetch<0U, leafSize / cacheLineSize, SWPrefetcher::Target::ALL>(this);
+        }
     }
 
     virtual ~NodeBase() = default;
 };
 
-template <const uint64_t pageSize, const uint64_t cacheLineSize>
-struct BTreeLeafBase : public NodeBase<pageSize, cacheLineSize>
+template <const uint64_t innerSize, const uint64_t leafSize, const uint64_t cacheLineSize>
+struct BTreeLeafBase : public NodeBase<innerSize, leafSize, cacheLineSize>
 {
     static const PageType typeMarker = PageType::BTreeLeaf;
 
     virtual ~BTreeLeafBase() = default;
 };
 
-template <class Key, class Payload, const uint64_t pageSize, const uint64_t cacheLineSize>
-struct BTreeLeaf : public BTreeLeafBase<pageSize, cacheLineSize>
+template <class Key, class Payload, const uint64_t innerSize, const uint64_t leafSize, const uint64_t cacheLineSize>
+struct BTreeLeaf : public BTreeLeafBase<innerSize, leafSize, cacheLineSize>
 {
     struct Entry
     {
@@ -150,7 +163,7 @@ struct BTreeLeaf : public BTreeLeafBase<pageSize, cacheLineSize>
         Payload p;
     };
 
-    static const uint64_t maxEntries = (pageSize - sizeof(NodeBase<pageSize, cacheLineSize>)) / (sizeof(Key) + sizeof(Payload));
+    static const uint64_t maxEntries = (leafSize - sizeof(NodeBase<innerSize, leafSize, cacheLineSize>)) / (sizeof(Key) + sizeof(Payload));
 
     Key keys[maxEntries];
     Payload payloads[maxEntries];
@@ -226,10 +239,10 @@ struct BTreeLeaf : public BTreeLeafBase<pageSize, cacheLineSize>
         this->count++;
     }
 
-    BTreeLeaf<Key, Payload, pageSize, cacheLineSize> *split(Key &sep, SimpleContinuousAllocator &allocator)
+    BTreeLeaf<Key, Payload, innerSize, leafSize, cacheLineSize> *split(Key &sep, SimpleContinuousAllocator &allocator)
     {
-        void *new_leaf_memory = allocator.allocate(sizeof(BTreeLeaf<Key, Payload, pageSize, cacheLineSize>), alignof(BTreeLeaf<Key, Payload, pageSize, cacheLineSize>));
-        BTreeLeaf<Key, Payload, pageSize, cacheLineSize> *newLeaf = new (new_leaf_memory) BTreeLeaf<Key, Payload, pageSize, cacheLineSize>();
+        void *new_leaf_memory = allocator.allocate(sizeof(BTreeLeaf<Key, Payload, innerSize, leafSize, cacheLineSize>), alignof(BTreeLeaf<Key, Payload, innerSize, leafSize, cacheLineSize>));
+        BTreeLeaf<Key, Payload, innerSize, leafSize, cacheLineSize> *newLeaf = new (new_leaf_memory) BTreeLeaf<Key, Payload, innerSize, leafSize, cacheLineSize>();
         newLeaf->count = this->count - (this->count / 2);
         this->count = this->count - newLeaf->count;
         memcpy(newLeaf->keys, keys + this->count, sizeof(Key) * newLeaf->count);
@@ -239,25 +252,26 @@ struct BTreeLeaf : public BTreeLeafBase<pageSize, cacheLineSize>
     }
 };
 
-template <const uint64_t pageSize, const uint64_t cacheLineSize>
-struct BTreeInnerBase : public NodeBase<pageSize, cacheLineSize>
+template <const uint64_t innerSize, const uint64_t leafSize, const uint64_t cacheLineSize>
+struct BTreeInnerBase : public NodeBase<innerSize, leafSize, cacheLineSize>
 {
     static const PageType typeMarker = PageType::BTreeInner;
 
     virtual ~BTreeInnerBase() = default;
 };
 
-template <class Key, const uint64_t pageSize, const uint64_t cacheLineSize>
-struct BTreeInner : public BTreeInnerBase<pageSize, cacheLineSize>
+template <class Key, const uint64_t innerSize, const uint64_t leafSize, const uint64_t cacheLineSize>
+struct BTreeInner : public BTreeInnerBase<innerSize, leafSize, cacheLineSize>
 {
-    static const uint64_t maxEntries = (pageSize - sizeof(NodeBase<pageSize, cacheLineSize>)) / (sizeof(Key) + sizeof(NodeBase<pageSize, cacheLineSize> *));
-    NodeBase<pageSize, cacheLineSize> *children[maxEntries];
+    static const uint64_t maxEntries = (innerSize - sizeof(NodeBase<innerSize, leafSize, cacheLineSize>)) / (sizeof(Key) + sizeof(NodeBase<innerSize, leafSize, cacheLineSize> *));
+    NodeBase<innerSize, leafSize, cacheLineSize> *children[maxEntries];
     Key keys[maxEntries];
 
     BTreeInner()
     {
         this->count = 0;
         this->type = this->typeMarker;
+        this->childType = PageType::BTreeLeaf;
     }
 
     virtual ~BTreeInner()
@@ -309,24 +323,25 @@ struct BTreeInner : public BTreeInnerBase<pageSize, cacheLineSize>
         return lower;
     }
 
-    BTreeInner<Key, pageSize, cacheLineSize> *split(Key &sep, SimpleContinuousAllocator &allocator)
+    BTreeInner<Key, innerSize, leafSize, cacheLineSize> *split(Key &sep, SimpleContinuousAllocator &allocator)
     {
-        void *new_inner_memory = allocator.allocate(sizeof(BTreeInner<Key, pageSize, cacheLineSize>), alignof(BTreeInner<Key, pageSize, cacheLineSize>));
-        BTreeInner<Key, pageSize, cacheLineSize> *newInner = new (new_inner_memory) BTreeInner<Key, pageSize, cacheLineSize>();
+        void *new_inner_memory = allocator.allocate(sizeof(BTreeInner<Key, innerSize, leafSize, cacheLineSize>), alignof(BTreeInner<Key, innerSize, leafSize, cacheLineSize>));
+        BTreeInner<Key, innerSize, leafSize, cacheLineSize> *newInner = new (new_inner_memory) BTreeInner<Key, innerSize, leafSize, cacheLineSize>();
+        newInner->childType = this->childType;
         newInner->count = this->count - (this->count / 2);
         this->count = this->count - newInner->count - 1;
         sep = keys[this->count];
         memcpy(newInner->keys, keys + this->count + 1, sizeof(Key) * (newInner->count + 1));
-        memcpy(newInner->children, children + this->count + 1, sizeof(NodeBase<pageSize, cacheLineSize> *) * (newInner->count + 1));
+        memcpy(newInner->children, children + this->count + 1, sizeof(NodeBase<innerSize, leafSize, cacheLineSize> *) * (newInner->count + 1));
         return newInner;
     }
 
-    void insert(Key k, NodeBase<pageSize, cacheLineSize> *child)
+    void insert(Key k, NodeBase<innerSize, leafSize, cacheLineSize> *child)
     {
         assert(this->count < maxEntries - 1);
         unsigned pos = lowerBound(k);
         memmove(keys + pos + 1, keys + pos, sizeof(Key) * (this->count - pos + 1));
-        memmove(children + pos + 1, children + pos, sizeof(NodeBase<pageSize, cacheLineSize> *) * (this->count - pos + 1));
+        memmove(children + pos + 1, children + pos, sizeof(NodeBase<innerSize, leafSize, cacheLineSize> *) * (this->count - pos + 1));
         keys[pos] = k;
         children[pos] = child;
         std::swap(children[pos], children[pos + 1]);
@@ -335,27 +350,28 @@ struct BTreeInner : public BTreeInnerBase<pageSize, cacheLineSize>
 
 };
 
-template <class Key, class Value, const uint64_t pageSize, const uint64_t cacheLineSize>
+template <class Key, class Value, const uint64_t innerSize, const uint64_t leafSize, const uint64_t cacheLineSize>
 struct BTree
 {
     using task_type = Task;
 
-    std::atomic<NodeBase<pageSize, cacheLineSize> *> root;
+    std::atomic<NodeBase<innerSize, leafSize, cacheLineSize> *> root;
     SimpleContinuousAllocator &allocator;
 
     BTree(SimpleContinuousAllocator &allocator) : allocator(allocator)
     {
-        void *new_leaf_memory = allocator.allocate(sizeof(BTreeLeaf<Key, Value, pageSize, cacheLineSize>), alignof(BTreeLeaf<Key, Value, pageSize, cacheLineSize>));
-        root = new (new_leaf_memory) BTreeLeaf<Key, Value, pageSize, cacheLineSize>();
+        void *new_leaf_memory = allocator.allocate(sizeof(BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize>), alignof(BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize>));
+        root = new (new_leaf_memory) BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize>();
     }
 
     ~BTree() { root.load()->~NodeBase(); }
 
-    void makeRoot(Key k, NodeBase<pageSize, cacheLineSize> *leftChild, NodeBase<pageSize, cacheLineSize> *rightChild)
+    void makeRoot(Key k, NodeBase<innerSize, leafSize, cacheLineSize> *leftChild, NodeBase<innerSize, leafSize, cacheLineSize> *rightChild)
     {
-        void *new_inner_memory = allocator.allocate(sizeof(BTreeInner<Key, pageSize, cacheLineSize>), alignof(BTreeInner<Key, pageSize, cacheLineSize>));
-        auto inner = new (new_inner_memory) BTreeInner<Key, pageSize, cacheLineSize>();
+        void *new_inner_memory = allocator.allocate(sizeof(BTreeInner<Key, innerSize, leafSize, cacheLineSize>), alignof(BTreeInner<Key, innerSize, leafSize, cacheLineSize>));
+        auto inner = new (new_inner_memory) BTreeInner<Key, innerSize, leafSize, cacheLineSize>();
         inner->count = 1;
+        inner->childType = leftChild->type;
         inner->keys[0] = k;
         inner->children[0] = leftChild;
         inner->children[1] = rightChild;
@@ -367,30 +383,38 @@ struct BTree
         if (count > 3)
             sched_yield();
         else
+        {
+            stats::pause_spin();
             builtin::pause();
+        }
     }
 
     Task insert(Key k, Value v)
     {
         int restartCount = 0;
+        unsigned level = 0;
     restart:
         if (restartCount++)
+        {
+            stats::restart(level);
             yield(restartCount);
+        }
+        level = 0;
         bool needRestart = false;
 
         // Current node
-        NodeBase<pageSize, cacheLineSize> *node = root;
+        NodeBase<innerSize, leafSize, cacheLineSize> *node = root;
         uint64_t versionNode = node->readLockOrRestart(needRestart);
         if (needRestart || (node != root))
             goto restart;
 
         // Parent of current node
-        BTreeInner<Key, pageSize, cacheLineSize> *parent = nullptr;
+        BTreeInner<Key, innerSize, leafSize, cacheLineSize> *parent = nullptr;
         uint64_t versionParent;
 
         while (node->type == PageType::BTreeInner)
         {
-            auto inner = static_cast<BTreeInner<Key, pageSize, cacheLineSize> *>(node);
+            auto inner = static_cast<BTreeInner<Key, innerSize, leafSize, cacheLineSize> *>(node);
 
             // Split eagerly if full
             if (inner->isFull())
@@ -416,7 +440,8 @@ struct BTree
                 }
                 // Split
                 Key sep;
-                BTreeInner<Key, pageSize, cacheLineSize> *newInner = inner->split(sep, allocator);
+                BTreeInner<Key, innerSize, leafSize, cacheLineSize> *newInner = inner->split(sep, allocator);
+                stats::inner_split();
                 if (parent)
                     parent->insert(sep, newInner);
                 else
@@ -439,11 +464,12 @@ struct BTree
             versionParent = versionNode;
 
             node = inner->children[inner->lowerBound(k)];
+            level++;
             inner->checkOrRestart(versionNode, needRestart);
             if (needRestart)
                 goto restart;
 
-            node->prefetch_node();
+            node->prefetch_node(inner->childType);
             co_await std::suspend_always{};
 
             versionNode = node->readLockOrRestart(needRestart);
@@ -451,7 +477,7 @@ struct BTree
                 goto restart;
         }
 
-        auto leaf = static_cast<BTreeLeaf<Key, Value, pageSize, cacheLineSize> *>(node);
+        auto leaf = static_cast<BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize> *>(node);
 
         // Split leaf if full
         if (leaf->count == leaf->maxEntries)
@@ -477,7 +503,8 @@ struct BTree
             }
             // Split
             Key sep;
-            BTreeLeaf<Key, Value, pageSize, cacheLineSize> *newLeaf = leaf->split(sep, allocator);
+            BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize> *newLeaf = leaf->split(sep, allocator);
+            stats::leaf_split();
             if (parent)
                 parent->insert(sep, newLeaf);
             else
@@ -512,28 +539,33 @@ struct BTree
     Task lookup(Key k, Value &result)
     {
         int restartCount = 0;
+        unsigned level = 0;
     restart:
         if (restartCount++)
+        {
+            stats::restart(level);
             yield(restartCount);
+        }
+        level = 0;
         bool needRestart = false;
 
         /**
          * Prefetch the root node => Prefetch complete node
          * Could be also left out
          */
-        NodeBase<pageSize, cacheLineSize> *node = root;
+        NodeBase<innerSize, leafSize, cacheLineSize> *node = root;
 
         uint64_t versionNode = node->readLockOrRestart(needRestart);
         if (needRestart || (node != root))
             goto restart;
 
         // Parent of current node
-        BTreeInner<Key, pageSize, cacheLineSize> *parent = nullptr;
+        BTreeInner<Key, innerSize, leafSize, cacheLineSize> *parent = nullptr;
         uint64_t versionParent;
 
         while (node->type == PageType::BTreeInner)
         {
-            auto inner = static_cast<BTreeInner<Key, pageSize, cacheLineSize> *>(node);
+            auto inner = static_cast<BTreeInner<Key, innerSize, leafSize, cacheLineSize> *>(node);
 
             if (parent)
             {
@@ -548,6 +580,7 @@ struct BTree
             const auto pos = inner->lowerBound(k);
 
             node = inner->children[pos];
+            level++;
 
             inner->checkOrRestart(versionNode, needRestart);
             if (needRestart)
@@ -556,14 +589,14 @@ struct BTree
             /**
              * Accessing the follow up node => Prefetch complete node
              */
-            node->prefetch_node();
+            node->prefetch_node(inner->childType);
             co_await std::suspend_always{};
             versionNode = node->readLockOrRestart(needRestart);
             if (needRestart)
                 goto restart;
         }
 
-        BTreeLeaf<Key, Value, pageSize, cacheLineSize> *leaf = static_cast<BTreeLeaf<Key, Value, pageSize, cacheLineSize> *>(node);
+        BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize> *leaf = static_cast<BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize> *>(node);
 
         unsigned pos = leaf->lowerBound(k);
         if ((pos < leaf->count) && (leaf->keys[pos] == k))
@@ -586,23 +619,28 @@ struct BTree
     uint64_t scan(Key k, int range, Value *output)
     {
         int restartCount = 0;
+        unsigned level = 0;
     restart:
         if (restartCount++)
+        {
+            stats::restart(level);
             yield(restartCount);
+        }
+        level = 0;
         bool needRestart = false;
 
-        NodeBase<pageSize, cacheLineSize> *node = root;
+        NodeBase<innerSize, leafSize, cacheLineSize> *node = root;
         uint64_t versionNode = node->readLockOrRestart(needRestart);
         if (needRestart || (node != root))
             goto restart;
 
         // Parent of current node
-        BTreeInner<Key, pageSize, cacheLineSize> *parent = nullptr;
+        BTreeInner<Key, innerSize, leafSize, cacheLineSize> *parent = nullptr;
         uint64_t versionParent;
 
         while (node->type == PageType::BTreeInner)
         {
-            auto inner = static_cast<BTreeInner<Key, pageSize, cacheLineSize> *>(node);
+            auto inner = static_cast<BTreeInner<Key, innerSize, leafSize, cacheLineSize> *>(node);
 
             if (parent)
             {
@@ -615,6 +653,7 @@ struct BTree
             versionParent = versionNode;
 
             node = inner->children[inner->lowerBound(k)];
+            level++;
             inner->checkOrRestart(versionNode, needRestart);
             if (needRestart)
                 goto restart;
@@ -623,7 +662,7 @@ struct BTree
                 goto restart;
         }
 
-        BTreeLeaf<Key, Value, pageSize, cacheLineSize> *leaf = static_cast<BTreeLeaf<Key, Value, pageSize, cacheLineSize> *>(node);
+        BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize> *leaf = static_cast<BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize> *>(node);
         unsigned pos = leaf->lowerBound(k);
         int count = 0;
         for (unsigned i = pos; i < leaf->count; i++)
@@ -0,0 +1,869 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <sched.h>
+#include <coroutine>
+#include <type_traits>
+#include "prefetch.h"
+#include "builtin.h"
+#include "olc_stats.h"
+
+#include "../utils/simple_continuous_allocator.hpp"
+
+/***
+ * Layout of the BtreeOLC
+ *
+ * ### Inner nodes ###
+ *    What      From       To       Cache Lines
+ *   -------------------------------------------
+ *    Base      0          23       0
+ *    Fences    24         39       0
+ *    Children  40         527      0-8
+ *    Keys      528        1015     8-15
+ *
+ * ### Leaf nodes ###
+ *    What      From       To       Cache Lines
+ *   -------------------------------------------
+ *    Base      0          23       0
+ *    Fences    24         39       0
+ *    Keys      40         527      0-8
+ *    Values    528        1015     8-15
+ *
+ * Every node keeps its smallest and largest key (fences) within the header cache line. Once the header is
+ * loaded, lookups interpolate the position of the search key between the fences and prefetch only the cache
+ * lines around the predicted key instead of the whole key array. On a misprediction the search falls back to a
+ * binary search over the remaining range.
+ */
+
+namespace btreeolc::coro_interpolation {
+
+class Task
+{
+public:
+    // The coroutine level type
+    struct promise_type
+    {
+        using Handle = std::coroutine_handle<promise_type>;
+        Task get_return_object() { return Task{Handle::from_promise(*this)}; }
+        std::suspend_always initial_suspend() { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() {}
+
+    };
+
+    explicit Task(promise_type::Handle coroutine) : _coroutine(coroutine) {}
+    void destroy() { _coroutine.destroy(); }
+    void resume() { _coroutine.resume(); }
+
+    [[nodiscard]] bool is_done() const { return _coroutine.done(); }
+
+private:
+    promise_type::Handle _coroutine;
+};
+
+enum class PageType : uint8_t
+{
+    BTreeInner = 1,
+    BTreeLeaf = 2
+};
+
+struct OptLock
+{
+    std::atomic<uint64_t> typeVersionLockObsolete{0b100};
+
+    bool isLocked(uint64_t version) { return ((version & 0b10) == 0b10); }
+
+    uint64_t readLockOrRestart(bool &needRestart)
+    {
+        uint64_t version;
+        version = typeVersionLockObsolete.load();
+        if (isLocked(version) || isObsolete(version))
+        {
+            stats::pause_spin();
+            builtin::pause();
+            needRestart = true;
+        }
+        return version;
+    }
+
+    void writeLockOrRestart(bool &needRestart)
+    {
+        uint64_t version;
+        version = readLockOrRestart(needRestart);
+        if (needRestart)
+            return;
+
+        upgradeToWriteLockOrRestart(version, needRestart);
+        if (needRestart)
+            return;
+    }
+
+    void upgradeToWriteLockOrRestart(uint64_t &version, bool &needRestart)
+    {
+        if (typeVersionLockObsolete.compare_exchange_strong(version, version + 0b10))
+        {
+            version = version + 0b10;
+        }
+        else
+        {
+            stats::upgrade_failure();
+            builtin::pause();
+            needRestart = true;
+        }
+    }
+
+    void writeUnlock() { typeVersionLockObsolete.fetch_add(0b10); }
+
+    bool isObsolete(uint64_t version) { return (version & 1) == 1; }
+
+    void checkOrRestart(uint64_t startRead, bool &needRestart) const { readUnlockOrRestart(startRead, needRestart); }
+
+    void readUnlockOrRestart(uint64_t startRead, bool &needRestart) const
+    {
+        needRestart = (startRead != typeVersionLockObsolete.load());
+    }
+
+    void writeUnlockObsolete() { typeVersionLockObsolete.fetch_add(0b11); }
+};
+
+template <const uint64_t innerSize, const uint64_t leafSize, const uint64_t cacheLineSize>
+struct NodeBase : public OptLock
+{
+    PageType type;
+    uint16_t count;
+
+    void prefetch_header()
+    {
+        SWPrefetcher::prefetch<0U, 1U, SWPrefetcher::Target::ALL>(this);
+    }
+
+    void prefetch_full()
+    {
+        if (type == PageType::BTreeInner)
+        {
+            SWPrefetcher::prefetch<0U, innerSize / cacheLineSize, SWPrefetcher::Target::ALL>(this);
+        }
+        else
+        {
+            SWPrefetcher::prefetch<0U, leafSize / cacheLineSize, SWPrefetcher::Target::ALL>(this);
+        }
+    }
+
+    virtual ~NodeBase() = default;
+};
+
+/**
+ * Predicts the lowerBound position of k among count keys in [low, high], assuming evenly distributed keys.
+ */
+template <class Key>
+unsigned interpolate(Key k, Key low, Key high, unsigned count)
+{
+    static_assert(std::is_arithmetic_v<Key>, "Interpolation search requires arithmetic keys.");
+    if (count == 0 || !(low < k))
+    {
+        return 0;
+    }
+    if (high < k)
+    {
+        return count;
+    }
+    if (!(low < high))
+    {
+        // Equal (or, in an inconsistent optimistic read, crossed) fences leave nothing to interpolate.
+        return 0;
+    }
+    // Clamped in double before the cast, keys read during a concurrent write may give NaN or any other fraction.
+    const double fraction = (static_cast<double>(k) - static_cast<double>(low)) / (static_cast<double>(high) - static_cast<double>(low));
+    if (!(fraction > 0.0))
+    {
+        return 0;
+    }
+    if (fraction >= 1.0)
+    {
+        return count - 1;
+    }
+    return static_cast<unsigned>(fraction * (count - 1));
+}
+
+/**
+ * lowerBound on keys[0..count) that first probes the (prefetched) neighbourhood of the predicted position and
+ * only binary searches the remaining range if the prediction was off.
+ */
+template <class Key>
+unsigned lowerBoundAround(const Key *keys, unsigned count, Key k, unsigned predicted)
+{
+    unsigned lower = 0;
+    unsigned upper = count;
+    const unsigned first = (predicted > 0) ? predicted - 1 : 0;
+    for (unsigned probe = first; probe <= predicted + 1 && lower < upper; probe++)
+    {
+        if (probe < lower || probe >= upper)
+        {
+            continue;
+        }
+        if (keys[probe] < k)
+        {
+            lower = probe + 1;
+        }
+        else
+        {
+            upper = probe;
+        }
+    }
+    while (lower < upper)
+    {
+        unsigned mid = ((upper - lower) / 2) + lower;
+        if (keys[mid] < k)
+        {
+            lower = mid + 1;
+        }
+        else
+        {
+            upper = mid;
+        }
+    }
+    return lower;
+}
+
+template <const uint64_t innerSize, const uint64_t leafSize, const uint64_t cacheLineSize>
+struct BTreeLeafBase : public NodeBase<innerSize, leafSize, cacheLineSize>
+{
+    static const PageType typeMarker = PageType::BTreeLeaf;
+
+    virtual ~BTreeLeafBase() = default;
+};
+
+template <class Key, class Payload, const uint64_t innerSize, const uint64_t leafSize, const uint64_t cacheLineSize>
+struct BTreeLeaf : public BTreeLeafBase<innerSize, leafSize, cacheLineSize>
+{
+    struct Entry
+    {
+        Key k;
+        Payload p;
+    };
+
+    static const uint64_t maxEntries = (leafSize - sizeof(NodeBase<innerSize, leafSize, cacheLineSize>) - 2 * sizeof(Key)) / (sizeof(Key) + sizeof(Payload));
+
+    Key lowKey;
+    Key highKey;
+    Key keys[maxEntries];
+    Payload payloads[maxEntries];
+
+    BTreeLeaf()
+    {
+        this->count = 0;
+        this->type = this->typeMarker;
+    }
+
+    virtual ~BTreeLeaf() = default;
+
+    bool isFull() { return this->count == maxEntries; };
+
+    unsigned lowerBound(Key k)
+    {
+        unsigned lower = 0;
+        unsigned upper = this->count;
+        do
+        {
+            unsigned mid = ((upper - lower) / 2) + lower;
+            if (k < keys[mid])
+            {
+                upper = mid;
+            }
+            else if (k > keys[mid])
+            {
+                lower = mid + 1;
+            }
+            else
+            {
+                return mid;
+            }
+        } while (lower < upper);
+        return lower;
+    }
+
+    unsigned lowerBoundBF(Key k)
+    {
+        auto base = keys;
+        unsigned n = this->count;
+        while (n > 1)
+        {
+            const unsigned half = n / 2;
+            base = (base[half] < k) ? (base + half) : base;
+            n -= half;
+        }
+        return (*base < k) + base - keys;
+    }
+
+    void insert(Key k, Payload p)
+    {
+        assert(this->count < maxEntries);
+        if (this->count)
+        {
+            unsigned pos = lowerBound(k);
+            if ((pos < this->count) && (keys[pos] == k))
+            {
+                // Upsert
+                payloads[pos] = p;
+                return;
+            }
+            memmove(keys + pos + 1, keys + pos, sizeof(Key) * (this->count - pos));
+            memmove(payloads + pos + 1, payloads + pos, sizeof(Payload) * (this->count - pos));
+            keys[pos] = k;
+            payloads[pos] = p;
+        }
+        else
+        {
+            keys[0] = k;
+            payloads[0] = p;
+        }
+        this->count++;
+        updateFences();
+    }
+
+    void updateFences()
+    {
+        if (this->count)
+        {
+            lowKey = keys[0];
+            highKey = keys[this->count - 1];
+        }
+    }
+
+    unsigned predictPosition(Key k) { return interpolate(k, lowKey, highKey, this->count); }
+
+    unsigned lowerBoundInterpolated(Key k, unsigned predicted) { return lowerBoundAround(keys, this->count, k, predicted); }
+
+    BTreeLeaf<Key, Payload, innerSize, leafSize, cacheLineSize> *split(Key &sep, SimpleContinuousAllocator &allocator)
+    {
+        void *new_leaf_memory = allocator.allocate(sizeof(BTreeLeaf<Key, Payload, innerSize, leafSize, cacheLineSize>), alignof(BTreeLeaf<Key, Payload, innerSize, leafSize, cacheLineSize>));
+
+        BTreeLeaf<Key, Payload, innerSize, leafSize, cacheLineSize> *newLeaf = new (new_leaf_memory) BTreeLeaf<Key, Payload, innerSize, leafSize, cacheLineSize>();
+        newLeaf->count = this->count - (this->count / 2);
+        this->count = this->count - newLeaf->count;
+        memcpy(newLeaf->keys, keys + this->count, sizeof(Key) * newLeaf->count);
+        memcpy(newLeaf->payloads, payloads + this->count, sizeof(Payload) * newLeaf->count);
+        sep = keys[this->count - 1];
+        updateFences();
+        newLeaf->updateFences();
+        return newLeaf;
+    }
+
+    void prefetch_keys()
+    {
+        SWPrefetcher::prefetch<0U, (leafSize / cacheLineSize) / 2, SWPrefetcher::Target::ALL>(this);
+    }
+
+    void prefetch_values()
+    {
+        SWPrefetcher::prefetch<(leafSize / cacheLineSize) / 2, (leafSize / cacheLineSize) / 2, SWPrefetcher::Target::ALL>(this);
+    }
+
+    void prefetch_value(const std::uint32_t pos)
+    {
+        SWPrefetcher::prefetch<0U, 1U, SWPrefetcher::Target::ALL>(&this->payloads[pos]);
+    }
+
+    /**
+     * Prefetches the cache lines holding the keys around the predicted position and the predicted payload.
+     */
+    void prefetch_predicted(const unsigned predicted)
+    {
+        if (this->count == 0)
+        {
+            return;
+        }
+        const unsigned last = this->count - 1;
+        SWPrefetcher::prefetch<0U, 1U, SWPrefetcher::Target::ALL>(&this->keys[std::min((predicted > 0) ? predicted - 1 : 0, last)]);
+        SWPrefetcher::prefetch<0U, 1U, SWPrefetcher::Target::ALL>(&this->keys[std::min(predicted + 1, last)]);
+        SWPrefetcher::prefetch<0U, 1U, SWPrefetcher::Target::ALL>(&this->payloads[std::min(predicted, last)]);
+    }
+};
+
+template <const uint64_t innerSize, const uint64_t leafSize, const uint64_t cacheLineSize>
+struct BTreeInnerBase : public NodeBase<innerSize, leafSize, cacheLineSize>
+{
+    static const PageType typeMarker = PageType::BTreeInner;
+
+    virtual ~BTreeInnerBase() = default;
+};
+
+template <class Key, const uint64_t innerSize, const uint64_t leafSize, const uint64_t cacheLineSize>
+struct BTreeInner : public BTreeInnerBase<innerSize, leafSize, cacheLineSize>
+{
+    static const uint64_t maxEntries = (innerSize - sizeof(NodeBase<innerSize, leafSize, cacheLineSize>) - 2 * sizeof(Key)) / (sizeof(Key) + sizeof(NodeBase<innerSize, leafSize, cacheLineSize> *));
+    Key lowKey;
+    Key highKey;
+    NodeBase<innerSize, leafSize, cacheLineSize> *children[maxEntries];
+    Key keys[maxEntries];
+
+    BTreeInner()
+    {
+        this->count = 0;
+        this->type = this->typeMarker;
+    }
+
+    virtual ~BTreeInner()
+    {
+        for (auto i = 0u; i <= this->count; i++)
+        {
+            if (children[i] != nullptr)
+            {
+                children[i]->~NodeBase();
+            }
+        }
+    }
+
+    bool isFull() { return this->count == (maxEntries - 1); };
+
+    unsigned lowerBoundBF(Key k)
+    {
+        auto base = keys;
+        unsigned n = this->count;
+        while (n > 1)
+        {
+            const unsigned half = n / 2;
+            base = (base[half] < k) ? (base + half) : base;
+            n -= half;
+        }
+        return (*base < k) + base - keys;
+    }
+
+    unsigned lowerBound(Key k)
+    {
+        unsigned lower = 0;
+        unsigned upper = this->count;
+        do
+        {
+            unsigned mid = ((upper - lower) / 2) + lower;
+            if (k < keys[mid])
+            {
+                upper = mid;
+            }
+            else if (k > keys[mid])
+            {
+                lower = mid + 1;
+            }
+            else
+            {
+                return mid;
+            }
+        } while (lower < upper);
+        return lower;
+    }
+
+    BTreeInner<Key, innerSize, leafSize, cacheLineSize> *split(Key &sep, SimpleContinuousAllocator &allocator)
+    {
+        void *new_inner_memory = allocator.allocate(sizeof(BTreeInner<Key, innerSize, leafSize, cacheLineSize>), alignof(BTreeInner<Key, innerSize, leafSize, cacheLineSize>));
+        BTreeInner<Key, innerSize, leafSize, cacheLineSize> *newInner = new (new_inner_memory) BTreeInner<Key, innerSize, leafSize, cacheLineSize>();
+        newInner->count = this->count - (this->count / 2);
+        this->count = this->count - newInner->count - 1;
+        sep = keys[this->count];
+        memcpy(newInner->keys, keys + this->count + 1, sizeof(Key) * (newInner->count + 1));
+        memcpy(newInner->children, children + this->count + 1, sizeof(NodeBase<innerSize, leafSize, cacheLineSize> *) * (newInner->count + 1));
+        updateFences();
+        newInner->updateFences();
+        return newInner;
+    }
+
+    void insert(Key k, NodeBase<innerSize, leafSize, cacheLineSize> *child)
+    {
+        assert(this->count < maxEntries - 1);
+        unsigned pos = lowerBound(k);
+        memmove(keys + pos + 1, keys + pos, sizeof(Key) * (this->count - pos + 1));
+        memmove(children + pos + 1, children + pos, sizeof(NodeBase<innerSize, leafSize, cacheLineSize> *) * (this->count - pos + 1));
+        keys[pos] = k;
+        children[pos] = child;
+        std::swap(children[pos], children[pos + 1]);
+        this->count++;
+        updateFences();
+    }
+
+    void updateFences()
+    {
+        if (this->count)
+        {
+            lowKey = keys[0];
+            highKey = keys[this->count - 1];
+        }
+    }
+
+    unsigned predictPosition(Key k) { return interpolate(k, lowKey, highKey, this->count); }
+
+    unsigned lowerBoundInterpolated(Key k, unsigned predicted) { return lowerBoundAround(keys, this->count, k, predicted); }
+
+    void prefetch_children()
+    {
+        SWPrefetcher::prefetch<0U, (innerSize / cacheLineSize) / 2, SWPrefetcher::Target::ALL>(this);
+    }
+
+    void prefetch_keys()
+    {
+        SWPrefetcher::prefetch<(innerSize / cacheLineSize) / 2, (innerSize / cacheLineSize) / 2, SWPrefetcher::Target::ALL>(this);
+    }
+
+    /**
+     * Prefetches the cache lines holding the keys around the predicted position and the predicted child pointer.
+     */
+    void prefetch_predicted(const unsigned predicted)
+    {
+        if (this->count == 0)
+        {
+            return;
+        }
+        const unsigned last = this->count - 1;
+        SWPrefetcher::prefetch<0U, 1U, SWPrefetcher::Target::ALL>(&this->keys[std::min((predicted > 0) ? predicted - 1 : 0, last)]);
+        SWPrefetcher::prefetch<0U, 1U, SWPrefetcher::Target::ALL>(&this->keys[std::min(predicted + 1, last)]);
+        SWPrefetcher::prefetch<0U, 1U, SWPrefetcher::Target::ALL>(&this->children[std::min(predicted, static_cast<unsigned>(this->count))]);
+    }
+};
+
+template <class Key, class Value, const uint64_t innerSize, const uint64_t leafSize, const uint64_t cacheLineSize>
+struct BTree
+{
+    using task_type = Task;
+
+    std::atomic<NodeBase<innerSize, leafSize, cacheLineSize> *> root;
+    SimpleContinuousAllocator &allocator;
+
+    BTree(SimpleContinuousAllocator &allocator) : allocator(allocator)
+    {
+        void *new_leaf_memory = allocator.allocate(sizeof(BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize>), alignof(BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize>));
+
+        root = new (new_leaf_memory) BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize>();
+    }
+
+    ~BTree() { root.load()->~NodeBase(); }
+
+    void makeRoot(Key k, NodeBase<innerSize, leafSize, cacheLineSize> *leftChild, NodeBase<innerSize, leafSize, cacheLineSize> *rightChild)
+    {
+        void *new_inner_memory = allocator.allocate(sizeof(BTreeInner<Key, innerSize, leafSize, cacheLineSize>), alignof(BTreeInner<Key, innerSize, leafSize, cacheLineSize>));
+
+        auto inner = new (new_inner_memory) BTreeInner<Key, innerSize, leafSize, cacheLineSize>();
+        inner->count = 1;
+        inner->keys[0] = k;
+        inner->children[0] = leftChild;
+        inner->children[1] = rightChild;
+        inner->updateFences();
+        root = inner;
+    }
+
+    void yield(int count)
+    {
+        if (count > 3)
+            sched_yield();
+        else
+        {
+            stats::pause_spin();
+            builtin::pause();
+        }
+    }
+
+    Task insert(Key k, Value v)
+    {
+        int restartCount = 0;
+        unsigned level = 0;
+    restart:
+        if (restartCount++)
+        {
+            stats::restart(level);
+            yield(restartCount);
+        }
+        level = 0;
+        bool needRestart = false;
+
+        // Current node
+        NodeBase<innerSize, leafSize, cacheLineSize> *node = root;
+        uint64_t versionNode = node->readLockOrRestart(needRestart);
+        if (needRestart || (node != root))
+            goto restart;
+
+        // Parent of current node
+        BTreeInner<Key, innerSize, leafSize, cacheLineSize> *parent = nullptr;
+        uint64_t versionParent;
+
+        while (node->type == PageType::BTreeInner)
+        {
+            auto inner = static_cast<BTreeInner<Key, innerSize, leafSize, cacheLineSize> *>(node);
+
+            // Split eagerly if full
+            if (inner->isFull())
+            {
+                // Lock
+                if (parent)
+                {
+                    parent->upgradeToWriteLockOrRestart(versionParent, needRestart);
+                    if (needRestart)
+                        goto restart;
+                }
+                node->upgradeToWriteLockOrRestart(versionNode, needRestart);
+                if (needRestart)
+                {
+                    if (parent)
+                        parent->writeUnlock();
+                    goto restart;
+                }
+                if (!parent && (node != root))
+                { // there's a new parent
+                    node->writeUnlock();
+                    goto restart;
+                }
+                // Split
+                Key sep;
+                BTreeInner<Key, innerSize, leafSize, cacheLineSize> *newInner = inner->split(sep, allocator);
+                stats::inner_split();
+                if (parent)
+                    parent->insert(sep, newInner);
+                else
+                    makeRoot(sep, inner, newInner);
+                // Unlock and restart
+                node->writeUnlock();
+                if (parent)
+                    parent->writeUnlock();
+                goto restart;
+            }
+
+            if (parent)
+            {
+                parent->readUnlockOrRestart(versionParent, needRestart);
+                if (needRestart)
+                    goto restart;
+            }
+
+            parent = inner;
+            versionParent = versionNode;
+
+            node = inner->children[inner->lowerBound(k)];
+            level++;
+            inner->checkOrRestart(versionNode, needRestart);
+            if (needRestart)
+                goto restart;
+            versionNode = node->readLockOrRestart(needRestart);
+            if (needRestart)
+                goto restart;
+        }
+
+        auto leaf = static_cast<BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize> *>(node);
+
+        // Split leaf if full
+        if (leaf->count == leaf->maxEntries)
+        {
+            // Lock
+            if (parent)
+            {
+                parent->upgradeToWriteLockOrRestart(versionParent, needRestart);
+                if (needRestart)
+                    goto restart;
+            }
+            node->upgradeToWriteLockOrRestart(versionNode, needRestart);
+            if (needRestart)
+            {
+                if (parent)
+                    parent->writeUnlock();
+                goto restart;
+            }
+            if (!parent && (node != root))
+            { // there's a new parent
+                node->writeUnlock();
+                goto restart;
+            }
+            // Split
+            Key sep;
+            BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize> *newLeaf = leaf->split(sep, allocator);
+            stats::leaf_split();
+            if (parent)
+                parent->insert(sep, newLeaf);
+            else
+                makeRoot(sep, leaf, newLeaf);
+            // Unlock and restart
+            node->writeUnlock();
+            if (parent)
+                parent->writeUnlock();
+            goto restart;
+        }
+        else
+        {
+            // only lock leaf node
+            node->upgradeToWriteLockOrRestart(versionNode, needRestart);
+            if (needRestart)
+                goto restart;
+            if (parent)
+            {
+                parent->readUnlockOrRestart(versionParent, needRestart);
+                if (needRestart)
+                {
+                    node->writeUnlock();
+                    goto restart;
+                }
+            }
+            leaf->insert(k, v);
+            node->writeUnlock();
+            co_return; // success
+        }
+    }
+
+    Task lookup(Key k, Value &result)
+    {
+        int restartCount = 0;
+        unsigned level = 0;
+    restart:
+        if (restartCount++)
+        {
+            stats::restart(level);
+            yield(restartCount);
+        }
+        level = 0;
+        bool needRestart = false;
+
+        NodeBase<innerSize, leafSize, cacheLineSize> *node = root;
+        uint64_t versionNode = node->readLockOrRestart(needRestart);
+        if (needRestart || (node != root))
+            goto restart;
+
+        // Parent of current node
+        BTreeInner<Key, innerSize, leafSize, cacheLineSize> *parent = nullptr;
+        uint64_t versionParent;
+
+        while (node->type == PageType::BTreeInner)
+        {
+            auto inner = static_cast<BTreeInner<Key, innerSize, leafSize, cacheLineSize> *>(node);
+
+            if (parent)
+            {
+                parent->readUnlockOrRestart(versionParent, needRestart);
+                if (needRestart)
+                    goto restart;
+            }
+
+            parent = inner;
+            versionParent = versionNode;
+
+            /**
+             * The header (including the fences) is loaded => Prefetch only the lines around the predicted key
+             * and the predicted child pointer.
+             */
+            const auto predicted = inner->predictPosition(k);
+            inner->prefetch_predicted(predicted);
+            co_await std::suspend_always{};
+            const auto pos = inner->lowerBoundInterpolated(k, predicted);
+
+            node = inner->children[pos];
+            level++;
+
+            inner->checkOrRestart(versionNode, needRestart);
+            if (needRestart)
+                goto restart;
+
+            /**
+             * Accessing the header of a node => Prefetch only header
+             */
+            node->prefetch_header();
+            co_await std::suspend_always{};
+            versionNode = node->readLockOrRestart(needRestart);
+            if (needRestart)
+                goto restart;
+        }
+
+        BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize> *leaf = static_cast<BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize> *>(node);
+
+        /**
+         * Accessing the keys of a leaf node => Prefetch the lines around the predicted key and its payload.
+         * A misprediction is resolved without further suspension.
+         */
+        const auto predicted = leaf->predictPosition(k);
+        leaf->prefetch_predicted(predicted);
+        co_await std::suspend_always{};
+        unsigned pos = leaf->lowerBoundInterpolated(k, predicted);
+        if ((pos < leaf->count) && (leaf->keys[pos] == k))
+        {
+            result = leaf->payloads[pos];
+        }
+        if (parent)
+        {
+            parent->readUnlockOrRestart(versionParent, needRestart);
+            if (needRestart)
+                goto restart;
+        }
+        node->readUnlockOrRestart(versionNode, needRestart);
+        if (needRestart)
+            goto restart;
+
+        co_return;
+    }
+
+    uint64_t scan(Key k, int range, Value *output)
+    {
+        int restartCount = 0;
+        unsigned level = 0;
+    restart:
+        if (restartCount++)
+        {
+            stats::restart(level);
+            yield(restartCount);
+        }
+        level = 0;
+        bool needRestart = false;
+
+        NodeBase<innerSize, leafSize, cacheLineSize> *node = root;
+        uint64_t versionNode = node->readLockOrRestart(needRestart);
+        if (needRestart || (node != root))
+            goto restart;
+
+        // Parent of current node
+        BTreeInner<Key, innerSize, leafSize, cacheLineSize> *parent = nullptr;
+        uint64_t versionParent;
+
+        while (node->type == PageType::BTreeInner)
+        {
+            auto inner = static_cast<BTreeInner<Key, innerSize, leafSize, cacheLineSize> *>(node);
+
+            if (parent)
+            {
+                parent->readUnlockOrRestart(versionParent, needRestart);
+                if (needRestart)
+                    goto restart;
+            }
+
+            parent = inner;
+            versionParent = versionNode;
+
+            node = inner->children[inner->lowerBound(k)];
+            level++;
+            inner->checkOrRestart(versionNode, needRestart);
+            if (needRestart)
+                goto restart;
+            versionNode = node->readLockOrRestart(needRestart);
+            if (needRestart)
+                goto restart;
+        }
+
+        BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize> *leaf = static_cast<BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize> *>(node);
+        unsigned pos = leaf->lowerBound(k);
+        int count = 0;
+        for (unsigned i = pos; i < leaf->count; i++)
+        {
+            if (count == range)
+                break;
+            output[count++] = leaf->payloads[i];
+        }
+
+        if (parent)
+        {
+            parent->readUnlockOrRestart(versionParent, needRestart);
+            if (needRestart)
+                goto restart;
+        }
+        node->readUnlockOrRestart(versionNode, needRestart);
+        if (needRestart)
+            goto restart;
+
+        return count;
+    }
+};
+
+} // namespace btreeolc
@@ -8,6 +8,7 @@
 #include <coroutine>
 #include "prefetch.h"
 #include "builtin.h"
+#include "olc_stats.h"
 
 #include "../utils/simple_continuous_allocator.hpp"
 
@@ -131,6 +132,7 @@ namespace btreeolc::coro_lines
             version = typeVersionLockObsolete.load();
             if (isLocked(version) || isObsolete(version))
             {
+                stats::pause_spin();
                 builtin::pause();
                 needRestart = true;
             }
@@ -157,6 +159,7 @@ namespace btreeolc::coro_lines
             }
             else
             {
+                stats::upgrade_failure();
                 builtin::pause();
                 needRestart = true;
             }
@@ -176,7 +179,7 @@ namespace btreeolc::coro_lines
         void writeUnlockObsolete() { typeVersionLockObsolete.fetch_add(0b11); }
     };
 
-    template <const uint64_t pageSize, const uint64_t cacheLineSize>
+    template <const uint64_t innerSize, const uint64_t leafSize, const uint64_t cacheLineSize>
     struct NodeBase : public OptLock
     {
         PageType type;
@@ -194,22 +197,29 @@ namespace btreeolc::coro_lines
 
         void prefetch_full()
         {
-            SWPrefetcher::prefetch<0U, pageSize / cacheLineSize, SWPrefetcher::Target::ALL>(this);
+            if (type == PageType::BTreeInner)
+            {
+                SWPrefetcher::prefetch<0U, innerSize / cacheLineSize, SWPrefetcher::Target::ALL>(this);
+            }
+            else
+            {
+                SWPrefetcher::prefetch<0U, leafSize / cacheLineSize, SWPrefetcher::Target::ALL>(this);
+            }
         }
 
         virtual ~NodeBase() = default;
     };
 
-    template <const uint64_t pageSize, const uint64_t cacheLineSize>
-    struct BTreeLeafBase : public NodeBase<pageSize, cacheLineSize>
+    template <const uint64_t innerSize, const uint64_t leafSize, const uint64_t cacheLineSize>
+    struct BTreeLeafBase : public NodeBase<innerSize, leafSize, cacheLineSize>
     {
         static const PageType typeMarker = PageType::BTreeLeaf;
 
         virtual ~BTreeLeafBase() = default;
     };
 
-    template <class Key, class Payload, const uint64_t pageSize, const uint64_t cacheLineSize>
-    struct BTreeLeaf : public BTreeLeafBase<pageSize, cacheLineSize>
+    template <class Key, class Payload, const uint64_t innerSize, const uint64_t leafSize, const uint64_t cacheLineSize>
+    struct BTreeLeaf : public BTreeLeafBase<innerSize, leafSize, cacheLineSize>
     {
         struct Entry
         {
@@ -217,7 +227,7 @@ namespace btreeolc::coro_lines
             Payload p;
         };
 
-        static const uint64_t maxEntries = (pageSize - sizeof(NodeBase<pageSize, cacheLineSize>)) / (sizeof(Key) + sizeof(Payload));
+        static const uint64_t maxEntries = (leafSize - sizeof(NodeBase<innerSize, leafSize, cacheLineSize>)) / (sizeof(Key) + sizeof(Payload));
 
         Key keys[maxEntries];
         Payload payloads[maxEntries];
@@ -318,11 +328,11 @@ namespace btreeolc::coro_lines
             this->count++;
         }
 
-        BTreeLeaf<Key, Payload, pageSize, cacheLineSize> *split(Key &sep, SimpleContinuousAllocator &allocator)
+        BTreeLeaf<Key, Payload, innerSize, leafSize, cacheLineSize> *split(Key &sep, SimpleContinuousAllocator &allocator)
         {
-            void *new_leaf_memory = allocator.allocate(sizeof(BTreeLeaf<Key, Payload, pageSize, cacheLineSize>), alignof(BTreeLeaf<Key, Payload, pageSize, cacheLineSize>));
+            void *new_leaf_memory = allocator.allocate(sizeof(BTreeLeaf<Key, Payload, innerSize, leafSize, cacheLineSize>), alignof(BTreeLeaf<Key, Payload, innerSize, leafSize, cacheLineSize>));
 
-            BTreeLeaf<Key, Payload, pageSize, cacheLineSize> *newLeaf = new (new_leaf_memory) BTreeLeaf<Key, Payload, pageSize, cacheLineSize>();
+            BTreeLeaf<Key, Payload, innerSize, leafSize, cacheLineSize> *newLeaf = new (new_leaf_memory) BTreeLeaf<Key, Payload, innerSize, leafSize, cacheLineSize>();
             newLeaf->count = this->count - (this->count / 2);
             this->count = this->count - newLeaf->count;
             memcpy(newLeaf->keys, keys + this->count, sizeof(Key) * newLeaf->count);
@@ -333,12 +343,12 @@ namespace btreeolc::coro_lines
 
         void prefetch_keys()
         {
-            SWPrefetcher::prefetch<0U, (pageSize / cacheLineSize) / 2, SWPrefetcher::Target::ALL>(this);
+            SWPrefetcher::prefetch<0U, (leafSize / cacheLineSize) / 2, SWPrefetcher::Target::ALL>(this);
         }
 
         void prefetch_values()
         {
-            SWPrefetcher::prefetch<(pageSize / cacheLineSize) / 2, (pageSize / cacheLineSize) / 2, SWPrefetcher::Target::ALL>(this);
+            SWPrefetcher::prefetch<(leafSize / cacheLineSize) / 2, (leafSize / cacheLineSize) / 2, SWPrefetcher::Target::ALL>(this);
         }
 
         void prefetch_value(const std::uint32_t pos)
@@ -347,19 +357,19 @@ namespace btreeolc::coro_lines
         }
     };
 
-    template <const uint64_t pageSize, const uint64_t cacheLineSize>
-    struct BTreeInnerBase : public NodeBase<pageSize, cacheLineSize>
+    template <const uint64_t innerSize, const uint64_t leafSize, const uint64_t cacheLineSize>
+    struct BTreeInnerBase : public NodeBase<innerSize, leafSize, cacheLineSize>
     {
         static const PageType typeMarker = PageType::BTreeInner;
 
         virtual ~BTreeInnerBase() = default;
     };
 
-    template <class Key, const uint64_t pageSize, const uint64_t cacheLineSize>
-    struct BTreeInner : public BTreeInnerBase<pageSize, cacheLineSize>
+    template <class Key, const uint64_t innerSize, const uint64_t leafSize, const uint64_t cacheLineSize>
+    struct BTreeInner : public BTreeInnerBase<innerSize, leafSize, cacheLineSize>
     {
-        static const uint64_t maxEntries = (pageSize - sizeof(NodeBase<pageSize, cacheLineSize>)) / (sizeof(Key) + sizeof(NodeBase<pageSize, cacheLineSize> *));
-        NodeBase<pageSize, cacheLineSize> *children[maxEntries];
+        static const uint64_t maxEntries = (innerSize - sizeof(NodeBase<innerSize, leafSize, cacheLineSize>)) / (sizeof(Key) + sizeof(NodeBase<innerSize, leafSize, cacheLineSize> *));
+        NodeBase<innerSize, leafSize, cacheLineSize> *children[maxEntries];
         Key keys[maxEntries];
 
         BTreeInner()
@@ -444,25 +454,25 @@ namespace btreeolc::coro_lines
             return lower;
         }
 
-        BTreeInner<Key, pageSize, cacheLineSize> *split(Key &sep, SimpleContinuousAllocator &allocator)
+        BTreeInner<Key, innerSize, leafSize, cacheLineSize> *split(Key &sep, SimpleContinuousAllocator &allocator)
         {
-            void *new_inner_memory = allocator.allocate(sizeof(BTreeInner<Key, pageSize, cacheLineSize>), alignof(BTreeInner<Key, pageSize, cacheLineSize>));
+            void *new_inner_memory = allocator.allocate(sizeof(BTreeInner<Key, innerSize, leafSize, cacheLineSize>), alignof(BTreeInner<Key, innerSize, leafSize, cacheLineSize>));
 
-            BTreeInner<Key, pageSize, cacheLineSize> *newInner = new (new_inner_memory) BTreeInner<Key, pageSize, cacheLineSize>();
+            BTreeInner<Key, innerSize, leafSize, cacheLineSize> *newInner = new (new_inner_memory) BTreeInner<Key, innerSize, leafSize, cacheLineSize>();
             newInner->count = this->count - (this->count / 2);
             this->count = this->count - newInner->count - 1;
             sep = keys[this->count];
             memcpy(newInner->keys, keys + this->count + 1, sizeof(Key) * (newInner->count + 1));
-            memcpy(newInner->children, children + this->count + 1, sizeof(NodeBase<pageSize, cacheLineSize> *) * (newInner->count + 1));
+            memcpy(newInner->children, children + this->count + 1, sizeof(NodeBase<innerSize, leafSize, cacheLineSize> *) * (newInner->count + 1));
             return newInner;
         }
 
-        void insert(Key k, NodeBase<pageSize, cacheLineSize> *child)
+        void insert(Key k, NodeBase<innerSize, leafSize, cacheLineSize> *child)
         {
             assert(this->count < maxEntries - 1);
             unsigned pos = lowerBound(k);
             memmove(keys + pos + 1, keys + pos, sizeof(Key) * (this->count - pos + 1));
-            memmove(children + pos + 1, children + pos, sizeof(NodeBase<pageSize, cacheLineSize> *) * (this->count - pos + 1));
+            memmove(children + pos + 1, children + pos, sizeof(NodeBase<innerSize, leafSize, cacheLineSize> *) * (this->count - pos + 1));
             keys[pos] = k;
             children[pos] = child;
             std::swap(children[pos], children[pos + 1]);
@@ -471,37 +481,37 @@ namespace btreeolc::coro_lines
 
         void prefetch_children()
         {
-            SWPrefetcher::prefetch<0U, (pageSize / cacheLineSize) / 2, SWPrefetcher::Target::ALL>(this);
+            SWPrefetcher::prefetch<0U, (innerSize / cacheLineSize) / 2, SWPrefetcher::Target::ALL>(this);
         }
 
         void prefetch_keys()
         {
-            SWPrefetcher::prefetch<(pageSize / cacheLineSize) / 2, (pageSize / cacheLineSize) / 2, SWPrefetcher::Target::ALL>(this);
+            SWPrefetcher::prefetch<(innerSize / cacheLineSize) / 2, (innerSize / cacheLineSize) / 2, SWPrefetcher::Target::ALL>(this);
         }
     };
 
-    template <class Key, class Value, const uint64_t pageSize, const uint64_t cacheLineSize>
+    template <class Key, class Value, const uint64_t innerSize, const uint64_t leafSize, const uint64_t cacheLineSize>
     struct BTree
     {
         using task_type = Task;
 
-        std::atomic<NodeBase<pageSize, cacheLineSize> *> root;
+        std::atomic<NodeBase<innerSize, leafSize, cacheLineSize> *> root;
         SimpleContinuousAllocator &allocator;
 
         BTree(SimpleContinuousAllocator &allocator) : allocator(allocator)
         {
-            void *new_leaf_memory = allocator.allocate(sizeof(BTreeLeaf<Key, Value, pageSize, cacheLineSize>), alignof(BTreeLeaf<Key, Value, pageSize, cacheLineSize>));
+            void *new_leaf_memory = allocator.allocate(sizeof(BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize>), alignof(BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize>));
 
-            root = new (new_leaf_memory) BTreeLeaf<Key, Value, pageSize, cacheLineSize>();
+            root = new (new_leaf_memory) BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize>();
         }
 
         ~BTree() { root.load()->~NodeBase(); }
 
-        void makeRoot(Key k, NodeBase<pageSize, cacheLineSize> *leftChild, NodeBase<pageSize, cacheLineSize> *rightChild)
+        void makeRoot(Key k, NodeBase<innerSize, leafSize, cacheLineSize> *leftChild, NodeBase<innerSize, leafSize, cacheLineSize> *rightChild)
         {
-            void *new_inner_memory = allocator.allocate(sizeof(BTreeInner<Key, pageSize, cacheLineSize>), alignof(BTreeInner<Key, pageSize, cacheLineSize>));
+            void *new_inner_memory = allocator.allocate(sizeof(BTreeInner<Key, innerSize, leafSize, cacheLineSize>), alignof(BTreeInner<Key, innerSize, leafSize, cacheLineSize>));
 
-            auto inner = new (new_inner_memory) BTreeInner<Key, pageSize, cacheLineSize>();
+            auto inner = new (new_inner_memory) BTreeInner<Key, innerSize, leafSize, cacheLineSize>();
             inner->count = 1;
             inner->keys[0] = k;
             inner->children[0] = leftChild;
@@ -514,30 +524,38 @@ namespace btreeolc::coro_lines
             if (count > 3)
                 sched_yield();
             else
+            {
+                stats::pause_spin();
                 builtin::pause();
+            }
         }
 
         Task insert(Key k, Value v)
         {
             int restartCount = 0;
+            unsigned level = 0;
         restart:
             if (restartCount++)
+            {
+                stats::restart(level);
                 yield(restartCount);
+            }
+            level = 0;
             bool needRestart = false;
 
             // Current node
-            NodeBase<pageSize, cacheLineSize> *node = root;
+            NodeBase<innerSize, leafSize, cacheLineSize> *node = root;
             uint64_t versionNode = node->readLockOrRestart(needRestart);
             if (needRestart || (node != root))
                 goto restart;
 
             // Parent of current node
-            BTreeInner<Key, pageSize, cacheLineSize> *parent = nullptr;
+            BTreeInner<Key, innerSize, leafSize, cacheLineSize> *parent = nullptr;
             uint64_t versionParent;
 
             while (node->type == PageType::BTreeInner)
             {
-                auto inner = static_cast<BTreeInner<Key, pageSize, cacheLineSize> *>(node);
+                auto inner = static_cast<BTreeInner<Key, innerSize, leafSize, cacheLineSize> *>(node);
 
                 // Split eagerly if full
                 if (inner->isFull())
@@ -563,7 +581,8 @@ namespace btreeolc::coro_lines
                     }
                     // Split
                     Key sep;
-                    BTreeInner<Key, pageSize, cacheLineSize> *newInner = inner->split(sep, allocator);
+                    BTreeInner<Key, innerSize, leafSize, cacheLineSize> *newInner = inner->split(sep, allocator);
+                    stats::inner_split();
                     if (parent)
                         parent->insert(sep, newInner);
                     else
@@ -586,6 +605,7 @@ namespace btreeolc::coro_lines
                 versionParent = versionNode;
 
                 node = inner->children[inner->lowerBound(k)];
+                level++;
                 inner->checkOrRestart(versionNode, needRestart);
                 if (needRestart)
                     goto restart;
@@ -594,7 +614,7 @@ namespace btreeolc::coro_lines
                     goto restart;
             }
 
-            auto leaf = static_cast<BTreeLeaf<Key, Value, pageSize, cacheLineSize> *>(node);
+            auto leaf = static_cast<BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize> *>(node);
 
             // Split leaf if full
             if (leaf->count == leaf->maxEntries)
@@ -620,7 +640,8 @@ namespace btreeolc::coro_lines
                 }
                 // Split
                 Key sep;
-                BTreeLeaf<Key, Value, pageSize, cacheLineSize> *newLeaf = leaf->split(sep, allocator);
+                BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize> *newLeaf = leaf->split(sep, allocator);
+                stats::leaf_split();
                 if (parent)
                     parent->insert(sep, newLeaf);
                 else
@@ -655,23 +676,28 @@ namespace btreeolc::coro_lines
         Task lookup(Key k, Value &result)
         {
             int restartCount = 0;
+            unsigned level = 0;
         restart:
             if (restartCount++)
+            {
+                stats::restart(level);
                 yield(restartCount);
+            }
+            level = 0;
             bool needRestart = false;
 
-            NodeBase<pageSize, cacheLineSize> *node = root;
+            NodeBase<innerSize, leafSize, cacheLineSize> *node = root;
             uint64_t versionNode = node->readLockOrRestart(needRestart);
             if (needRestart || (node != root))
                 goto restart;
 
             // Parent of current node
-            BTreeInner<Key, pageSize, cacheLineSize> *parent = nullptr;
+            BTreeInner<Key, innerSize, leafSize, cacheLineSize> *parent = nullptr;
             uint64_t versionParent;
 
             while (node->type == PageType::BTreeInner)
             {
-                auto inner = static_cast<BTreeInner<Key, pageSize, cacheLineSize> *>(node);
+                auto inner = static_cast<BTreeInner<Key, innerSize, leafSize, cacheLineSize> *>(node);
 
                 if (parent)
                 {
@@ -700,6 +726,7 @@ namespace btreeolc::coro_lines
                  * TBD: We could also prefetch that specific cache line.
                  */
                 node = inner->children[pos];
+                level++;
 
                 inner->checkOrRestart(versionNode, needRestart);
                 if (needRestart)
@@ -715,7 +742,7 @@ namespace btreeolc::coro_lines
                     goto restart;
             }
 
-            BTreeLeaf<Key, Value, pageSize, cacheLineSize> *leaf = static_cast<BTreeLeaf<Key, Value, pageSize, cacheLineSize> *>(node);
+            BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize> *leaf = static_cast<BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize> *>(node);
 
             unsigned res;
             auto c = leaf->co_lowerBound(k, res);
@@ -751,23 +778,28 @@ namespace btreeolc::coro_lines
         uint64_t scan(Key k, int range, Value *output)
         {
             int restartCount = 0;
+            unsigned level = 0;
         restart:
             if (restartCount++)
+            {
+                stats::restart(level);
                 yield(restartCount);
+            }
+            level = 0;
             bool needRestart = false;
 
-            NodeBase<pageSize, cacheLineSize> *node = root;
+            NodeBase<innerSize, leafSize, cacheLineSize> *node = root;
             uint64_t versionNode = node->readLockOrRestart(needRestart);
             if (needRestart || (node != root))
                 goto restart;
 
             // Parent of current node
-            BTreeInner<Key, pageSize, cacheLineSize> *parent = nullptr;
+            BTreeInner<Key, innerSize, leafSize, cacheLineSize> *parent = nullptr;
             uint64_t versionParent;
 
             while (node->type == PageType::BTreeInner)
             {
-                auto inner = static_cast<BTreeInner<Key, pageSize, cacheLineSize> *>(node);
+                auto inner = static_cast<BTreeInner<Key, innerSize, leafSize, cacheLineSize> *>(node);
 
                 if (parent)
                 {
@@ -780,6 +812,7 @@ namespace btreeolc::coro_lines
                 versionParent = versionNode;
 
                 node = inner->children[inner->lowerBound(k)];
+                level++;
                 inner->checkOrRestart(versionNode, needRestart);
                 if (needRestart)
                     goto restart;
@@ -788,7 +821,7 @@ namespace btreeolc::coro_lines
                     goto restart;
             }
 
-            BTreeLeaf<Key, Value, pageSize, cacheLineSize> *leaf = static_cast<BTreeLeaf<Key, Value, pageSize, cacheLineSize> *>(node);
+            BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize> *leaf = static_cast<BTreeLeaf<Key, Value, innerSize, leafSize, cacheLineSize> *>(node);
             unsigned pos = leaf->lowerBound(k);
             int count = 0;
             for (unsigned i = pos; i < leaf->count; i++)
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+/***
+ * Optional contention counters for the OLC BTrees.
+ *
+ * Every thread counts into its own thread_local OLCStats, so the hot path stays free of shared writes. Threads
+ * publish their counters with flush() once they are done, the benchmark then reads the aggregate via collect().
+ * Counting is compiled out unless BTREE_OLC_STATS is defined (cmake -DBTREE_OLC_STATS=ON).
+ */
+
+namespace btreeolc::stats
+{
+#if defined(BTREE_OLC_STATS)
+    constexpr bool enabled = true;
+#else
+    constexpr bool enabled = false;
+#endif
+
+    // Deeper levels are accounted to the last slot.
+    constexpr std::size_t max_levels = 16;
+
+    struct OLCStats
+    {
+        std::array<std::uint64_t, max_levels> restarts_per_level{};
+        std::uint64_t upgrade_failures = 0;
+        // Pauses while waiting for a locked node or backing off before a restart, not the pause after a failed upgrade.
+        std::uint64_t pause_spins = 0;
+        std::uint64_t inner_splits = 0;
+        std::uint64_t leaf_splits = 0;
+
+        std::uint64_t restarts() const
+        {
+            std::uint64_t sum = 0;
+            for (auto restarts : restarts_per_level)
+            {
+                sum += restarts;
+            }
+            return sum;
+        }
+
+        void merge(const OLCStats &other)
+        {
+            for (std::size_t level = 0; level < max_levels; ++level)
+            {
+                restarts_per_level[level] += other.restarts_per_level[level];
+            }
+            upgrade_failures += other.upgrade_failures;
+            pause_spins += other.pause_spins;
+            inner_splits += other.inner_splits;
+            leaf_splits += other.leaf_splits;
+        }
+    };
+
+    inline thread_local OLCStats thread_stats;
+
+    inline OLCStats global_stats;
+    inline std::mutex global_stats_mutex;
+
+    inline void restart(unsigned level)
+    {
+        if constexpr (enabled)
+        {
+            thread_stats.restarts_per_level[(level < max_levels) ? level : max_levels - 1]++;
+        }
+    }
+
+    inline void upgrade_failure()
+    {
+        if constexpr (enabled)
+        {
+            thread_stats.upgrade_failures++;
+        }
+    }
+
+    inline void pause_spin()
+    {
+        if constexpr (enabled)
+        {
+            thread_stats.pause_spins++;
+        }
+    }
+
+    inline void inner_split()
+    {
+        if constexpr (enabled)
+        {
+            thread_stats.inner_splits++;
+        }
+    }
+
+    inline void leaf_split()
+    {
+        if constexpr (enabled)
+        {
+            thread_stats.leaf_splits++;
+        }
+    }
+
+    // Publishes the calling thread's counters and resets them.
+    inline void flush()
+    {
+        if constexpr (enabled)
+        {
+            std::lock_guard<std::mutex> lock(global_stats_mutex);
+            global_stats.merge(thread_stats);
+            thread_stats = OLCStats{};
+        }
+    }
+
+    inline OLCStats collect()
+    {
+        std::lock_guard<std::mutex> lock(global_stats_mutex);
+        return global_stats;
+    }
+
+    inline void reset()
+    {
+        std::lock_guard<std::mutex> lock(global_stats_mutex);
+        global_stats = OLCStats{};
+        thread_stats = OLCStats{};
+    }
+} // namespace btreeolc::stats
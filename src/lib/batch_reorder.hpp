@@ -0,0 +1,49 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Radix partitioning of lookup batches by memory region. A batch executed region by region touches few pages at a
+ * time, so random accesses turn into short ascending runs that the TLB and the hardware prefetchers can serve. The
+ * partitioning is a single stable counting-sort pass with at most 2^radix_bits partitions, whose histogram stays in
+ * L1. Callers execute the batch in the returned order and write every result to its original index.
+ */
+struct BatchReorder
+{
+    static constexpr size_t page_shift = 12;
+    static constexpr size_t huge_page_shift = 21;
+    static constexpr size_t default_radix_bits = 10;
+
+    // Smallest shift of at least min_shift that maps the byte offsets [0, total_bytes) onto 2^radix_bits regions.
+    static size_t region_shift(size_t total_bytes, size_t min_shift, size_t radix_bits = default_radix_bits)
+    {
+        const size_t address_bits = std::bit_width(total_bytes > 0 ? total_bytes - 1 : 0);
+        return std::max(min_shift, address_bits > radix_bits ? address_bits - radix_bits : 0);
+    }
+
+    // Fills order with [0, count) sorted stably by region(i), which must be below 2^radix_bits.
+    template <typename Region>
+    static void partition(size_t count, Region region, std::vector<uint32_t> &order, size_t radix_bits = default_radix_bits)
+    {
+        std::vector<uint32_t> regions(count);
+        std::vector<uint32_t> offsets((size_t{1} << radix_bits) + 1, 0);
+        for (size_t i = 0; i < count; ++i)
+        {
+            regions[i] = static_cast<uint32_t>(region(i));
+            ++offsets[regions[i] + 1];
+        }
+        for (size_t r = 1; r < offsets.size(); ++r)
+        {
+            offsets[r] += offsets[r - 1];
+        }
+        order.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            order[offsets[regions[i]]++] = static_cast<uint32_t>(i);
+        }
+    }
+};
@@ -0,0 +1,62 @@
+#ifndef __CSSL_SIMD_H
+#define __CSSL_SIMD_H
+
+#include <stdint.h>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// width of the fast-lane compare kernel, chosen at compile time
+#if defined(__AVX512F__)
+#define CSSL_SIMD_BITS 512
+#elif defined(__AVX2__)
+#define CSSL_SIMD_BITS 256
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define CSSL_SIMD_BITS 128
+#else
+// scalar kernel, a loop the compiler may still vectorize
+#define CSSL_SIMD_BITS 256
+#endif
+
+#ifndef CSSL_CACHE_LINE_SIZE
+#if defined(__APPLE__) && defined(__aarch64__)
+#define CSSL_CACHE_LINE_SIZE 128
+#else
+#define CSSL_CACHE_LINE_SIZE 64
+#endif
+#endif
+
+// number of keys that are compared by one kernel call
+#define SIMD_SEGMENTS (CSSL_SIMD_BITS / 32)
+#define SIMD_FULL_MASK ((uint32_t)((1ull << SIMD_SEGMENTS) - 1))
+// initial size of the highest fast lane: whole cache lines of keys and
+// whole kernel calls
+#define TOP_LANE_BLOCK (CSSL_CACHE_LINE_SIZE / 4 > SIMD_SEGMENTS ? CSSL_CACHE_LINE_SIZE / 4 : SIMD_SEGMENTS)
+
+// Bitmask of the SIMD_SEGMENTS fast-lane keys starting at keys that are <= key
+static inline uint32_t flaneMaskLessEqual(const uint32_t *keys, uint32_t key)
+{
+#if defined(__AVX512F__)
+  return _mm512_cmple_epu32_mask(_mm512_loadu_si512(keys), _mm512_set1_epi32(key));
+#elif defined(__AVX2__)
+  // AVX2 only compares signed integers, flipping the sign bits keeps the unsigned order
+  const __m256i bias = _mm256_set1_epi32(INT32_MIN);
+  __m256i lane = _mm256_xor_si256(_mm256_loadu_si256((__m256i const *)keys), bias);
+  __m256i greater = _mm256_cmpgt_epi32(lane, _mm256_xor_si256(_mm256_set1_epi32(key), bias));
+  return ~(uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(greater)) & SIMD_FULL_MASK;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  const uint32_t bit_values[4] = {1, 2, 4, 8};
+  uint32x4_t less_equal = vcleq_u32(vld1q_u32(keys), vdupq_n_u32(key));
+  return vaddvq_u32(vandq_u32(less_equal, vld1q_u32(bit_values)));
+#else
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < SIMD_SEGMENTS; i++)
+    mask |= (uint32_t)(keys[i] <= key) << i;
+  return mask;
+#endif
+}
+
+#endif
@@ -0,0 +1,294 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "cssl_simd.hpp"
+
+/**
+ * Cache-sensitive skip list (CSSL) with fast lanes, templated on the key type, the payload type and the SIMD width.
+ * The fast lanes are one register-aligned array of keys, highest lane first. The highest lane is searched by comparing
+ * whole registers of keys, with 32 or 64 bit lanes depending on K. Each key of the lowest fast lane owns a proxy node
+ * with the keys and payloads of the next skip data nodes, so point lookups never touch the data list.
+ * As the C API in skiplist.hpp, the list is bulk loaded with strictly ascending keys; the maximum of K is reserved as
+ * the empty-slot sentinel. Nodes and lanes come from a memory resource, with a bump allocator such as
+ * SimpleContinuousAllocator the data and proxy nodes of a bulk load are key-ordered in memory. The SIMD width defaults
+ * to the widest vector unit the build targets (cssl_simd.hpp).
+ */
+template <typename K, typename P, size_t SimdBits = CSSL_SIMD_BITS>
+class CSSLSkipList
+{
+    static_assert(std::is_unsigned_v<K> && (sizeof(K) == 4 || sizeof(K) == 8), "Keys are 32 or 64 bit unsigned integers.");
+
+public:
+    static constexpr size_t max_skip = 5;
+    // Keys compared per SIMD step.
+    static constexpr size_t simd_lanes = SimdBits / (8 * sizeof(K));
+    // Initial number of keys in the highest fast lane, whole cache lines and whole registers.
+    static constexpr size_t top_lane_block = std::max(CSSL_CACHE_LINE_SIZE / sizeof(K), simd_lanes);
+    static constexpr K sentinel = std::numeric_limits<K>::max();
+    static_assert(simd_lanes > 0 && top_lane_block % simd_lanes == 0, "The top lane has to fill whole registers.");
+
+    struct DataNode
+    {
+        K key;
+        P payload;
+        DataNode *next;
+    };
+
+    struct ProxyNode
+    {
+        K keys[max_skip];
+        P payloads[max_skip];
+        DataNode *pointers[max_skip];
+    };
+
+    CSSLSkipList(uint8_t max_level, uint8_t skip, std::pmr::memory_resource &resource = *std::pmr::get_default_resource())
+        : max_level(max_level), skip(std::clamp<uint8_t>(skip, 2, max_skip)), items_per_level(max_level), starts_of_flanes(max_level), flane_items(max_level, 0), level_strides(max_level + 1), resource(resource), lane_storage(&resource)
+    {
+        if (max_level == 0)
+        {
+            throw std::invalid_argument("CSSLSkipList needs at least one fast lane.");
+        }
+        level_strides[0] = 1;
+        for (size_t level = 1; level <= max_level; ++level)
+        {
+            level_strides[level] = level_strides[level - 1] * this->skip;
+        }
+        layout_lanes(top_lane_block);
+        lane_storage = allocate_lanes();
+        flanes = reinterpret_cast<K *>(lane_storage.data());
+        flane_pointers.assign(items_per_level[0], nullptr);
+    }
+
+    ~CSSLSkipList()
+    {
+        for (auto *proxy : flane_pointers)
+        {
+            if (proxy != nullptr)
+            {
+                proxy->~ProxyNode();
+                resource.deallocate(proxy, sizeof(ProxyNode), alignof(ProxyNode));
+            }
+        }
+        while (head != nullptr)
+        {
+            DataNode *next = head->next;
+            head->~DataNode();
+            resource.deallocate(head, sizeof(DataNode), alignof(DataNode));
+            head = next;
+        }
+    }
+
+    CSSLSkipList(const CSSLSkipList &) = delete;
+    CSSLSkipList &operator=(const CSSLSkipList &) = delete;
+
+    // Appends key, which has to be larger than all keys inserted before (bulk insert).
+    void insert(K key, const P &payload)
+    {
+        if (key == sentinel)
+        {
+            throw std::invalid_argument("The maximum key is reserved as sentinel.");
+        }
+        if (tail != nullptr && key <= tail->key)
+        {
+            throw std::invalid_argument("CSSLSkipList keys have to be inserted in ascending order.");
+        }
+
+        auto *node = new (resource.allocate(sizeof(DataNode), alignof(DataNode))) DataNode{key, payload, nullptr};
+        if (tail == nullptr)
+        {
+            head = node;
+        }
+        else
+        {
+            tail->next = node;
+        }
+        tail = node;
+
+        // Every skip^(level + 1)-th key is promoted to the fast lane at level, lower lanes first.
+        if (num_elements % level_strides[1] == 0)
+        {
+            for (size_t level = 0; level < max_level && num_elements % level_strides[level + 1] == 0; ++level)
+            {
+                flanes[starts_of_flanes[level] + flane_items[level]] = key;
+                if (level == 0)
+                {
+                    auto *proxy = new (resource.allocate(sizeof(ProxyNode), alignof(ProxyNode))) ProxyNode;
+                    std::fill(std::begin(proxy->keys), std::end(proxy->keys), sentinel);
+                    proxy->keys[0] = key;
+                    proxy->payloads[0] = payload;
+                    proxy->pointers[0] = node;
+                    flane_pointers[flane_items[0]] = proxy;
+                }
+                flane_items[level]++;
+            }
+        }
+        else
+        {
+            ProxyNode *proxy = flane_pointers[flane_items[0] - 1];
+            const size_t slot = num_elements % level_strides[1];
+            proxy->keys[slot] = key;
+            proxy->payloads[slot] = payload;
+            proxy->pointers[slot] = node;
+        }
+
+        num_elements++;
+        if (num_elements % (top_lane_block * level_strides[max_level]) == 0)
+        {
+            resize_lanes();
+        }
+    }
+
+    std::optional<P> find(K key) const
+    {
+        if (num_elements == 0 || key < head->key || key == sentinel)
+        {
+            return std::nullopt;
+        }
+
+        size_t rPos = top_lane_position(key);
+        for (int level = max_level - 1; level >= 0; --level)
+        {
+            const size_t pos = starts_of_flanes[level] + rPos;
+            rPos += scan(pos, key, flane_items[level] - 1 - rPos);
+            if (level > 0)
+            {
+                rPos *= skip;
+            }
+        }
+
+        const ProxyNode *proxy = flane_pointers[rPos];
+        for (size_t i = 0; i < skip; ++i)
+        {
+            if (proxy->keys[i] == key)
+            {
+                return proxy->payloads[i];
+            }
+        }
+        return std::nullopt;
+    }
+
+    bool contains(K key) const { return find(key).has_value(); }
+    size_t size() const { return num_elements; }
+
+private:
+    typedef K Register __attribute__((vector_size(SimdBits / 8)));
+    // Register-sized and -aligned group of lane keys, the unit of lane storage.
+    struct alignas(SimdBits / 8) Block
+    {
+        K keys[simd_lanes];
+    };
+
+    uint8_t max_level;
+    uint8_t skip;
+    size_t num_elements = 0;
+    std::vector<size_t> items_per_level;
+    std::vector<size_t> starts_of_flanes;
+    std::vector<size_t> flane_items;
+    // skip^level, the distance between two data nodes promoted to fast lane level - 1.
+    std::vector<size_t> level_strides;
+    std::pmr::memory_resource &resource;
+    // All fast lanes in register-aligned storage.
+    std::pmr::vector<Block> lane_storage;
+    K *flanes;
+    std::vector<ProxyNode *> flane_pointers;
+    DataNode *head = nullptr;
+    DataNode *tail = nullptr;
+
+    size_t lanes_size() const { return starts_of_flanes[0] + items_per_level[0]; }
+
+    void layout_lanes(size_t top_lane_items)
+    {
+        items_per_level[max_level - 1] = top_lane_items;
+        starts_of_flanes[max_level - 1] = 0;
+        for (int level = max_level - 2; level >= 0; --level)
+        {
+            items_per_level[level] = items_per_level[level + 1] * skip;
+            starts_of_flanes[level] = starts_of_flanes[level + 1] + items_per_level[level + 1];
+        }
+    }
+
+    std::pmr::vector<Block> allocate_lanes() const
+    {
+        Block empty;
+        std::fill(std::begin(empty.keys), std::end(empty.keys), sentinel);
+        return std::pmr::vector<Block>((lanes_size() + simd_lanes - 1) / simd_lanes, empty, &resource);
+    }
+
+    void resize_lanes()
+    {
+        const auto old_starts = starts_of_flanes;
+        layout_lanes(items_per_level[max_level - 1] + top_lane_block);
+        auto new_storage = allocate_lanes();
+        K *new_flanes = reinterpret_cast<K *>(new_storage.data());
+        for (size_t level = 0; level < max_level; ++level)
+        {
+            std::copy_n(flanes + old_starts[level], flane_items[level], new_flanes + starts_of_flanes[level]);
+        }
+        lane_storage = std::move(new_storage);
+        flanes = new_flanes;
+        flane_pointers.resize(items_per_level[0], nullptr);
+    }
+
+    // Bitmask of the keys of block that are <= key.
+    static uint32_t compare_mask(const Block &block, K key)
+    {
+        Register keys;
+        Register search;
+        std::memcpy(&keys, block.keys, sizeof(keys));
+        for (size_t i = 0; i < simd_lanes; ++i)
+        {
+            search[i] = key;
+        }
+        const auto less_equal = keys <= search;
+        uint32_t mask = 0;
+        for (size_t i = 0; i < simd_lanes; ++i)
+        {
+            mask |= static_cast<uint32_t>(less_equal[i] & 1) << i;
+        }
+        return mask;
+    }
+
+    // Position of the last key <= key in the (cached) highest fast lane, the first key of the list is on every lane.
+    // The top lane starts the lane storage and is a multiple of the register width, so it is compared register by
+    // register without branching on single keys.
+    size_t top_lane_position(K key) const
+    {
+        constexpr uint32_t full = simd_lanes == 32 ? ~0u : (1u << simd_lanes) - 1;
+        const Block *block = lane_storage.data();
+        const Block *end = block + items_per_level[max_level - 1] / simd_lanes;
+        size_t count = 0;
+        for (; block < end; ++block)
+        {
+            const uint32_t mask = compare_mask(*block, key);
+            count += std::popcount(mask);
+            if (mask != full)
+            {
+                break;
+            }
+        }
+        return count - 1;
+    }
+
+    // Number of keys following pos that are <= key, at most limit. A lane step covers at most skip keys, a branch per
+    // key lets the CPU speculate into the next lane, which a register compare would serialize behind its mask.
+    size_t scan(size_t pos, K key, size_t limit) const
+    {
+        size_t n = 0;
+        while (n < limit && flanes[pos + 1 + n] <= key)
+        {
+            n++;
+        }
+        return n;
+    }
+};
@@ -1,251 +1,416 @@
 #include "hashmap.hpp"
+#include "prefetching.hpp"
 #include "utils.cpp"
 
+#if defined(AARCH64)
+#include <arm_neon.h>
+#endif
+
+// Salts of the split block Bloom filter (Putze et al., as used by Impala and Parquet).
+static constexpr uint32_t bloom_filter_salts[8] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU, 0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+BlockedBloomFilter::BlockedBloomFilter(size_t bits, std::pmr::memory_resource &memory_resource) : blocks((bits + 511) / 512, &memory_resource)
+{
+    ensure(blocks.size() <= std::numeric_limits<uint32_t>::max(), "Too many Bloom filter blocks for the fast range reduction.");
+}
+
+bool BlockedBloomFilter::enabled() const
+{
+    return !blocks.empty();
+}
+
+const BlockedBloomFilter::Block &BlockedBloomFilter::block_for(uint64_t hash) const
+{
+    return blocks[((hash >> 32) * blocks.size()) >> 32];
+}
+
+uint64_t BlockedBloomFilter::mask_for(uint64_t hash, size_t word)
+{
+    return uint64_t{1} << ((static_cast<uint32_t>(hash) * bloom_filter_salts[word]) >> 26);
+}
+
+void BlockedBloomFilter::insert(uint64_t hash)
+{
+    auto &block = const_cast<Block &>(block_for(hash));
+    for (size_t word = 0; word < 8; ++word)
+    {
+        block.words[word] |= mask_for(hash, word);
+    }
+}
+
+bool BlockedBloomFilter::contains(uint64_t hash) const
+{
+    const auto &block = block_for(hash);
+    bool contained = true;
+    for (size_t word = 0; word < 8; ++word)
+    {
+        const uint64_t mask = mask_for(hash, word);
+        contained &= (block.words[word] & mask) == mask;
+    }
+    return contained;
+}
+
+void BlockedBloomFilter::prefetch(uint64_t hash) const
+{
+    __builtin_prefetch(&block_for(hash), 0, 3);
+}
+
+template <typename K, typename V>
+uint64_t HashMap<K, V>::filter_hash(const K &key)
+{
+    // Independent of the murmur bucket hash.
+    return static_cast<uint64_t>(std::hash<K>{}(key)) * 0x9E3779B97F4A7C15ULL;
+}
+
+template <typename K, typename V>
+bool HashMap<K, V>::may_contain(const K &key) const
+{
+    return !bloom_filter.enabled() || bloom_filter.contains(filter_hash(key));
+}
+
+template <typename K, typename V>
+void HashMap<K, V>::prefetch_filter(const K &key) const
+{
+    if (bloom_filter.enabled())
+    {
+        bloom_filter.prefetch(filter_hash(key));
+    }
+}
+
+template <typename K, typename V>
+size_t HashMap<K, V>::hash_to_bucket(const K &key, uint64_t buckets)
+{
+    // Murmur instead of the identity std::hash, reduced onto [0, buckets) by fast range instead of a division.
+    const uint64_t h = std::hash<K>{}(key);
+    const uint32_t mixed = murmur_32(static_cast<uint32_t>(h ^ (h >> 32)));
+    return static_cast<size_t>((static_cast<uint64_t>(mixed) * buckets) >> 32);
+}
+
 template<typename K, typename V>
 size_t HashMap<K, V>::hash(const K& key) {
-    return std::hash<K>{}(key) % capacity;
+    return hash_to_bucket(key, capacity);
 }
 
 template <typename K, typename V>
-HashMap<K, V>::HashMap(size_t capacity, PrefetchProfiler &profiler, std::pmr::memory_resource &memory_resource) : capacity(capacity), size(0), profiler(profiler), memory_resource(memory_resource), table(&memory_resource)
+typename HashMap<K, V>::Bucket &HashMap<K, V>::bucket_for(const K &key)
 {
-    table.resize(capacity);
-    for (int i = 0; i < capacity; ++i)
+    if (migrating())
+    {
+        // Keys of old buckets that have not been migrated yet still live in the old table.
+        const size_t old_index = hash_to_bucket(key, old_table.size());
+        if (old_index >= migration_cursor)
+        {
+            return old_table[old_index];
+        }
+    }
+    return table[hash(key)];
+}
+
+template <typename K, typename V>
+void HashMap<K, V>::hash_batch(const std::vector<K> &keys, std::vector<Bucket *> &buckets)
+{
+    // Separate pass without dependencies between the iterations, so the compiler can vectorize it.
+    const uint64_t num_buckets = capacity;
+    const size_t num_keys = keys.size();
+    const K *__restrict in = keys.data();
+    Bucket *base = table.data();
+    Bucket **__restrict out = buckets.data();
+    for (size_t i = 0; i < num_keys; ++i)
+    {
+        out[i] = base + hash_to_bucket(in[i], num_buckets);
+    }
+
+    if (migrating())
+    {
+        const uint64_t old_num_buckets = old_table.size();
+        for (size_t i = 0; i < num_keys; ++i)
+        {
+            const size_t old_index = hash_to_bucket(in[i], old_num_buckets);
+            if (old_index >= migration_cursor)
+            {
+                out[i] = &old_table[old_index];
+            }
+        }
+    }
+}
+
+template <typename K, typename V>
+bool HashMap<K, V>::migrating() const
+{
+    return !old_table.empty();
+}
+
+template <typename K, typename V>
+void HashMap<K, V>::grow()
+{
+    if (migrating())
+    {
+        migrate(old_table.size());
+    }
+    ensure(capacity * 2 <= std::numeric_limits<uint32_t>::max(), "Too many buckets for the fast range reduction.");
+
+    // Only swap in the new table here, the entries move over incrementally with later operations.
+    old_table = std::move(table);
+    capacity *= 2;
+    table = std::pmr::vector<Bucket>(capacity, &memory_resource);
+    migration_cursor = 0;
+}
+
+template <typename K, typename V>
+void HashMap<K, V>::migrate(size_t num_old_buckets)
+{
+    const size_t end = std::min(migration_cursor + num_old_buckets, old_table.size());
+    for (; migration_cursor < end; ++migration_cursor)
+    {
+        auto &old_bucket = old_table[migration_cursor];
+        while (!old_bucket.empty())
+        {
+            // Relinks the list node, nothing is copied or allocated.
+            auto &new_bucket = table[hash(old_bucket.front().key)];
+            new_bucket.splice(new_bucket.end(), old_bucket, old_bucket.begin());
+        }
+    }
+
+    if (migration_cursor == old_table.size())
+    {
+        old_table = std::pmr::vector<Bucket>(&memory_resource);
+        migration_cursor = 0;
+    }
+}
+
+template <typename K, typename V>
+void HashMap<K, V>::maintain()
+{
+    if (migrating())
+    {
+        migrate(migration_step);
+    }
+    else if (max_load_factor > 0 && size > capacity * max_load_factor)
     {
-        table.emplace_back(std::pmr::list<Node<K, V>>(&memory_resource));
+        grow();
     }
 }
 
+template <typename K, typename V>
+HashMap<K, V>::HashMap(size_t capacity, PrefetchProfiler &profiler, std::pmr::memory_resource &memory_resource, double max_load_factor, size_t bloom_filter_bits) : capacity(capacity), size(0), max_load_factor(max_load_factor), profiler(profiler), memory_resource(memory_resource), table(&memory_resource), old_table(&memory_resource), bloom_filter(bloom_filter_bits, memory_resource)
+{
+    ensure(capacity <= std::numeric_limits<uint32_t>::max(), "Too many buckets for the fast range reduction.");
+    // Exactly capacity buckets, bucket_for() and migrate() derive the old capacity from the old table size.
+    table.resize(capacity);
+}
+
 template<typename K, typename V>
 HashMap<K, V>::~HashMap() {}
 
 template<typename K, typename V>
 void HashMap<K, V>::insert(const K& key, const V& value) {
-    size_t index = hash(key);
-    for (auto& node : table[index]) {
+    auto &bucket = bucket_for(key);
+    for (auto& node : bucket) {
         if (node.key == key) {
             node.value = value;
             return;
         }
     }
-    table[index].emplace_back(key, value);
+    bucket.emplace_back(key, value);
+    if (bloom_filter.enabled())
+    {
+        bloom_filter.insert(filter_hash(key));
+    }
     size++;
+    maintain();
 }
 
-template<typename K, typename V>
-V& HashMap<K, V>::get(const K& key) {
-    size_t index = hash(key);
-    for (auto& node : table[index]) {
-        if (node.key == key) {
-            return node.value;
-        }
+template <typename K, typename V>
+void HashMap<K, V>::allocate_nodes(const std::vector<K> &keys, const std::vector<V> &values, Bucket &spare, std::vector<typename Bucket::iterator> &nodes)
+{
+    // One tight allocation loop for the whole batch instead of one allocation per linked key. Nodes of keys that
+    // turn out to be updates are freed together with the spare list.
+    nodes.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        nodes[i] = spare.emplace(spare.end(), keys[i], values[i]);
     }
-    throw out_of_range("Key not found");
 }
 
-template<typename K, typename V>
-void HashMap<K, V>::vectorized_get(const std::vector<K>& keys, std::vector<V>& results) {
-    int i = 0;
-    for(auto &key : keys){
-        size_t index = hash(key);
-        bool found = false;
-        for (auto& node : table[index]) {
-            if (node.key == key) {
-                results.at(i) = node.value;
-                found = true;
-                break;
-            }
-        }
-        if(!found){
-            throw out_of_range("Key not found");
-        }
-        i++;
+template <typename K, typename V>
+void HashMap<K, V>::link(Bucket &bucket, Bucket &spare, typename Bucket::iterator node)
+{
+    // Both lists use the same memory resource, so splicing only relinks the node.
+    bucket.splice(bucket.end(), spare, node);
+    if (bloom_filter.enabled())
+    {
+        bloom_filter.insert(filter_hash(node->key));
     }
+    size++;
 }
 
-template<typename K, typename V>
-void HashMap<K, V>::vectorized_get_gp(const std::vector<K>& keys, std::vector<V>& results) {
-    // Vector to keep track of states for each key
-    std::vector<int> states(keys.size(), -1);
+template <typename K, typename V>
+void HashMap<K, V>::maintain_batch(size_t inserted)
+{
+    // Bucket pointers of a batch are computed up front, so growth and migration only catch up after the batch, at
+    // the same rate as for single inserts.
+    for (size_t i = 0; i < inserted; ++i)
+    {
+        maintain();
+    }
+}
+
+template <typename K, typename V>
+void HashMap<K, V>::vectorized_insert_gp(const std::vector<K> &keys, const std::vector<V> &values)
+{
     // states:
     // -1: Get first node
     //  0: Prefetch next list node
-    //  1: Finished, element found
+    //  1: Finished, value updated or node linked
+    std::vector<int> states(keys.size(), -1);
+    std::vector<typename Bucket::iterator> cursors(keys.size());
 
-    std::vector<typename std::list<Node<K, V>>::iterator> nodes;
+    std::vector<Bucket *> buckets(keys.size());
+    hash_batch(keys, buckets);
 
-    for (auto& key : keys) {
-        __builtin_prefetch(&table[hash(key)], 0, 3);
+    Bucket spare(&memory_resource);
+    std::vector<typename Bucket::iterator> nodes;
+    allocate_nodes(keys, values, spare, nodes);
+    const size_t size_before = size;
+
+    // The bucket (list head) is written when a node is linked at the end of its chain
+    for (int i = 0; i < keys.size(); i++) {
+        __builtin_prefetch(buckets[i], 1, 3);
     }
 
     int finished = 0;
     while (finished < keys.size()) {
         for (int i = 0; i < keys.size(); i++) {
-            int& state = states[i];
+            int &state = states[i];
+            if (state == 1) {
+                continue;
+            }
+            auto &cursor = cursors[i];
             if (state == -1) {
-                size_t index = hash(keys[i]);
-                nodes.emplace_back(table[index].begin());
-                __builtin_prefetch(&(*nodes.back()), 0, 3);
+                cursor = buckets[i]->begin();
                 state = 0;
-            } else if (state == 0) {
-                auto& node = nodes[i];
-                if (node->key == keys[i]) {
-                    results[i] = node->value;
-                    state = 1;
-                    ++finished;
-                    continue;
-                }
-                ++node;
-                if (node != table[hash(keys[i])].end()) {
-                    __builtin_prefetch(reinterpret_cast<char *>(&(*node)), 0, 3);
-                } else {
-                    throw out_of_range("Key not found.");
-                }
-            } else {
-                // Finished processing this key
+            } else if (cursor->key == keys[i]) {
+                cursor->value = values[i];
+                state = 1;
+                ++finished;
                 continue;
+            } else {
+                // Sees nodes linked by earlier duplicates of the key in this batch
+                ++cursor;
+            }
+
+            if (cursor == buckets[i]->end()) {
+                link(*buckets[i], spare, nodes[i]);
+                state = 1;
+                ++finished;
+            } else {
+                // Write intent, the last node of the chain gets relinked
+                __builtin_prefetch(&(*cursor), 1, 3);
             }
         }
     }
+    maintain_batch(size - size_before);
 }
 
+template <typename K, typename V>
+void HashMap<K, V>::vectorized_insert_amac(const std::vector<K> &keys, const std::vector<V> &values, int group_size)
+{
+    CircularBuffer<AMAC_insert_state> buff(group_size);
 
+    std::vector<Bucket *> buckets(keys.size());
+    hash_batch(keys, buckets);
 
-template<typename K, typename V>
-void HashMap<K, V>::vectorized_get_amac(const std::vector<K>& keys, std::vector<V>& results, int group_size) {
-    CircularBuffer<AMAC_state> buff(group_size);
+    Bucket spare(&memory_resource);
+    std::vector<typename Bucket::iterator> nodes;
+    allocate_nodes(keys, values, spare, nodes);
+    const size_t size_before = size;
 
-    // Initialize variables
     int num_finished = 0;
     int i = 0;
-    int j = 0;
     while (num_finished < keys.size()) {
-        AMAC_state& state = buff.next_state();
+        AMAC_insert_state &state = buff.next_state();
 
         if (state.stage == 0) {
-            if(i >= keys.size()){
+            if (i >= keys.size()) {
                 continue;
             }
             state.i = i;
-            state.key = keys[i++];
-            state.node = table[hash(state.key)].begin();
-            state.end = table[hash(state.key)].end();
+            state.bucket = buckets[i];
+            i++;
             state.stage = 1;
-            __builtin_prefetch(&(*state.node), 0, 3);
+            __builtin_prefetch(state.bucket, 1, 3);
         } else if (state.stage == 1) {
-            if (state.key == state.node->key) {
+            state.cursor = state.bucket->begin();
+            state.stage = 2;
+            if (state.cursor != state.bucket->end()) {
+                __builtin_prefetch(&(*state.cursor), 1, 3);
+                continue;
+            }
+            link(*state.bucket, spare, nodes[state.i]);
+            state.stage = 0;
+            num_finished++;
+        } else if (state.stage == 2) {
+            if (state.cursor->key == keys[state.i]) {
+                state.cursor->value = values[state.i];
                 state.stage = 0;
-                results[state.i] = state.node->value;
                 num_finished++;
-            } else {
-                ++state.node;
-                if (state.node == state.end) {
-                    throw out_of_range("Key not found.");
-                }
-                __builtin_prefetch(&(*state.node), 0, 3);
+                continue;
             }
+            ++state.cursor;
+            if (state.cursor != state.bucket->end()) {
+                __builtin_prefetch(&(*state.cursor), 1, 3);
+                continue;
+            }
+            link(*state.bucket, spare, nodes[state.i]);
+            state.stage = 0;
+            num_finished++;
         }
     }
-}
-
-
-template<typename K, typename V>
-coroutine HashMap<K, V>::get_co(const K& key, std::vector<V>& results, const int i){
-    size_t index = hash(key);
-
-    // prefetch bucket (list head)
-    __builtin_prefetch(&table[index], 0, 3);
-    co_await std::suspend_always{};
-
-
-    auto node = table[index].begin();
-    auto end = table[index].end();
-    while (node != end) {
-        __builtin_prefetch(&(*node), 0, 3);
-        co_await std::suspend_always{};
-        if (node->key == key) {
-            results.at(i) = node->value;
-            co_return;
-        }
-        ++node;
-    }
-    throw out_of_range("Key not found");
+    maintain_batch(size - size_before);
 }
 
 template <typename K, typename V>
-coroutine HashMap<K, V>::get_co_exp(const K &key, std::vector<V> &results, const int i)
+coroutine HashMap<K, V>::insert_co(Bucket *bucket, Bucket &spare, typename Bucket::iterator node)
 {
-    size_t index = hash(key);
+    // prefetch bucket (list head) with write intent
+    __builtin_prefetch(bucket, 1, 3);
+    co_await std::suspend_always{};
 
-    // prefetch bucket(list head)
-    if (!is_in_tlb_and_prefetch(&table[index]))
-    {
+    auto cursor = bucket->begin();
+    while (cursor != bucket->end()) {
+        __builtin_prefetch(&(*cursor), 1, 3);
         co_await std::suspend_always{};
-    }
 
-    auto node = table[index].begin();
-    auto end = table[index].end();
-    while (node != end)
-    {
-        if (!is_in_tlb_and_prefetch(&(*node)))
-        {
-            co_await std::suspend_always{};
-        }
-        if (node->key == key)
-        {
-            results.at(i) = node->value;
+        if (cursor->key == node->key) {
+            cursor->value = node->value;
             co_return;
         }
-        ++node;
+        ++cursor;
     }
-    throw out_of_range("Key not found");
+    link(*bucket, spare, node);
 }
 
 template <typename K, typename V>
-coroutine HashMap<K, V>::profile_get_co_exp(const K &key, std::vector<V> &results, const int i)
+void HashMap<K, V>::vectorized_insert_coroutine(const std::vector<K> &keys, const std::vector<V> &values, int group_size)
 {
-    size_t prefetch_count = 0;
-    bool assume_cached = true;
-    size_t index = hash(key);
-
-    // if (!is_in_tlb_prefetch_profile(&table[index], prefetch_count, profiler, assume_cached))
-    //{
-    co_await std::suspend_always{};
-    //}
+    std::vector<Bucket *> buckets(keys.size());
+    hash_batch(keys, buckets);
 
-    auto node = table[index].begin();
-    auto end = table[index].end();
-    while (node != end)
-    {
-        // if (!is_in_tlb_prefetch_profile(&(*node), prefetch_count, profiler, assume_cached))
-        //{
-        co_await std::suspend_always{};
-        //}
-        if (node->key == key)
-        {
-            results.at(i) = node->value;
-            co_return;
-        }
-        ++node;
-    }
-    throw out_of_range("Key not found");
-}
+    Bucket spare(&memory_resource);
+    std::vector<typename Bucket::iterator> nodes;
+    allocate_nodes(keys, values, spare, nodes);
+    const size_t size_before = size;
 
-template<typename K, typename V>
-void HashMap<K, V>::vectorized_get_coroutine(const std::vector<K>& keys, std::vector<V>& results, int group_size) {
-    CircularBuffer<coroutine_handle<promise>> buff(min(group_size,  static_cast<int>(keys.size())));
+    CircularBuffer<coroutine_handle<promise>> buff(min(group_size, static_cast<int>(keys.size())));
 
     int num_finished = 0;
     int i = 0;
 
-    while (num_finished < keys.size())
-    {
-        coroutine_handle<promise>& handle = buff.next_state();
-        if (!handle)
-        {
-            if (i < min(group_size, static_cast<int>(keys.size())))
-            {
-                handle = get_co(keys[i], results, i);
+    while (num_finished < keys.size()) {
+        coroutine_handle<promise> &handle = buff.next_state();
+        if (!handle) {
+            if (i < min(group_size, static_cast<int>(keys.size()))) {
+                handle = insert_co(buckets[i], spare, nodes[i]);
                 i++;
             }
             continue;
@@ -255,7 +420,7 @@ void HashMap<K, V>::vectorized_get_coroutine(const std::vector<K>& keys, std::ve
             num_finished++;
             handle.destroy();
             if (i < keys.size()) {
-                handle = get_co(keys[i], results, i);
+                handle = insert_co(buckets[i], spare, nodes[i]);
                 ++i;
             } else {
                 handle = nullptr;
@@ -265,52 +430,2286 @@ void HashMap<K, V>::vectorized_get_coroutine(const std::vector<K>& keys, std::ve
 
         handle.resume();
     }
+    maintain_batch(size - size_before);
+}
+
+template<typename K, typename V>
+V& HashMap<K, V>::get(const K& key) {
+    for (auto& node : bucket_for(key)) {
+        if (node.key == key) {
+            return node.value;
+        }
+    }
+    throw out_of_range("Key not found");
 }
 
 template <typename K, typename V>
-void HashMap<K, V>::profile_vectorized_get_coroutine_exp(const std::vector<K> &keys, std::vector<V> &results, int group_size)
+std::optional<V> HashMap<K, V>::find(const K &key)
 {
-    CircularBuffer<coroutine_handle<promise>> buff(min(group_size, static_cast<int>(keys.size())));
-
-    int num_finished = 0;
-    int i = 0;
-
+    if (!may_contain(key))
+    {
+        return std::nullopt;
+    }
+    for (auto &node : bucket_for(key))
+    {
+        if (node.key == key)
+        {
+            return node.value;
+        }
+    }
+    return std::nullopt;
+}
+
+template<typename K, typename V>
+void HashMap<K, V>::vectorized_get(const std::vector<K>& keys, std::vector<V>& results, std::vector<bool>& found) {
+    std::vector<Bucket *> buckets(keys.size());
+    hash_batch(keys, buckets);
+    found.assign(keys.size(), false);
+
+    int i = 0;
+    for(auto &key : keys){
+        if (may_contain(key)) {
+            for (auto& node : *buckets[i]) {
+                if (node.key == key) {
+                    results.at(i) = node.value;
+                    found[i] = true;
+                    break;
+                }
+            }
+        }
+        i++;
+    }
+}
+
+template<typename K, typename V>
+void HashMap<K, V>::vectorized_get_reorder(const std::vector<K>& keys, std::vector<V>& results, std::vector<bool>& found, size_t min_region_shift) {
+    std::vector<Bucket *> buckets(keys.size());
+    hash_batch(keys, buckets);
+    found.assign(keys.size(), false);
+
+    // Regions follow the current table, keys still in the old table during a migration are only reordered by it.
+    const size_t shift = BatchReorder::region_shift(capacity * sizeof(Bucket), min_region_shift);
+    std::vector<uint32_t> order;
+    BatchReorder::partition(keys.size(), [&](size_t i) { return (hash_to_bucket(keys[i], capacity) * sizeof(Bucket)) >> shift; }, order);
+
+    for (auto i : order) {
+        if (!may_contain(keys[i])) {
+            continue;
+        }
+        for (auto& node : *buckets[i]) {
+            if (node.key == keys[i]) {
+                results.at(i) = node.value;
+                found[i] = true;
+                break;
+            }
+        }
+    }
+}
+
+template<typename K, typename V>
+void HashMap<K, V>::vectorized_get_rolling(const std::vector<K>& keys, std::vector<V>& results, std::vector<bool>& found, size_t distance) {
+    std::vector<Bucket *> buckets(keys.size());
+    hash_batch(keys, buckets);
+    found.assign(keys.size(), false);
+
+    rolling_prefetch(keys.size(), distance, [&](size_t i) {
+        __builtin_prefetch(buckets[i], 0, 3);
+        prefetch_filter(keys[i]);
+    }, [&](size_t i) {
+        if (!may_contain(keys[i])) {
+            return;
+        }
+        for (auto& node : *buckets[i]) {
+            if (node.key == keys[i]) {
+                results.at(i) = node.value;
+                found[i] = true;
+                return;
+            }
+        }
+    });
+}
+
+template<typename K, typename V>
+void HashMap<K, V>::vectorized_get_gp(const std::vector<K>& keys, std::vector<V>& results, std::vector<bool>& found) {
+    // Vector to keep track of states for each key
+    std::vector<int> states(keys.size(), -1);
+    // states:
+    // -1: Check the filter and get first node
+    //  0: Prefetch next list node
+    //  1: Finished, element found or missing
+
+    std::vector<typename Bucket::iterator> nodes(keys.size());
+
+    std::vector<Bucket *> buckets(keys.size());
+    hash_batch(keys, buckets);
+    found.assign(keys.size(), false);
+
+    for (int i = 0; i < keys.size(); i++) {
+        __builtin_prefetch(buckets[i], 0, 3);
+        prefetch_filter(keys[i]);
+    }
+
+    int finished = 0;
+    while (finished < keys.size()) {
+        for (int i = 0; i < keys.size(); i++) {
+            int& state = states[i];
+            if (state == -1) {
+                nodes[i] = buckets[i]->begin();
+                if (!may_contain(keys[i]) || nodes[i] == buckets[i]->end()) {
+                    state = 1;
+                    ++finished;
+                    continue;
+                }
+                __builtin_prefetch(&(*nodes[i]), 0, 3);
+                state = 0;
+            } else if (state == 0) {
+                auto& node = nodes[i];
+                if (node->key == keys[i]) {
+                    results[i] = node->value;
+                    found[i] = true;
+                    state = 1;
+                    ++finished;
+                    continue;
+                }
+                ++node;
+                if (node != buckets[i]->end()) {
+                    __builtin_prefetch(reinterpret_cast<char *>(&(*node)), 0, 3);
+                } else {
+                    state = 1;
+                    ++finished;
+                }
+            } else {
+                // Finished processing this key
+                continue;
+            }
+        }
+    }
+}
+
+
+
+template<typename K, typename V>
+void HashMap<K, V>::vectorized_get_amac(const std::vector<K>& keys, std::vector<V>& results, std::vector<bool>& found, int group_size) {
+    CircularBuffer<AMAC_state> buff(group_size);
+
+    std::vector<Bucket *> buckets(keys.size());
+    hash_batch(keys, buckets);
+    found.assign(keys.size(), false);
+
+    // Initialize variables
+    int num_finished = 0;
+    int i = 0;
+    int j = 0;
+    while (num_finished < keys.size()) {
+        AMAC_state& state = buff.next_state();
+
+        if (state.stage == 0) {
+            if(i >= keys.size()){
+                continue;
+            }
+            state.i = i;
+            state.key = keys[i];
+            state.bucket = buckets[i];
+            i++;
+            state.stage = 1;
+            __builtin_prefetch(state.bucket, 0, 3);
+            prefetch_filter(state.key);
+        } else if (state.stage == 1) {
+            state.node = state.bucket->begin();
+            state.end = state.bucket->end();
+            if (!may_contain(state.key) || state.node == state.end) {
+                state.stage = 0;
+                num_finished++;
+                continue;
+            }
+            state.stage = 2;
+            __builtin_prefetch(&(*state.node), 0, 3);
+        } else if (state.stage == 2) {
+            if (state.key == state.node->key) {
+                state.stage = 0;
+                results[state.i] = state.node->value;
+                found[state.i] = true;
+                num_finished++;
+            } else {
+                ++state.node;
+                if (state.node == state.end) {
+                    state.stage = 0;
+                    num_finished++;
+                    continue;
+                }
+                __builtin_prefetch(&(*state.node), 0, 3);
+            }
+        }
+    }
+}
+
+
+template<typename K, typename V>
+coroutine HashMap<K, V>::get_co(const K& key, Bucket *bucket, std::vector<V>& results, std::vector<bool>& found, const int i){
+    // prefetch bucket (list head) and filter block
+    __builtin_prefetch(bucket, 0, 3);
+    prefetch_filter(key);
+    co_await std::suspend_always{};
+
+    if (!may_contain(key)) {
+        co_return;
+    }
+
+    auto node = bucket->begin();
+    auto end = bucket->end();
+    while (node != end) {
+        __builtin_prefetch(&(*node), 0, 3);
+        co_await std::suspend_always{};
+        if (node->key == key) {
+            results.at(i) = node->value;
+            found[i] = true;
+            co_return;
+        }
+        ++node;
+    }
+}
+
+template <typename K, typename V>
+coroutine HashMap<K, V>::get_co_exp(const K &key, Bucket *bucket, std::vector<V> &results, std::vector<bool> &found, const int i)
+{
+    // prefetch bucket(list head) and filter block
+    prefetch_filter(key);
+    if (!is_in_tlb_and_prefetch(bucket))
+    {
+        co_await std::suspend_always{};
+    }
+
+    if (!may_contain(key))
+    {
+        co_return;
+    }
+
+    auto node = bucket->begin();
+    auto end = bucket->end();
+    while (node != end)
+    {
+        if (!is_in_tlb_and_prefetch(&(*node)))
+        {
+            co_await std::suspend_always{};
+        }
+        if (node->key == key)
+        {
+            results.at(i) = node->value;
+            found[i] = true;
+            co_return;
+        }
+        ++node;
+    }
+}
+
+template <typename K, typename V>
+coroutine HashMap<K, V>::profile_get_co_exp(const K &key, Bucket *bucket, std::vector<V> &results, std::vector<bool> &found, const int i)
+{
+    size_t prefetch_count = 0;
+    bool assume_cached = true;
+
+    // if (!is_in_tlb_prefetch_profile(bucket, prefetch_count, profiler, assume_cached))
+    //{
+    co_await std::suspend_always{};
+    //}
+
+    if (!may_contain(key))
+    {
+        co_return;
+    }
+
+    auto node = bucket->begin();
+    auto end = bucket->end();
+    while (node != end)
+    {
+        // if (!is_in_tlb_prefetch_profile(&(*node), prefetch_count, profiler, assume_cached))
+        //{
+        co_await std::suspend_always{};
+        //}
+        if (node->key == key)
+        {
+            results.at(i) = node->value;
+            found[i] = true;
+            co_return;
+        }
+        ++node;
+    }
+}
+
+template<typename K, typename V>
+void HashMap<K, V>::vectorized_get_coroutine(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size) {
+    std::vector<Bucket *> buckets(keys.size());
+    hash_batch(keys, buckets);
+    found.assign(keys.size(), false);
+
+    CircularBuffer<coroutine_handle<promise>> buff(min(group_size,  static_cast<int>(keys.size())));
+
+    int num_finished = 0;
+    int i = 0;
+
+    while (num_finished < keys.size())
+    {
+        coroutine_handle<promise>& handle = buff.next_state();
+        if (!handle)
+        {
+            if (i < min(group_size, static_cast<int>(keys.size())))
+            {
+                handle = get_co(keys[i], buckets[i], results, found, i);
+                i++;
+            }
+            continue;
+        }
+
+        if (handle.done()) {
+            num_finished++;
+            handle.destroy();
+            if (i < keys.size()) {
+                handle = get_co(keys[i], buckets[i], results, found, i);
+                ++i;
+            } else {
+                handle = nullptr;
+                continue;
+            }
+        }
+
+        handle.resume();
+    }
+}
+
+template <typename K, typename V>
+void HashMap<K, V>::vectorized_get_payload(const std::vector<K> &keys, const PayloadArena &arena, char *sink, std::vector<bool> &found)
+{
+    static_assert(std::is_convertible_v<V, PayloadArena::Handle>, "Values have to be payload handles.");
+    std::vector<Bucket *> buckets(keys.size());
+    hash_batch(keys, buckets);
+    found.assign(keys.size(), false);
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        if (!may_contain(keys[i]))
+        {
+            continue;
+        }
+        for (auto &node : *buckets[i])
+        {
+            if (node.key == keys[i])
+            {
+                arena.materialize(node.value, sink + i * arena.record_size());
+                found[i] = true;
+                break;
+            }
+        }
+    }
+}
+
+template <typename K, typename V>
+void HashMap<K, V>::vectorized_get_payload_amac(const std::vector<K> &keys, const PayloadArena &arena, char *sink, std::vector<bool> &found, int group_size)
+{
+    static_assert(std::is_convertible_v<V, PayloadArena::Handle>, "Values have to be payload handles.");
+    CircularBuffer<AMAC_state> buff(group_size);
+
+    std::vector<Bucket *> buckets(keys.size());
+    hash_batch(keys, buckets);
+    found.assign(keys.size(), false);
+
+    int num_finished = 0;
+    int i = 0;
+    while (num_finished < keys.size())
+    {
+        AMAC_state &state = buff.next_state();
+
+        if (state.stage == 0)
+        {
+            if (i >= keys.size())
+            {
+                continue;
+            }
+            state.i = i;
+            state.key = keys[i];
+            state.bucket = buckets[i];
+            i++;
+            state.stage = 1;
+            __builtin_prefetch(state.bucket, 0, 3);
+            prefetch_filter(state.key);
+        }
+        else if (state.stage == 1)
+        {
+            state.node = state.bucket->begin();
+            state.end = state.bucket->end();
+            if (!may_contain(state.key) || state.node == state.end)
+            {
+                state.stage = 0;
+                num_finished++;
+                continue;
+            }
+            state.stage = 2;
+            __builtin_prefetch(&(*state.node), 0, 3);
+        }
+        else if (state.stage == 2)
+        {
+            if (state.key == state.node->key)
+            {
+                // Extra stage: fetch all lines of the record before copying it
+                arena.prefetch(state.node->value);
+                state.stage = 3;
+                continue;
+            }
+            ++state.node;
+            if (state.node == state.end)
+            {
+                state.stage = 0;
+                num_finished++;
+                continue;
+            }
+            __builtin_prefetch(&(*state.node), 0, 3);
+        }
+        else if (state.stage == 3)
+        {
+            arena.materialize(state.node->value, sink + state.i * arena.record_size());
+            found[state.i] = true;
+            state.stage = 0;
+            num_finished++;
+        }
+    }
+}
+
+template <typename K, typename V>
+coroutine HashMap<K, V>::get_payload_co(const K &key, Bucket *bucket, const PayloadArena &arena, char *sink, std::vector<bool> &found, const int i)
+{
+    __builtin_prefetch(bucket, 0, 3);
+    prefetch_filter(key);
+    co_await std::suspend_always{};
+
+    if (!may_contain(key))
+    {
+        co_return;
+    }
+
+    auto node = bucket->begin();
+    auto end = bucket->end();
+    while (node != end)
+    {
+        __builtin_prefetch(&(*node), 0, 3);
+        co_await std::suspend_always{};
+        if (node->key == key)
+        {
+            arena.prefetch(node->value);
+            co_await std::suspend_always{};
+
+            arena.materialize(node->value, sink + i * arena.record_size());
+            found[i] = true;
+            co_return;
+        }
+        ++node;
+    }
+}
+
+template <typename K, typename V>
+void HashMap<K, V>::vectorized_get_payload_coroutine(const std::vector<K> &keys, const PayloadArena &arena, char *sink, std::vector<bool> &found, int group_size)
+{
+    static_assert(std::is_convertible_v<V, PayloadArena::Handle>, "Values have to be payload handles.");
+    std::vector<Bucket *> buckets(keys.size());
+    hash_batch(keys, buckets);
+    found.assign(keys.size(), false);
+
+    CircularBuffer<coroutine_handle<promise>> buff(min(group_size, static_cast<int>(keys.size())));
+
+    int num_finished = 0;
+    int i = 0;
+
+    while (num_finished < keys.size())
+    {
+        coroutine_handle<promise> &handle = buff.next_state();
+        if (!handle)
+        {
+            if (i < min(group_size, static_cast<int>(keys.size())))
+            {
+                handle = get_payload_co(keys[i], buckets[i], arena, sink, found, i);
+                i++;
+            }
+            continue;
+        }
+
+        if (handle.done())
+        {
+            num_finished++;
+            handle.destroy();
+            if (i < keys.size())
+            {
+                handle = get_payload_co(keys[i], buckets[i], arena, sink, found, i);
+                ++i;
+            }
+            else
+            {
+                handle = nullptr;
+                continue;
+            }
+        }
+
+        handle.resume();
+    }
+}
+
+template <typename K, typename V>
+void HashMap<K, V>::vectorized_get_payload_rolling(const std::vector<K> &keys, const PayloadArena &arena, char *sink, std::vector<bool> &found, size_t distance)
+{
+    static_assert(std::is_convertible_v<V, PayloadArena::Handle>, "Values have to be payload handles.");
+    std::vector<Bucket *> buckets(keys.size());
+    hash_batch(keys, buckets);
+    found.assign(keys.size(), false);
+
+    std::vector<uint32_t> hits;
+    std::vector<PayloadArena::Handle> handles;
+    hits.reserve(keys.size());
+    handles.reserve(keys.size());
+    rolling_prefetch(
+        keys.size(), distance, [&](size_t i)
+        {
+            __builtin_prefetch(buckets[i], 0, 3);
+            prefetch_filter(keys[i]); },
+        [&](size_t i)
+        {
+            if (!may_contain(keys[i]))
+            {
+                return;
+            }
+            for (auto &node : *buckets[i])
+            {
+                if (node.key == keys[i])
+                {
+                    hits.push_back(i);
+                    handles.push_back(node.value);
+                    found[i] = true;
+                    return;
+                }
+            }
+        });
+
+    rolling_prefetch(
+        hits.size(), distance, [&](size_t h)
+        { arena.prefetch(handles[h]); },
+        [&](size_t h)
+        { arena.materialize(handles[h], sink + hits[h] * arena.record_size()); });
+}
+
+template <typename K, typename V>
+void HashMap<K, V>::profile_vectorized_get_coroutine_exp(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size)
+{
+    std::vector<Bucket *> buckets(keys.size());
+    hash_batch(keys, buckets);
+    found.assign(keys.size(), false);
+
+    CircularBuffer<coroutine_handle<promise>> buff(min(group_size, static_cast<int>(keys.size())));
+
+    int num_finished = 0;
+    int i = 0;
+
+    while (num_finished < keys.size())
+    {
+        coroutine_handle<promise> &handle = buff.next_state();
+        if (!handle)
+        {
+            if (i < min(group_size, static_cast<int>(keys.size())))
+            {
+                handle = profile_get_co_exp(keys[i], buckets[i], results, found, i);
+                i++;
+            }
+            continue;
+        }
+
+        if (handle.done())
+        {
+            num_finished++;
+            handle.destroy();
+            if (i < keys.size())
+            {
+                handle = profile_get_co_exp(keys[i], buckets[i], results, found, i);
+                ++i;
+            }
+            else
+            {
+                handle = nullptr;
+                continue;
+            }
+        }
+
+        handle.resume();
+    }
+}
+
+template <typename K, typename V>
+void HashMap<K, V>::vectorized_get_coroutine_exp(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size)
+{
+    std::vector<Bucket *> buckets(keys.size());
+    hash_batch(keys, buckets);
+    found.assign(keys.size(), false);
+
+    CircularBuffer<coroutine_handle<promise>> buff(min(group_size, static_cast<int>(keys.size())));
+
+    int num_finished = 0;
+    int i = 0;
+
+    while (num_finished < keys.size())
+    {
+        coroutine_handle<promise> &handle = buff.next_state();
+        if (!handle)
+        {
+            if (i < min(group_size, static_cast<int>(keys.size())))
+            {
+                handle = get_co_exp(keys[i], buckets[i], results, found, i);
+                i++;
+            }
+            continue;
+        }
+
+        if (handle.done())
+        {
+            num_finished++;
+            handle.destroy();
+            if (i < keys.size())
+            {
+                handle = get_co_exp(keys[i], buckets[i], results, found, i);
+                ++i;
+            }
+            else
+            {
+                handle = nullptr;
+                continue;
+            }
+        }
+
+        handle.resume();
+    }
+}
+
+template<typename K, typename V>
+void HashMap<K, V>::remove(const K& key) {
+    auto &bucket = bucket_for(key);
+    for (auto it = bucket.begin(); it != bucket.end(); ++it) {
+        if ((*it).key == key) {
+            bucket.erase(it);
+            size--;
+            maintain();
+            return;
+        }
+    }
+    throw out_of_range("Key not found");
+}
+
+template<typename K, typename V>
+bool HashMap<K, V>::contains(const K& key) {
+
+    for (auto& node : bucket_for(key)) {
+        if (node.key == key) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename K, typename V>
+size_t HashMap<K, V>::getSize() const {
+    return size;
+}
+
+template<typename K, typename V>
+bool HashMap<K, V>::isEmpty() const {
+    return size == 0;
+}
+
+
+template <typename K, typename V>
+FrozenHashMap<K, V> HashMap<K, V>::freeze(NodeID node, bool use_explicit_huge_pages, bool madvise_huge_pages)
+{
+    return FrozenHashMap<K, V>(*this, node, use_explicit_huge_pages, madvise_huge_pages);
+}
+
+template class HashMap<unsigned int, unsigned int>;
+
+template <typename K, typename V>
+FrozenHashMap<K, V>::FrozenHashMap(HashMap<K, V> &map, NodeID node, bool use_explicit_huge_pages, bool madvise_huge_pages) : memory_resource(std::make_unique<StaticNumaMemoryResource>(node, use_explicit_huge_pages, madvise_huge_pages)), buckets(memory_resource.get()), overflow_keys(memory_resource.get()), overflow_values(memory_resource.get()), size(map.size), profiler(map.profiler)
+{
+    ensure(size <= std::numeric_limits<uint32_t>::max(), "Too many entries for 32 bit overflow offsets.");
+    buckets.resize(std::max<size_t>(1, size));
+
+    // Unmigrated entries of a growing map are still in its old table.
+    auto for_each_node = [&](auto &&func)
+    {
+        for (auto *table : {&map.table, &map.old_table})
+        {
+            for (auto &bucket : *table)
+            {
+                for (auto &node : bucket)
+                {
+                    func(node);
+                }
+            }
+        }
+    };
+
+    // Pass 1: count the entries per bucket and lay out the overflow ranges
+    for_each_node([&](auto &node)
+                  { buckets[bucket_index(node.key)].size++; });
+    uint32_t offset = 0;
+    for (auto &bucket : buckets)
+    {
+        bucket.offset = offset;
+        offset += std::max<uint32_t>(bucket.size, 1) - 1;
+    }
+    overflow_keys.resize(offset);
+    overflow_values.resize(offset);
+
+    // Pass 2: place the entries
+    std::vector<uint32_t> filled(buckets.size(), 0);
+    for_each_node([&](auto &node)
+                  {
+        const size_t index = bucket_index(node.key);
+        auto &bucket = buckets[index];
+        if (filled[index] == 0)
+        {
+            bucket.key = node.key;
+            bucket.value = node.value;
+        }
+        else
+        {
+            overflow_keys[bucket.offset + filled[index] - 1] = node.key;
+            overflow_values[bucket.offset + filled[index] - 1] = node.value;
+        }
+        filled[index]++; });
+}
+
+template <typename K, typename V>
+FrozenHashMap<K, V>::~FrozenHashMap() {}
+
+template <typename K, typename V>
+size_t FrozenHashMap<K, V>::bucket_index(const K &key) const
+{
+    return HashMap<K, V>::hash_to_bucket(key, buckets.size());
+}
+
+template <typename K, typename V>
+void FrozenHashMap<K, V>::hash_batch(const std::vector<K> &keys, std::vector<const Bucket *> &key_buckets) const
+{
+    const uint64_t num_buckets = buckets.size();
+    const size_t num_keys = keys.size();
+    const K *__restrict in = keys.data();
+    const Bucket *base = buckets.data();
+    const Bucket **__restrict out = key_buckets.data();
+    for (size_t i = 0; i < num_keys; ++i)
+    {
+        out[i] = base + HashMap<K, V>::hash_to_bucket(in[i], num_buckets);
+    }
+}
+
+template <typename K, typename V>
+bool FrozenHashMap<K, V>::probe_inline(const Bucket &bucket, const K &key, V &value, bool &found)
+{
+    if (bucket.size == 0)
+    {
+        found = false;
+        return true;
+    }
+    if (bucket.key == key)
+    {
+        value = bucket.value;
+        found = true;
+        return true;
+    }
+    found = false;
+    return bucket.size == 1;
+}
+
+template <typename K, typename V>
+bool FrozenHashMap<K, V>::probe_overflow(const Bucket &bucket, const K &key, V &value) const
+{
+    const uint32_t end = bucket.offset + bucket.size - 1;
+    for (uint32_t entry = bucket.offset; entry < end; ++entry)
+    {
+        if (overflow_keys[entry] == key)
+        {
+            value = overflow_values[entry];
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename K, typename V>
+void FrozenHashMap<K, V>::prefetch_overflow(const Bucket &bucket) const
+{
+    __builtin_prefetch(&overflow_keys[bucket.offset], 0, 3);
+    __builtin_prefetch(&overflow_values[bucket.offset], 0, 3);
+}
+
+template <typename K, typename V>
+V FrozenHashMap<K, V>::get(const K &key) const
+{
+    auto value = find(key);
+    if (!value)
+    {
+        throw out_of_range("Key not found");
+    }
+    return *value;
+}
+
+template <typename K, typename V>
+std::optional<V> FrozenHashMap<K, V>::find(const K &key) const
+{
+    const Bucket &bucket = buckets[bucket_index(key)];
+    V value;
+    bool found;
+    if (!probe_inline(bucket, key, value, found))
+    {
+        found = probe_overflow(bucket, key, value);
+    }
+    if (!found)
+    {
+        return std::nullopt;
+    }
+    return value;
+}
+
+template <typename K, typename V>
+void FrozenHashMap<K, V>::vectorized_get(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found)
+{
+    found.assign(keys.size(), false);
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        if (auto value = find(keys[i]))
+        {
+            results.at(i) = *value;
+            found[i] = true;
+        }
+    }
+}
+
+template <typename K, typename V>
+void FrozenHashMap<K, V>::vectorized_get_reorder(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, size_t min_region_shift)
+{
+    std::vector<const Bucket *> key_buckets(keys.size());
+    hash_batch(keys, key_buckets);
+    found.assign(keys.size(), false);
+
+    const size_t shift = BatchReorder::region_shift(buckets.size() * sizeof(Bucket), min_region_shift);
+    std::vector<uint32_t> order;
+    BatchReorder::partition(keys.size(), [&](size_t i)
+                            { return ((key_buckets[i] - buckets.data()) * sizeof(Bucket)) >> shift; }, order);
+
+    for (auto i : order)
+    {
+        V value;
+        bool hit;
+        if (!probe_inline(*key_buckets[i], keys[i], value, hit))
+        {
+            hit = probe_overflow(*key_buckets[i], keys[i], value);
+        }
+        if (hit)
+        {
+            results.at(i) = value;
+            found[i] = true;
+        }
+    }
+}
+
+template <typename K, typename V>
+void FrozenHashMap<K, V>::vectorized_get_rolling(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, size_t distance)
+{
+    std::vector<const Bucket *> key_buckets(keys.size());
+    hash_batch(keys, key_buckets);
+    found.assign(keys.size(), false);
+
+    rolling_prefetch(
+        keys.size(), distance, [&](size_t i)
+        { __builtin_prefetch(key_buckets[i], 0, 3); },
+        [&](size_t i)
+        {
+            V value;
+            bool hit;
+            if (!probe_inline(*key_buckets[i], keys[i], value, hit))
+            {
+                hit = probe_overflow(*key_buckets[i], keys[i], value);
+            }
+            if (hit)
+            {
+                results.at(i) = value;
+                found[i] = true;
+            }
+        });
+}
+
+template <typename K, typename V>
+void FrozenHashMap<K, V>::vectorized_get_gp(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found)
+{
+    std::vector<const Bucket *> key_buckets(keys.size());
+    hash_batch(keys, key_buckets);
+    found.assign(keys.size(), false);
+
+    // Stage 1: prefetch the buckets of all keys
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        __builtin_prefetch(key_buckets[i], 0, 3);
+    }
+
+    // Stage 2: check the inlined entries, prefetch the overflow entries of undecided lookups
+    std::vector<uint32_t> pending;
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        bool hit;
+        if (probe_inline(*key_buckets[i], keys[i], results[i], hit))
+        {
+            found[i] = hit;
+        }
+        else
+        {
+            prefetch_overflow(*key_buckets[i]);
+            pending.push_back(i);
+        }
+    }
+
+    // Stage 3: scan the overflow entries
+    for (const uint32_t i : pending)
+    {
+        found[i] = probe_overflow(*key_buckets[i], keys[i], results[i]);
+    }
+}
+
+template <typename K, typename V>
+void FrozenHashMap<K, V>::vectorized_get_amac(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size)
+{
+    CircularBuffer<AMAC_state> buff(group_size);
+
+    std::vector<const Bucket *> key_buckets(keys.size());
+    hash_batch(keys, key_buckets);
+    found.assign(keys.size(), false);
+
+    int num_finished = 0;
+    int i = 0;
+    while (num_finished < keys.size())
+    {
+        AMAC_state &state = buff.next_state();
+
+        if (state.stage == 0)
+        {
+            if (i >= keys.size())
+            {
+                continue;
+            }
+            state.i = i;
+            state.key = keys[i];
+            state.bucket = key_buckets[i];
+            i++;
+            state.stage = 1;
+            __builtin_prefetch(state.bucket, 0, 3);
+        }
+        else if (state.stage == 1)
+        {
+            bool hit;
+            if (probe_inline(*state.bucket, state.key, results[state.i], hit))
+            {
+                found[state.i] = hit;
+                state.stage = 0;
+                num_finished++;
+                continue;
+            }
+            state.stage = 2;
+            prefetch_overflow(*state.bucket);
+        }
+        else if (state.stage == 2)
+        {
+            found[state.i] = probe_overflow(*state.bucket, state.key, results[state.i]);
+            state.stage = 0;
+            num_finished++;
+        }
+    }
+}
+
+template <typename K, typename V>
+coroutine FrozenHashMap<K, V>::get_co(const K &key, const Bucket *bucket, std::vector<V> &results, std::vector<bool> &found, const int i)
+{
+    __builtin_prefetch(bucket, 0, 3);
+    co_await std::suspend_always{};
+
+    V value;
+    bool hit;
+    if (!probe_inline(*bucket, key, value, hit))
+    {
+        prefetch_overflow(*bucket);
+        co_await std::suspend_always{};
+        hit = probe_overflow(*bucket, key, value);
+    }
+    if (hit)
+    {
+        results.at(i) = value;
+        found[i] = true;
+    }
+}
+
+template <typename K, typename V>
+void FrozenHashMap<K, V>::vectorized_get_coroutine(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size)
+{
+    std::vector<const Bucket *> key_buckets(keys.size());
+    hash_batch(keys, key_buckets);
+    found.assign(keys.size(), false);
+
+    CircularBuffer<coroutine_handle<promise>> buff(min(group_size, static_cast<int>(keys.size())));
+
+    int num_finished = 0;
+    int i = 0;
+
+    while (num_finished < keys.size())
+    {
+        coroutine_handle<promise> &handle = buff.next_state();
+        if (!handle)
+        {
+            if (i < min(group_size, static_cast<int>(keys.size())))
+            {
+                handle = get_co(keys[i], key_buckets[i], results, found, i);
+                i++;
+            }
+            continue;
+        }
+
+        if (handle.done())
+        {
+            num_finished++;
+            handle.destroy();
+            if (i < keys.size())
+            {
+                handle = get_co(keys[i], key_buckets[i], results, found, i);
+                ++i;
+            }
+            else
+            {
+                handle = nullptr;
+                continue;
+            }
+        }
+
+        handle.resume();
+    }
+}
+
+template <typename K, typename V>
+bool FrozenHashMap<K, V>::contains(const K &key) const
+{
+    return find(key).has_value();
+}
+
+template <typename K, typename V>
+size_t FrozenHashMap<K, V>::getSize() const
+{
+    return size;
+}
+
+template <typename K, typename V>
+bool FrozenHashMap<K, V>::isEmpty() const
+{
+    return size == 0;
+}
+
+template <typename K, typename V>
+size_t FrozenHashMap<K, V>::memory_usage() const
+{
+    return buckets.size() * sizeof(Bucket) + overflow_keys.size() * sizeof(K) + overflow_values.size() * sizeof(V);
+}
+
+template class FrozenHashMap<unsigned int, unsigned int>;
+
+// Bitmask of the slots whose tag equals tag. Reads 16 bytes (8 on AArch64) starting at tags.
+template <size_t slots>
+uint32_t match_tags(const uint8_t *tags, uint8_t tag)
+{
+#if defined(X86_64)
+    static_assert(slots <= 16);
+    const __m128i bucket_tags = _mm_loadu_si128(reinterpret_cast<const __m128i *>(tags));
+    const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bucket_tags, _mm_set1_epi8(static_cast<char>(tag)))));
+#elif defined(AARCH64)
+    static_assert(slots <= 8);
+    const uint8x8_t equal = vceq_u8(vld1_u8(tags), vdup_n_u8(tag));
+    // Collapse the 0x00/0xFF lanes into one bit per lane.
+    const uint64_t lanes = vget_lane_u64(vreinterpret_u64_u8(equal), 0) & 0x8080808080808080ULL;
+    const uint32_t mask = static_cast<uint32_t>((lanes * 0x0002040810204081ULL) >> 56);
+#else
+    uint32_t mask = 0;
+    for (size_t slot = 0; slot < slots; ++slot)
+    {
+        mask |= static_cast<uint32_t>(tags[slot] == tag) << slot;
+    }
+#endif
+    return mask & ((1U << slots) - 1);
+}
+
+// Hashing and probing shared by the maps on tagged buckets (BucketizedHashMap, CuckooHashMap, ConcurrentHashMap).
+
+// Fibonacci hashing, the identity std::hash would leave the tag bits of small keys constant.
+template <typename K>
+uint64_t fibonacci_hash(const K &key)
+{
+    return static_cast<uint64_t>(std::hash<K>{}(key)) * 0x9E3779B97F4A7C15ULL;
+}
+
+template <typename K>
+void fibonacci_hash_batch(const std::vector<K> &keys, std::vector<uint64_t> &hashes)
+{
+    // Separate pass without dependencies between the iterations, so the compiler can vectorize it.
+    const size_t num_keys = keys.size();
+    const K *__restrict in = keys.data();
+    uint64_t *__restrict out = hashes.data();
+    for (size_t i = 0; i < num_keys; ++i)
+    {
+        out[i] = fibonacci_hash(in[i]);
+    }
+}
+
+// Fast range reduction of the upper 32 bits onto [0, num_buckets).
+inline size_t bucket_index(uint64_t hash, size_t num_buckets)
+{
+    return static_cast<size_t>(((hash >> 32) * num_buckets) >> 32);
+}
+
+inline uint8_t hash_tag(uint64_t hash)
+{
+    // The low bits of a multiplicative hash only depend on the low bits of the key, so keys that are equal modulo 128
+    // would share a tag. Bits 25 to 31 are well mixed and not used by bucket_index. The high bit distinguishes used
+    // slots from empty and deleted ones.
+    return static_cast<uint8_t>(0x80 | ((hash >> 25) & 0x7F));
+}
+
+// Slot of key in bucket, or -1. Only slots whose tag matches are compared.
+template <typename Bucket, typename K>
+int find_tagged_slot(const Bucket &bucket, const K &key, uint8_t tag)
+{
+    for (uint32_t candidates = bucket.match(tag); candidates != 0; candidates &= candidates - 1)
+    {
+        const int slot = __builtin_ctz(candidates);
+        if (bucket.keys[slot] == key)
+        {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+inline size_t next_bucket(size_t index, size_t num_buckets)
+{
+    return (index + 1 == num_buckets) ? 0 : index + 1;
+}
+
+template <typename K, typename V>
+uint32_t TaggedBucket<K, V>::match(uint8_t tag) const
+{
+    return match_tags<slots>(tags, tag);
+}
+
+template <typename K, typename V>
+BucketizedHashMap<K, V>::BucketizedHashMap(size_t capacity, PrefetchProfiler &profiler, std::pmr::memory_resource &memory_resource) : table(&memory_resource), size(0), memory_resource(memory_resource), profiler(profiler)
+{
+    static_assert(sizeof(Bucket) == 64, "A bucket has to fill exactly one cache line.");
+    num_buckets = std::max<size_t>(1, static_cast<size_t>(std::ceil(capacity / (Bucket::slots * max_load_factor))));
+    ensure(num_buckets <= std::numeric_limits<uint32_t>::max(), "Too many buckets for the fast range reduction.");
+    table.resize(num_buckets);
+    for (auto &bucket : table)
+    {
+        std::fill(std::begin(bucket.tags), std::end(bucket.tags), Bucket::empty_tag);
+    }
+}
+
+template <typename K, typename V>
+BucketizedHashMap<K, V>::~BucketizedHashMap() {}
+
+template <typename K, typename V>
+void BucketizedHashMap<K, V>::insert(const K &key, const V &value)
+{
+    const uint64_t h = fibonacci_hash(key);
+    const uint8_t t = hash_tag(h);
+    size_t index = bucket_index(h, num_buckets);
+
+    Bucket *free_bucket = nullptr;
+    int free_slot = 0;
+    for (size_t probes = 0; probes < num_buckets; ++probes)
+    {
+        Bucket &bucket = table[index];
+        const int slot = find_tagged_slot(bucket, key, t);
+        if (slot >= 0)
+        {
+            bucket.values[slot] = value;
+            return;
+        }
+
+        const uint32_t empty = bucket.match(Bucket::empty_tag);
+        const uint32_t free = empty | bucket.match(Bucket::deleted_tag);
+        if (free_bucket == nullptr && free != 0)
+        {
+            free_bucket = &bucket;
+            free_slot = __builtin_ctz(free);
+        }
+        if (empty != 0)
+        {
+            break;
+        }
+        index = next_bucket(index, num_buckets);
+    }
+
+    if (free_bucket == nullptr)
+    {
+        throw length_error("BucketizedHashMap is full");
+    }
+    free_bucket->tags[free_slot] = t;
+    free_bucket->keys[free_slot] = key;
+    free_bucket->values[free_slot] = value;
+    size++;
+}
+
+template <typename K, typename V>
+typename BucketizedHashMap<K, V>::Bucket *BucketizedHashMap<K, V>::find(const K &key, uint64_t key_hash, int &slot)
+{
+    const uint8_t t = hash_tag(key_hash);
+    size_t index = bucket_index(key_hash, num_buckets);
+    for (size_t probes = 0; probes < num_buckets; ++probes)
+    {
+        Bucket &bucket = table[index];
+        slot = find_tagged_slot(bucket, key, t);
+        if (slot >= 0)
+        {
+            return &bucket;
+        }
+        if (bucket.match(Bucket::empty_tag) != 0)
+        {
+            break;
+        }
+        index = next_bucket(index, num_buckets);
+    }
+    return nullptr;
+}
+
+template <typename K, typename V>
+V &BucketizedHashMap<K, V>::get(const K &key)
+{
+    int slot;
+    Bucket *bucket = find(key, fibonacci_hash(key), slot);
+    if (bucket == nullptr)
+    {
+        throw out_of_range("Key not found");
+    }
+    return bucket->values[slot];
+}
+
+template <typename K, typename V>
+std::optional<V> BucketizedHashMap<K, V>::find(const K &key)
+{
+    int slot;
+    Bucket *bucket = find(key, fibonacci_hash(key), slot);
+    if (bucket == nullptr)
+    {
+        return std::nullopt;
+    }
+    return bucket->values[slot];
+}
+
+template <typename K, typename V>
+void BucketizedHashMap<K, V>::vectorized_get(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found)
+{
+    std::vector<uint64_t> hashes(keys.size());
+    fibonacci_hash_batch(keys, hashes);
+    found.assign(keys.size(), false);
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        int slot;
+        const Bucket *bucket = find(keys[i], hashes[i], slot);
+        if (bucket != nullptr)
+        {
+            results.at(i) = bucket->values[slot];
+            found[i] = true;
+        }
+    }
+}
+
+template <typename K, typename V>
+void BucketizedHashMap<K, V>::vectorized_get_reorder(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, size_t min_region_shift)
+{
+    std::vector<uint64_t> hashes(keys.size());
+    fibonacci_hash_batch(keys, hashes);
+    found.assign(keys.size(), false);
+
+    const size_t shift = BatchReorder::region_shift(num_buckets * sizeof(Bucket), min_region_shift);
+    std::vector<uint32_t> order;
+    BatchReorder::partition(keys.size(), [&](size_t i)
+                            { return (bucket_index(hashes[i], num_buckets) * sizeof(Bucket)) >> shift; }, order);
+
+    for (auto i : order)
+    {
+        int slot;
+        const Bucket *bucket = find(keys[i], hashes[i], slot);
+        if (bucket != nullptr)
+        {
+            results.at(i) = bucket->values[slot];
+            found[i] = true;
+        }
+    }
+}
+
+template <typename K, typename V>
+void BucketizedHashMap<K, V>::vectorized_get_gp(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found)
+{
+    std::vector<uint64_t> hashes(keys.size());
+    std::vector<size_t> buckets(keys.size());
+    std::vector<bool> done(keys.size(), false);
+    fibonacci_hash_batch(keys, hashes);
+    found.assign(keys.size(), false);
+
+    // Stage 1: prefetch the home buckets of all keys
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        buckets[i] = bucket_index(hashes[i], num_buckets);
+        __builtin_prefetch(&table[buckets[i]], 0, 3);
+    }
+
+    // Stage 2: probe the buckets, overflowing lookups prefetch their next bucket for the next round
+    size_t finished = 0;
+    for (size_t round = 0; finished < keys.size(); ++round)
+    {
+        // Every remaining lookup has probed the whole table
+        const bool exhausted = (round + 1 == num_buckets);
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            if (done[i])
+            {
+                continue;
+            }
+            const Bucket &bucket = table[buckets[i]];
+            const int slot = find_tagged_slot(bucket, keys[i], hash_tag(hashes[i]));
+            if (slot >= 0)
+            {
+                results[i] = bucket.values[slot];
+                found[i] = true;
+                done[i] = true;
+                ++finished;
+            }
+            else if (bucket.match(Bucket::empty_tag) != 0 || exhausted)
+            {
+                done[i] = true;
+                ++finished;
+            }
+            else
+            {
+                buckets[i] = next_bucket(buckets[i], num_buckets);
+                __builtin_prefetch(&table[buckets[i]], 0, 3);
+            }
+        }
+    }
+}
+
+template <typename K, typename V>
+void BucketizedHashMap<K, V>::vectorized_get_amac(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size)
+{
+    CircularBuffer<AMAC_state> buff(group_size);
+
+    std::vector<uint64_t> hashes(keys.size());
+    fibonacci_hash_batch(keys, hashes);
+    found.assign(keys.size(), false);
+
+    int num_finished = 0;
+    int i = 0;
+    while (num_finished < keys.size())
+    {
+        AMAC_state &state = buff.next_state();
+
+        if (state.stage == 0)
+        {
+            if (i >= keys.size())
+            {
+                continue;
+            }
+            state.i = i;
+            state.key = keys[i];
+            state.tag = hash_tag(hashes[i]);
+            state.bucket = bucket_index(hashes[i], num_buckets);
+            i++;
+            state.probes = 0;
+            state.stage = 1;
+            __builtin_prefetch(&table[state.bucket], 0, 3);
+        }
+        else if (state.stage == 1)
+        {
+            const Bucket &bucket = table[state.bucket];
+            const int slot = find_tagged_slot(bucket, state.key, state.tag);
+            if (slot >= 0)
+            {
+                state.stage = 0;
+                results[state.i] = bucket.values[slot];
+                found[state.i] = true;
+                num_finished++;
+            }
+            else
+            {
+                if (bucket.match(Bucket::empty_tag) != 0 || ++state.probes == num_buckets)
+                {
+                    state.stage = 0;
+                    num_finished++;
+                    continue;
+                }
+                state.bucket = next_bucket(state.bucket, num_buckets);
+                __builtin_prefetch(&table[state.bucket], 0, 3);
+            }
+        }
+    }
+}
+
+template <typename K, typename V>
+coroutine BucketizedHashMap<K, V>::get_co(const K &key, const uint64_t key_hash, std::vector<V> &results, std::vector<bool> &found, const int i)
+{
+    const uint8_t t = hash_tag(key_hash);
+    size_t index = bucket_index(key_hash, num_buckets);
+    for (size_t probes = 0; probes < num_buckets; ++probes)
+    {
+        __builtin_prefetch(&table[index], 0, 3);
+        co_await std::suspend_always{};
+
+        const Bucket &bucket = table[index];
+        const int slot = find_tagged_slot(bucket, key, t);
+        if (slot >= 0)
+        {
+            results.at(i) = bucket.values[slot];
+            found[i] = true;
+            co_return;
+        }
+        if (bucket.match(Bucket::empty_tag) != 0)
+        {
+            co_return;
+        }
+        index = next_bucket(index, num_buckets);
+    }
+}
+
+template <typename K, typename V>
+void BucketizedHashMap<K, V>::vectorized_get_coroutine(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size)
+{
+    std::vector<uint64_t> hashes(keys.size());
+    fibonacci_hash_batch(keys, hashes);
+    found.assign(keys.size(), false);
+
+    CircularBuffer<coroutine_handle<promise>> buff(min(group_size, static_cast<int>(keys.size())));
+
+    int num_finished = 0;
+    int i = 0;
+
+    while (num_finished < keys.size())
+    {
+        coroutine_handle<promise> &handle = buff.next_state();
+        if (!handle)
+        {
+            if (i < min(group_size, static_cast<int>(keys.size())))
+            {
+                handle = get_co(keys[i], hashes[i], results, found, i);
+                i++;
+            }
+            continue;
+        }
+
+        if (handle.done())
+        {
+            num_finished++;
+            handle.destroy();
+            if (i < keys.size())
+            {
+                handle = get_co(keys[i], hashes[i], results, found, i);
+                ++i;
+            }
+            else
+            {
+                handle = nullptr;
+                continue;
+            }
+        }
+
+        handle.resume();
+    }
+}
+
+template <typename K, typename V>
+void BucketizedHashMap<K, V>::remove(const K &key)
+{
+    const uint64_t h = fibonacci_hash(key);
+    const uint8_t t = hash_tag(h);
+    size_t index = bucket_index(h, num_buckets);
+    for (size_t probes = 0; probes < num_buckets; ++probes)
+    {
+        Bucket &bucket = table[index];
+        const int slot = find_tagged_slot(bucket, key, t);
+        if (slot >= 0)
+        {
+            // Keep the probe sequence intact, the slot is reused by later inserts.
+            bucket.tags[slot] = Bucket::deleted_tag;
+            size--;
+            return;
+        }
+        if (bucket.match(Bucket::empty_tag) != 0)
+        {
+            break;
+        }
+        index = next_bucket(index, num_buckets);
+    }
+    throw out_of_range("Key not found");
+}
+
+template <typename K, typename V>
+bool BucketizedHashMap<K, V>::contains(const K &key)
+{
+    int slot;
+    return find(key, fibonacci_hash(key), slot) != nullptr;
+}
+
+template <typename K, typename V>
+size_t BucketizedHashMap<K, V>::getSize() const
+{
+    return size;
+}
+
+template <typename K, typename V>
+bool BucketizedHashMap<K, V>::isEmpty() const
+{
+    return size == 0;
+}
+
+template class BucketizedHashMap<unsigned int, unsigned int>;
+
+template <typename K, typename V>
+size_t CuckooHashMap<K, V>::second_bucket(uint64_t hash) const
+{
+    // Remix the hash (splitmix64 finalizer step), so that both buckets are independent.
+    const uint64_t remixed = (hash ^ (hash >> 31)) * 0xBF58476D1CE4E5B9ULL;
+    const size_t index = bucket_index(remixed, num_buckets);
+    if (index == bucket_index(hash, num_buckets))
+    {
+        return next_bucket(index, num_buckets);
+    }
+    return index;
+}
+
+template <typename K, typename V>
+bool CuckooHashMap<K, V>::probe(const K &key, uint64_t key_hash, V &value) const
+{
+    const uint8_t t = hash_tag(key_hash);
+    for (const size_t index : {bucket_index(key_hash, num_buckets), second_bucket(key_hash)})
+    {
+        const Bucket &bucket = table[index];
+        const int slot = find_tagged_slot(bucket, key, t);
+        if (slot >= 0)
+        {
+            value = bucket.values[slot];
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename K, typename V>
+void CuckooHashMap<K, V>::prefetch_buckets(uint64_t hash) const
+{
+    __builtin_prefetch(&table[bucket_index(hash, num_buckets)], 0, 3);
+    __builtin_prefetch(&table[second_bucket(hash)], 0, 3);
+}
+
+template <typename K, typename V>
+size_t CuckooHashMap<K, V>::next_kick()
+{
+    // xorshift64, a fixed victim slot could make two buckets evict each other forever
+    kick_state ^= kick_state << 13;
+    kick_state ^= kick_state >> 7;
+    kick_state ^= kick_state << 17;
+    return static_cast<size_t>(kick_state % Bucket::slots);
+}
+
+template <typename K, typename V>
+CuckooHashMap<K, V>::CuckooHashMap(size_t capacity, PrefetchProfiler &profiler, std::pmr::memory_resource &memory_resource) : table(&memory_resource), size(0), memory_resource(memory_resource), profiler(profiler)
+{
+    static_assert(sizeof(Bucket) == 64, "A bucket has to fill exactly one cache line.");
+    // Two buckets are needed for two distinct candidates.
+    num_buckets = std::max<size_t>(2, static_cast<size_t>(std::ceil(capacity / (Bucket::slots * max_load_factor))));
+    ensure(num_buckets <= std::numeric_limits<uint32_t>::max(), "Too many buckets for the fast range reduction.");
+    table.resize(num_buckets);
+    for (auto &bucket : table)
+    {
+        std::fill(std::begin(bucket.tags), std::end(bucket.tags), Bucket::empty_tag);
+    }
+}
+
+template <typename K, typename V>
+CuckooHashMap<K, V>::~CuckooHashMap() {}
+
+template <typename K, typename V>
+void CuckooHashMap<K, V>::insert(const K &key, const V &value)
+{
+    const uint64_t h = fibonacci_hash(key);
+    const uint8_t t = hash_tag(h);
+    const size_t candidates[2] = {bucket_index(h, num_buckets), second_bucket(h)};
+
+    for (const size_t index : candidates)
+    {
+        Bucket &bucket = table[index];
+        const int slot = find_tagged_slot(bucket, key, t);
+        if (slot >= 0)
+        {
+            bucket.values[slot] = value;
+            return;
+        }
+    }
+    for (const size_t index : candidates)
+    {
+        Bucket &bucket = table[index];
+        const uint32_t empty = bucket.match(Bucket::empty_tag);
+        if (empty != 0)
+        {
+            const int slot = __builtin_ctz(empty);
+            bucket.tags[slot] = t;
+            bucket.keys[slot] = key;
+            bucket.values[slot] = value;
+            size++;
+            return;
+        }
+    }
+
+    // Both buckets are full: swap the carried entry into a random slot and move the evicted one to its alternate
+    // bucket until an empty slot turns up.
+    std::vector<std::pair<size_t, size_t>> path;
+    uint8_t carried_tag = t;
+    K carried_key = key;
+    V carried_value = value;
+    size_t index = candidates[kick_state & 1];
+    for (size_t kick = 0; kick < max_kicks; ++kick)
+    {
+        Bucket &bucket = table[index];
+        const size_t slot = next_kick();
+        std::swap(carried_tag, bucket.tags[slot]);
+        std::swap(carried_key, bucket.keys[slot]);
+        std::swap(carried_value, bucket.values[slot]);
+        path.emplace_back(index, slot);
+
+        const uint64_t carried_hash = fibonacci_hash(carried_key);
+        const size_t first = bucket_index(carried_hash, num_buckets);
+        index = (index == first) ? second_bucket(carried_hash) : first;
+
+        Bucket &alternate = table[index];
+        const uint32_t empty = alternate.match(Bucket::empty_tag);
+        if (empty != 0)
+        {
+            const int free_slot = __builtin_ctz(empty);
+            alternate.tags[free_slot] = carried_tag;
+            alternate.keys[free_slot] = carried_key;
+            alternate.values[free_slot] = carried_value;
+            size++;
+            return;
+        }
+    }
+
+    // Undo the displacements, so that the map is unchanged.
+    for (auto step = path.rbegin(); step != path.rend(); ++step)
+    {
+        Bucket &bucket = table[step->first];
+        std::swap(carried_tag, bucket.tags[step->second]);
+        std::swap(carried_key, bucket.keys[step->second]);
+        std::swap(carried_value, bucket.values[step->second]);
+    }
+    throw length_error("CuckooHashMap is full");
+}
+
+template <typename K, typename V>
+V &CuckooHashMap<K, V>::get(const K &key)
+{
+    const uint64_t h = fibonacci_hash(key);
+    const uint8_t t = hash_tag(h);
+    for (const size_t index : {bucket_index(h, num_buckets), second_bucket(h)})
+    {
+        Bucket &bucket = table[index];
+        const int slot = find_tagged_slot(bucket, key, t);
+        if (slot >= 0)
+        {
+            return bucket.values[slot];
+        }
+    }
+    throw out_of_range("Key not found");
+}
+
+template <typename K, typename V>
+std::optional<V> CuckooHashMap<K, V>::find(const K &key)
+{
+    V value;
+    if (!probe(key, fibonacci_hash(key), value))
+    {
+        return std::nullopt;
+    }
+    return value;
+}
+
+template <typename K, typename V>
+void CuckooHashMap<K, V>::vectorized_get(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found)
+{
+    std::vector<uint64_t> hashes(keys.size());
+    fibonacci_hash_batch(keys, hashes);
+    found.assign(keys.size(), false);
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        found[i] = probe(keys[i], hashes[i], results.at(i));
+    }
+}
+
+template <typename K, typename V>
+void CuckooHashMap<K, V>::vectorized_get_gp(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found)
+{
+    std::vector<uint64_t> hashes(keys.size());
+    fibonacci_hash_batch(keys, hashes);
+    found.assign(keys.size(), false);
+
+    // Stage 1: prefetch both candidate buckets of all keys
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        prefetch_buckets(hashes[i]);
+    }
+
+    // Stage 2: probe, no lookup needs a second round
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        found[i] = probe(keys[i], hashes[i], results[i]);
+    }
+}
+
+template <typename K, typename V>
+void CuckooHashMap<K, V>::vectorized_get_amac(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size)
+{
+    CircularBuffer<AMAC_state> buff(group_size);
+
+    std::vector<uint64_t> hashes(keys.size());
+    fibonacci_hash_batch(keys, hashes);
+    found.assign(keys.size(), false);
+
+    int num_finished = 0;
+    int i = 0;
+    while (num_finished < keys.size())
+    {
+        AMAC_state &state = buff.next_state();
+
+        if (state.stage == 0)
+        {
+            if (i >= keys.size())
+            {
+                continue;
+            }
+            state.i = i;
+            state.key = keys[i];
+            state.hash = hashes[i];
+            i++;
+            state.stage = 1;
+            prefetch_buckets(state.hash);
+        }
+        else if (state.stage == 1)
+        {
+            found[state.i] = probe(state.key, state.hash, results[state.i]);
+            state.stage = 0;
+            num_finished++;
+        }
+    }
+}
+
+template <typename K, typename V>
+coroutine CuckooHashMap<K, V>::get_co(const K &key, const uint64_t key_hash, std::vector<V> &results, std::vector<bool> &found, const int i)
+{
+    prefetch_buckets(key_hash);
+    co_await std::suspend_always{};
+
+    V value;
+    if (probe(key, key_hash, value))
+    {
+        results.at(i) = value;
+        found[i] = true;
+    }
+}
+
+template <typename K, typename V>
+void CuckooHashMap<K, V>::vectorized_get_coroutine(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size)
+{
+    std::vector<uint64_t> hashes(keys.size());
+    fibonacci_hash_batch(keys, hashes);
+    found.assign(keys.size(), false);
+
+    CircularBuffer<coroutine_handle<promise>> buff(min(group_size, static_cast<int>(keys.size())));
+
+    int num_finished = 0;
+    int i = 0;
+
     while (num_finished < keys.size())
     {
-        coroutine_handle<promise> &handle = buff.next_state();
-        if (!handle)
+        coroutine_handle<promise> &handle = buff.next_state();
+        if (!handle)
+        {
+            if (i < min(group_size, static_cast<int>(keys.size())))
+            {
+                handle = get_co(keys[i], hashes[i], results, found, i);
+                i++;
+            }
+            continue;
+        }
+
+        if (handle.done())
+        {
+            num_finished++;
+            handle.destroy();
+            if (i < keys.size())
+            {
+                handle = get_co(keys[i], hashes[i], results, found, i);
+                ++i;
+            }
+            else
+            {
+                handle = nullptr;
+                continue;
+            }
+        }
+
+        handle.resume();
+    }
+}
+
+template <typename K, typename V>
+void CuckooHashMap<K, V>::remove(const K &key)
+{
+    const uint64_t h = fibonacci_hash(key);
+    const uint8_t t = hash_tag(h);
+    for (const size_t index : {bucket_index(h, num_buckets), second_bucket(h)})
+    {
+        Bucket &bucket = table[index];
+        const int slot = find_tagged_slot(bucket, key, t);
+        if (slot >= 0)
+        {
+            // No probe sequence to keep intact, the slot is simply empty again.
+            bucket.tags[slot] = Bucket::empty_tag;
+            size--;
+            return;
+        }
+    }
+    throw out_of_range("Key not found");
+}
+
+template <typename K, typename V>
+bool CuckooHashMap<K, V>::contains(const K &key)
+{
+    V value;
+    return probe(key, fibonacci_hash(key), value);
+}
+
+template <typename K, typename V>
+size_t CuckooHashMap<K, V>::getSize() const
+{
+    return size;
+}
+
+template <typename K, typename V>
+bool CuckooHashMap<K, V>::isEmpty() const
+{
+    return size == 0;
+}
+
+template class CuckooHashMap<unsigned int, unsigned int>;
+
+template <typename K, typename V>
+uint32_t VersionedBucket<K, V>::match(uint8_t tag) const
+{
+    return match_tags<slots>(tags, tag);
+}
+
+template <typename K, typename V>
+size_t ConcurrentHashMap<K, V>::buckets_for(size_t capacity)
+{
+    return std::max<size_t>(1, static_cast<size_t>(std::ceil(capacity / (Bucket::slots * max_load_factor))));
+}
+
+template <typename K, typename V>
+typename ConcurrentHashMap<K, V>::ProbeResult ConcurrentHashMap<K, V>::probe(const Bucket &bucket, const K &key, uint8_t tag, V &value)
+{
+    bool needRestart = false;
+    const uint64_t version = bucket.lock.readLockOrRestart(needRestart);
+    if (needRestart)
+    {
+        return ProbeResult::Restart;
+    }
+
+    const int slot = find_tagged_slot(bucket, key, tag);
+    const V candidate = (slot >= 0) ? bucket.values[slot] : V{};
+    const bool has_empty_slot = bucket.match(Bucket::empty_tag) != 0;
+
+    bucket.lock.readUnlockOrRestart(version, needRestart);
+    if (needRestart)
+    {
+        return ProbeResult::Restart;
+    }
+    if (slot >= 0)
+    {
+        value = candidate;
+        return ProbeResult::Found;
+    }
+    return has_empty_slot ? ProbeResult::Miss : ProbeResult::Next;
+}
+
+template <typename K, typename V>
+void ConcurrentHashMap<K, V>::yield(int count)
+{
+    if (count > 3)
+    {
+        sched_yield();
+    }
+    else
+    {
+        wait_cycles(1);
+    }
+}
+
+template <typename K, typename V>
+ConcurrentHashMap<K, V>::ConcurrentHashMap(size_t capacity, PrefetchProfiler &profiler, std::pmr::memory_resource &memory_resource) : num_buckets(buckets_for(capacity)), table(num_buckets, &memory_resource), size(0), memory_resource(memory_resource), profiler(profiler)
+{
+    static_assert(sizeof(Bucket) == 64, "A bucket has to fill exactly one cache line.");
+    ensure(num_buckets <= std::numeric_limits<uint32_t>::max(), "Too many buckets for the fast range reduction.");
+    for (auto &bucket : table)
+    {
+        std::fill(std::begin(bucket.tags), std::end(bucket.tags), Bucket::empty_tag);
+    }
+}
+
+template <typename K, typename V>
+ConcurrentHashMap<K, V>::~ConcurrentHashMap() {}
+
+template <typename K, typename V>
+void ConcurrentHashMap<K, V>::insert(const K &key, const V &value)
+{
+    const uint64_t h = fibonacci_hash(key);
+    const uint8_t t = hash_tag(h);
+    int restartCount = 0;
+restart:
+    if (restartCount++)
+    {
+        yield(restartCount);
+    }
+    bool needRestart = false;
+
+    // The home bucket lock serializes all writers of this key
+    Bucket &home = table[bucket_index(h, num_buckets)];
+    home.lock.writeLockOrRestart(needRestart);
+    if (needRestart)
+        goto restart;
+
+    Bucket *free_bucket = nullptr;
+    int free_slot = 0;
+    uint64_t free_version = 0;
+    size_t index = bucket_index(h, num_buckets);
+    for (size_t probes = 0; probes < num_buckets; ++probes)
+    {
+        Bucket &bucket = table[index];
+        const bool is_home = (&bucket == &home);
+
+        uint64_t version = 0;
+        if (!is_home)
+        {
+            version = bucket.lock.readLockOrRestart(needRestart);
+            if (needRestart)
+            {
+                home.lock.writeUnlock();
+                goto restart;
+            }
+        }
+        const int slot = find_tagged_slot(bucket, key, t);
+        const uint32_t empty = bucket.match(Bucket::empty_tag);
+        const uint32_t free = empty | bucket.match(Bucket::deleted_tag);
+        if (!is_home)
+        {
+            bucket.lock.readUnlockOrRestart(version, needRestart);
+            if (needRestart)
+            {
+                home.lock.writeUnlock();
+                goto restart;
+            }
+        }
+
+        if (slot >= 0)
+        {
+            // Upsert
+            if (!is_home)
+            {
+                bucket.lock.upgradeToWriteLockOrRestart(version, needRestart);
+                if (needRestart)
+                {
+                    home.lock.writeUnlock();
+                    goto restart;
+                }
+            }
+            bucket.values[slot] = value;
+            if (!is_home)
+                bucket.lock.writeUnlock();
+            home.lock.writeUnlock();
+            return;
+        }
+
+        if (free_bucket == nullptr && free != 0)
+        {
+            free_bucket = &bucket;
+            free_slot = __builtin_ctz(free);
+            free_version = version;
+        }
+        if (empty != 0)
+        {
+            break;
+        }
+        index = next_bucket(index, num_buckets);
+    }
+
+    if (free_bucket == nullptr)
+    {
+        home.lock.writeUnlock();
+        throw length_error("ConcurrentHashMap is full");
+    }
+    if (free_bucket != &home)
+    {
+        free_bucket->lock.upgradeToWriteLockOrRestart(free_version, needRestart);
+        if (needRestart)
+        {
+            home.lock.writeUnlock();
+            goto restart;
+        }
+    }
+    free_bucket->keys[free_slot] = key;
+    free_bucket->values[free_slot] = value;
+    free_bucket->tags[free_slot] = t;
+    if (free_bucket != &home)
+        free_bucket->lock.writeUnlock();
+    home.lock.writeUnlock();
+    size++;
+}
+
+template <typename K, typename V>
+bool ConcurrentHashMap<K, V>::find(const K &key, uint64_t key_hash, V &value)
+{
+    const uint8_t t = hash_tag(key_hash);
+    int restartCount = 0;
+restart:
+    if (restartCount++)
+    {
+        yield(restartCount);
+    }
+    size_t index = bucket_index(key_hash, num_buckets);
+    for (size_t probes = 0; probes < num_buckets; ++probes)
+    {
+        switch (probe(table[index], key, t, value))
+        {
+        case ProbeResult::Found:
+            return true;
+        case ProbeResult::Miss:
+            return false;
+        case ProbeResult::Restart:
+            goto restart;
+        case ProbeResult::Next:
+            index = next_bucket(index, num_buckets);
+            break;
+        }
+    }
+    return false;
+}
+
+template <typename K, typename V>
+V ConcurrentHashMap<K, V>::get(const K &key)
+{
+    V value;
+    if (!find(key, fibonacci_hash(key), value))
+    {
+        throw out_of_range("Key not found");
+    }
+    return value;
+}
+
+template <typename K, typename V>
+std::optional<V> ConcurrentHashMap<K, V>::find(const K &key)
+{
+    V value;
+    if (!find(key, fibonacci_hash(key), value))
+    {
+        return std::nullopt;
+    }
+    return value;
+}
+
+template <typename K, typename V>
+void ConcurrentHashMap<K, V>::vectorized_get(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found)
+{
+    std::vector<uint64_t> hashes(keys.size());
+    fibonacci_hash_batch(keys, hashes);
+    found.assign(keys.size(), false);
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        found[i] = find(keys[i], hashes[i], results.at(i));
+    }
+}
+
+template <typename K, typename V>
+void ConcurrentHashMap<K, V>::vectorized_get_gp(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found)
+{
+    std::vector<uint64_t> hashes(keys.size());
+    std::vector<size_t> buckets(keys.size());
+    std::vector<size_t> probes(keys.size(), 0);
+    std::vector<bool> done(keys.size(), false);
+    fibonacci_hash_batch(keys, hashes);
+    found.assign(keys.size(), false);
+
+    // Stage 1: prefetch the home buckets of all keys
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        buckets[i] = bucket_index(hashes[i], num_buckets);
+        __builtin_prefetch(&table[buckets[i]], 0, 3);
+    }
+
+    // Stage 2: probe the buckets; overflowing and restarting lookups prefetch for the next round
+    size_t finished = 0;
+    while (finished < keys.size())
+    {
+        for (size_t i = 0; i < keys.size(); ++i)
         {
-            if (i < min(group_size, static_cast<int>(keys.size())))
+            if (done[i])
             {
-                handle = profile_get_co_exp(keys[i], results, i);
-                i++;
+                continue;
             }
-            continue;
+            switch (probe(table[buckets[i]], keys[i], hash_tag(hashes[i]), results[i]))
+            {
+            case ProbeResult::Found:
+                found[i] = true;
+                done[i] = true;
+                ++finished;
+                continue;
+            case ProbeResult::Miss:
+                done[i] = true;
+                ++finished;
+                continue;
+            case ProbeResult::Restart:
+                buckets[i] = bucket_index(hashes[i], num_buckets);
+                probes[i] = 0;
+                break;
+            case ProbeResult::Next:
+                if (++probes[i] == num_buckets)
+                {
+                    done[i] = true;
+                    ++finished;
+                    continue;
+                }
+                buckets[i] = next_bucket(buckets[i], num_buckets);
+                break;
+            }
+            __builtin_prefetch(&table[buckets[i]], 0, 3);
         }
+    }
+}
 
-        if (handle.done())
+template <typename K, typename V>
+void ConcurrentHashMap<K, V>::vectorized_get_amac(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size)
+{
+    CircularBuffer<AMAC_state> buff(group_size);
+
+    std::vector<uint64_t> hashes(keys.size());
+    fibonacci_hash_batch(keys, hashes);
+    found.assign(keys.size(), false);
+
+    int num_finished = 0;
+    int i = 0;
+    while (num_finished < keys.size())
+    {
+        AMAC_state &state = buff.next_state();
+
+        if (state.stage == 0)
         {
-            num_finished++;
-            handle.destroy();
-            if (i < keys.size())
+            if (i >= keys.size())
             {
-                handle = profile_get_co_exp(keys[i], results, i);
-                ++i;
+                continue;
             }
-            else
+            state.i = i;
+            state.key = keys[i];
+            state.hash = hashes[i];
+            state.bucket = bucket_index(state.hash, num_buckets);
+            state.probes = 0;
+            state.stage = 1;
+            i++;
+            __builtin_prefetch(&table[state.bucket], 0, 3);
+        }
+        else if (state.stage == 1)
+        {
+            switch (probe(table[state.bucket], state.key, hash_tag(state.hash), results[state.i]))
             {
-                handle = nullptr;
-                continue;
+            case ProbeResult::Found:
+                found[state.i] = true;
+                state.stage = 0;
+                num_finished++;
+                break;
+            case ProbeResult::Miss:
+                state.stage = 0;
+                num_finished++;
+                break;
+            case ProbeResult::Restart:
+                state.bucket = bucket_index(state.hash, num_buckets);
+                state.probes = 0;
+                __builtin_prefetch(&table[state.bucket], 0, 3);
+                break;
+            case ProbeResult::Next:
+                if (++state.probes == num_buckets)
+                {
+                    state.stage = 0;
+                    num_finished++;
+                    break;
+                }
+                state.bucket = next_bucket(state.bucket, num_buckets);
+                __builtin_prefetch(&table[state.bucket], 0, 3);
+                break;
             }
         }
+    }
+}
 
-        handle.resume();
+template <typename K, typename V>
+coroutine ConcurrentHashMap<K, V>::get_co(const K &key, const uint64_t key_hash, std::vector<V> &results, std::vector<bool> &found, const int i)
+{
+    const uint8_t t = hash_tag(key_hash);
+    int restartCount = 0;
+restart:
+    if (restartCount++)
+    {
+        yield(restartCount);
+    }
+    size_t index = bucket_index(key_hash, num_buckets);
+    for (size_t probes = 0; probes < num_buckets; ++probes)
+    {
+        __builtin_prefetch(&table[index], 0, 3);
+        co_await std::suspend_always{};
+
+        // Validated after the suspension, writers may have run in between
+        V value;
+        switch (probe(table[index], key, t, value))
+        {
+        case ProbeResult::Found:
+            results.at(i) = value;
+            found[i] = true;
+            co_return;
+        case ProbeResult::Miss:
+            co_return;
+        case ProbeResult::Restart:
+            goto restart;
+        case ProbeResult::Next:
+            index = next_bucket(index, num_buckets);
+            break;
+        }
     }
 }
 
 template <typename K, typename V>
-void HashMap<K, V>::vectorized_get_coroutine_exp(const std::vector<K> &keys, std::vector<V> &results, int group_size)
+void ConcurrentHashMap<K, V>::vectorized_get_coroutine(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size)
 {
+    std::vector<uint64_t> hashes(keys.size());
+    fibonacci_hash_batch(keys, hashes);
+    found.assign(keys.size(), false);
+
     CircularBuffer<coroutine_handle<promise>> buff(min(group_size, static_cast<int>(keys.size())));
 
     int num_finished = 0;
@@ -323,7 +2722,7 @@ void HashMap<K, V>::vectorized_get_coroutine_exp(const std::vector<K> &keys, std
         {
             if (i < min(group_size, static_cast<int>(keys.size())))
             {
-                handle = get_co_exp(keys[i], results, i);
+                handle = get_co(keys[i], hashes[i], results, found, i);
                 i++;
             }
             continue;
@@ -335,7 +2734,7 @@ void HashMap<K, V>::vectorized_get_coroutine_exp(const std::vector<K> &keys, std
             handle.destroy();
             if (i < keys.size())
             {
-                handle = get_co_exp(keys[i], results, i);
+                handle = get_co(keys[i], hashes[i], results, found, i);
                 ++i;
             }
             else
@@ -349,40 +2748,358 @@ void HashMap<K, V>::vectorized_get_coroutine_exp(const std::vector<K> &keys, std
     }
 }
 
-template<typename K, typename V>
-void HashMap<K, V>::remove(const K& key) {
-    size_t index = hash(key);
-    for (auto it = table[index].begin(); it != table[index].end(); ++it) {
-        if ((*it).key == key) {
-            table[index].erase(it);
+template <typename K, typename V>
+void ConcurrentHashMap<K, V>::remove(const K &key)
+{
+    const uint64_t h = fibonacci_hash(key);
+    const uint8_t t = hash_tag(h);
+    int restartCount = 0;
+restart:
+    if (restartCount++)
+    {
+        yield(restartCount);
+    }
+    bool needRestart = false;
+
+    Bucket &home = table[bucket_index(h, num_buckets)];
+    home.lock.writeLockOrRestart(needRestart);
+    if (needRestart)
+        goto restart;
+
+    size_t index = bucket_index(h, num_buckets);
+    for (size_t probes = 0; probes < num_buckets; ++probes)
+    {
+        Bucket &bucket = table[index];
+        const bool is_home = (&bucket == &home);
+
+        uint64_t version = 0;
+        if (!is_home)
+        {
+            version = bucket.lock.readLockOrRestart(needRestart);
+            if (needRestart)
+            {
+                home.lock.writeUnlock();
+                goto restart;
+            }
+        }
+        const int slot = find_tagged_slot(bucket, key, t);
+        const bool has_empty_slot = bucket.match(Bucket::empty_tag) != 0;
+        if (!is_home)
+        {
+            bucket.lock.readUnlockOrRestart(version, needRestart);
+            if (needRestart)
+            {
+                home.lock.writeUnlock();
+                goto restart;
+            }
+        }
+
+        if (slot >= 0)
+        {
+            if (!is_home)
+            {
+                bucket.lock.upgradeToWriteLockOrRestart(version, needRestart);
+                if (needRestart)
+                {
+                    home.lock.writeUnlock();
+                    goto restart;
+                }
+            }
+            bucket.tags[slot] = Bucket::deleted_tag;
+            if (!is_home)
+                bucket.lock.writeUnlock();
+            home.lock.writeUnlock();
             size--;
             return;
         }
+        if (has_empty_slot)
+        {
+            break;
+        }
+        index = next_bucket(index, num_buckets);
     }
+    home.lock.writeUnlock();
     throw out_of_range("Key not found");
 }
 
-template<typename K, typename V>
-bool HashMap<K, V>::contains(const K& key) {
+template <typename K, typename V>
+bool ConcurrentHashMap<K, V>::contains(const K &key)
+{
+    V value;
+    return find(key, fibonacci_hash(key), value);
+}
 
-    size_t index = hash(key);
-    for (auto& node : table[index]) {
-        if (node.key == key) {
-            return true;
+template <typename K, typename V>
+size_t ConcurrentHashMap<K, V>::getSize() const
+{
+    return size;
+}
+
+template <typename K, typename V>
+bool ConcurrentHashMap<K, V>::isEmpty() const
+{
+    return size == 0;
+}
+
+template class ConcurrentHashMap<unsigned int, unsigned int>;
+
+template <typename T>
+MPMCQueue<T>::MPMCQueue(size_t capacity) : cells(capacity), mask(capacity - 1)
+{
+    ensure(capacity >= 2 && (capacity & (capacity - 1)) == 0, "MPMCQueue capacity has to be a power of two.");
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template <typename T>
+bool MPMCQueue<T>::try_push(const T &data)
+{
+    Cell *cell;
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        cell = &cells[pos & mask];
+        const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (difference == 0)
+        {
+            if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (difference < 0)
+        {
+            // Full
+            return false;
+        }
+        else
+        {
+            pos = enqueue_pos.load(std::memory_order_relaxed);
         }
     }
-    return false;
+    cell->data = data;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
 }
 
-template<typename K, typename V>
-size_t HashMap<K, V>::getSize() const {
-    return size;
+template <typename T>
+bool MPMCQueue<T>::try_pop(T &data)
+{
+    Cell *cell;
+    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        cell = &cells[pos & mask];
+        const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+        if (difference == 0)
+        {
+            if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (difference < 0)
+        {
+            // Empty
+            return false;
+        }
+        else
+        {
+            pos = dequeue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    data = cell->data;
+    cell->sequence.store(pos + mask + 1, std::memory_order_release);
+    return true;
 }
 
-template<typename K, typename V>
-bool HashMap<K, V>::isEmpty() const {
-    return size == 0;
+template <typename K, typename V>
+size_t NumaPartitionedHashMap<K, V>::partition_of(const K &key) const
+{
+    // Fibonacci hashing, independent of the murmur hash the partitions use for their buckets.
+    const uint32_t h = static_cast<uint32_t>(static_cast<uint64_t>(std::hash<K>{}(key)) * 0x9E3779B97F4A7C15ULL >> 32);
+    return static_cast<size_t>((static_cast<uint64_t>(h) * partitions.size()) >> 32);
 }
 
+template <typename K, typename V>
+void NumaPartitionedHashMap<K, V>::scatter(const std::vector<K> &keys, std::vector<std::vector<K>> &partition_keys, std::vector<std::vector<uint32_t>> &positions) const
+{
+    for (uint32_t i = 0; i < keys.size(); ++i)
+    {
+        const size_t partition = partition_of(keys[i]);
+        partition_keys[partition].push_back(keys[i]);
+        positions[partition].push_back(i);
+    }
+}
 
-template class HashMap<unsigned int, unsigned int>;
+template <typename K, typename V>
+void NumaPartitionedHashMap<K, V>::serve(std::stop_token stop, Partition &partition, NodeID cpu)
+{
+    pin_to_cpu(cpu);
+    DelegatedBatch *batch;
+    while (!stop.stop_requested())
+    {
+        if (!partition.queue->try_pop(batch))
+        {
+            wait_cycles(100);
+            continue;
+        }
+        try
+        {
+            partition.map->vectorized_get_coroutine(*batch->keys, *batch->results, *batch->found, batch->group_size);
+        }
+        catch (...)
+        {
+            batch->error = std::current_exception();
+        }
+        batch->done.store(true, std::memory_order_release);
+    }
+}
+
+template <typename K, typename V>
+NumaPartitionedHashMap<K, V>::NumaPartitionedHashMap(const std::vector<NodeID> &nodes, size_t number_buckets, size_t workers_per_node, PrefetchProfiler &profiler) : profiler(profiler)
+{
+    ensure(!nodes.empty(), "NumaPartitionedHashMap needs at least one node.");
+    // Delegated batches are only ever popped by the workers.
+    ensure(workers_per_node >= 1, "NumaPartitionedHashMap needs at least one worker per node.");
+    auto &numa_manager = Prefetching::get().numa_manager;
+
+    partitions.resize(nodes.size());
+    for (size_t p = 0; p < nodes.size(); ++p)
+    {
+        auto &partition = partitions[p];
+        partition.node = nodes[p];
+        partition.memory_resource = std::make_unique<StaticNumaMemoryResource>(nodes[p]);
+        partition.map = std::make_unique<HashMap<K, V>>(std::max<size_t>(1, number_buckets / nodes.size()), profiler, *partition.memory_resource);
+        partition.queue = std::make_unique<MPMCQueue<DelegatedBatch *>>(queue_capacity);
+    }
+
+    for (auto &partition : partitions)
+    {
+        const auto &cpus = numa_manager.node_to_available_cpus[partition.node];
+        ensure(workers_per_node <= cpus.size(), "Not enough CPUs on node " + std::to_string(partition.node) + " for the workers.");
+        for (size_t w = 0; w < workers_per_node; ++w)
+        {
+            const NodeID cpu = cpus[cpus.size() - 1 - w];
+            workers.emplace_back([this, &partition, cpu](std::stop_token stop)
+                                 { serve(stop, partition, cpu); });
+        }
+    }
+}
+
+template <typename K, typename V>
+NumaPartitionedHashMap<K, V>::~NumaPartitionedHashMap()
+{
+    for (auto &worker : workers)
+    {
+        worker.request_stop();
+    }
+}
+
+template <typename K, typename V>
+void NumaPartitionedHashMap<K, V>::insert(const K &key, const V &value)
+{
+    partitions[partition_of(key)].map->insert(key, value);
+}
+
+template <typename K, typename V>
+V &NumaPartitionedHashMap<K, V>::get(const K &key)
+{
+    return partitions[partition_of(key)].map->get(key);
+}
+
+template <typename K, typename V>
+void NumaPartitionedHashMap<K, V>::vectorized_get_delegated(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size)
+{
+    const size_t num_partitions = partitions.size();
+    std::vector<std::vector<K>> partition_keys(num_partitions);
+    std::vector<std::vector<V>> partition_results(num_partitions);
+    std::vector<std::vector<bool>> partition_found(num_partitions);
+    std::vector<std::vector<uint32_t>> positions(num_partitions);
+    scatter(keys, partition_keys, positions);
+    found.assign(keys.size(), false);
+
+    std::vector<DelegatedBatch> batches(num_partitions);
+    for (size_t p = 0; p < num_partitions; ++p)
+    {
+        auto &batch = batches[p];
+        partition_results[p].resize(partition_keys[p].size());
+        batch.keys = &partition_keys[p];
+        batch.results = &partition_results[p];
+        batch.found = &partition_found[p];
+        batch.group_size = group_size;
+        if (partition_keys[p].empty())
+        {
+            batch.done = true;
+            continue;
+        }
+        while (!partitions[p].queue->try_push(&batch))
+        {
+            wait_cycles(100);
+        }
+    }
+
+    for (size_t p = 0; p < num_partitions; ++p)
+    {
+        while (!batches[p].done.load(std::memory_order_acquire))
+        {
+            wait_cycles(10);
+        }
+    }
+    for (size_t p = 0; p < num_partitions; ++p)
+    {
+        if (batches[p].error)
+        {
+            std::rethrow_exception(batches[p].error);
+        }
+        for (size_t j = 0; j < positions[p].size(); ++j)
+        {
+            results[positions[p][j]] = partition_results[p][j];
+            found[positions[p][j]] = partition_found[p][j];
+        }
+    }
+}
+
+template <typename K, typename V>
+void NumaPartitionedHashMap<K, V>::vectorized_get_remote(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size)
+{
+    const size_t num_partitions = partitions.size();
+    std::vector<std::vector<K>> partition_keys(num_partitions);
+    std::vector<std::vector<V>> partition_results(num_partitions);
+    std::vector<std::vector<bool>> partition_found(num_partitions);
+    std::vector<std::vector<uint32_t>> positions(num_partitions);
+    scatter(keys, partition_keys, positions);
+    found.assign(keys.size(), false);
+
+    for (size_t p = 0; p < num_partitions; ++p)
+    {
+        if (partition_keys[p].empty())
+        {
+            continue;
+        }
+        partition_results[p].resize(partition_keys[p].size());
+        partitions[p].map->vectorized_get_coroutine(partition_keys[p], partition_results[p], partition_found[p], group_size);
+        for (size_t j = 0; j < positions[p].size(); ++j)
+        {
+            results[positions[p][j]] = partition_results[p][j];
+            found[positions[p][j]] = partition_found[p][j];
+        }
+    }
+}
+
+template <typename K, typename V>
+size_t NumaPartitionedHashMap<K, V>::getSize() const
+{
+    size_t size = 0;
+    for (const auto &partition : partitions)
+    {
+        size += partition.map->getSize();
+    }
+    return size;
+}
+
+template class NumaPartitionedHashMap<unsigned int, unsigned int>;
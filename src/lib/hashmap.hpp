@@ -3,11 +3,20 @@
 #include <vector>
 #include <coroutine>
 #include <iterator>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <exception>
+#include <optional>
 #include <assert.h>
 
 #include "coroutine.hpp"
+#include "payload_arena.hpp"
+#include "batch_reorder.hpp"
+#include "rolling_prefetch.hpp"
 #include "utils/profiler.cpp"
 #include "numa/numa_memory_resource.hpp"
+#include "numa/static_numa_memory_resource.hpp"
 
 using namespace std;
 
@@ -19,20 +28,90 @@ public:
     V value;
 };
 
+/**
+ * Blocked Bloom filter: every key sets one bit in each of the eight words of a single cache-line sized block, so a
+ * membership test costs one (prefetchable) cache miss. Filters with zero bits are disabled.
+ */
+class BlockedBloomFilter
+{
+public:
+    struct alignas(64) Block
+    {
+        uint64_t words[8];
+    };
+
+    BlockedBloomFilter(size_t bits, std::pmr::memory_resource &memory_resource);
+    bool enabled() const;
+    void insert(uint64_t hash);
+    bool contains(uint64_t hash) const;
+    void prefetch(uint64_t hash) const;
+
+private:
+    std::pmr::vector<Block> blocks;
+
+    const Block &block_for(uint64_t hash) const;
+    static uint64_t mask_for(uint64_t hash, size_t word);
+};
+
+template <typename K, typename V>
+class FrozenHashMap;
+
+/**
+ * Chained hash map. With a max_load_factor > 0 it grows by incremental rehashing: growing only swaps in a table of
+ * twice the size, every following insert/remove migrates a bounded number of old buckets. Until an old bucket is
+ * migrated, its keys are looked up in the old table.
+ * An optional Bloom filter in front of the buckets answers most misses without walking a chain. Batched lookups never
+ * throw on a miss, they report hits in the found bitmap instead. Removed keys stay in the filter.
+ */
 template<typename K, typename V>
 class HashMap {
 private:
-    std::pmr::vector<std::pmr::list<Node<K, V>>> table;
+    friend class FrozenHashMap<K, V>;
+
+    using Bucket = std::pmr::list<Node<K, V>>;
+    static constexpr size_t migration_step = 8;
+
+    std::pmr::vector<Bucket> table;
     size_t size;
     size_t capacity;
+    double max_load_factor;
     std::pmr::memory_resource &memory_resource;
 
+    // Table being migrated into table, buckets below migration_cursor are already moved.
+    std::pmr::vector<Bucket> old_table;
+    size_t migration_cursor = 0;
+
     size_t hash(const K& key);
+    static size_t hash_to_bucket(const K &key, uint64_t buckets);
+    Bucket &bucket_for(const K &key);
+    // Computes the buckets of a whole batch up front, the lookup stages only consume them.
+    void hash_batch(const std::vector<K> &keys, std::vector<Bucket *> &buckets);
+    bool migrating() const;
+    void grow();
+    void migrate(size_t num_old_buckets);
+    void maintain();
+
+    BlockedBloomFilter bloom_filter;
+    static uint64_t filter_hash(const K &key);
+    bool may_contain(const K &key) const;
+    void prefetch_filter(const K &key) const;
+
+    void allocate_nodes(const std::vector<K> &keys, const std::vector<V> &values, Bucket &spare, std::vector<typename Bucket::iterator> &nodes);
+    void link(Bucket &bucket, Bucket &spare, typename Bucket::iterator node);
+    void maintain_batch(size_t inserted);
 
     struct AMAC_state {
         K key;
-        typename std::list<Node<K, V>>::iterator node;
-        typename std::list<Node<K, V>>::iterator end;
+        Bucket *bucket;
+        typename Bucket::iterator node;
+        typename Bucket::iterator end;
+        int stage = 0;
+        int i;
+    };
+
+    struct AMAC_insert_state {
+        Bucket *bucket;
+        typename Bucket::iterator cursor;
         int stage = 0;
         int i;
     };
@@ -40,21 +119,433 @@ private:
 public:
     PrefetchProfiler &profiler;
 
-    HashMap(size_t capacity, PrefetchProfiler &profiler, std::pmr::memory_resource &memory_resource);
+    // capacity is the initial number of buckets, a max_load_factor of 0 keeps it fixed, bloom_filter_bits of 0
+    // disables the filter.
+    HashMap(size_t capacity, PrefetchProfiler &profiler, std::pmr::memory_resource &memory_resource, double max_load_factor = 0, size_t bloom_filter_bits = 0);
     ~HashMap();
     void insert(const K& key, const V& value);
+    // Batched inserts. A key occurring several times in one batch is linked once and keeps one of its values.
+    coroutine insert_co(Bucket *bucket, Bucket &spare, typename Bucket::iterator node);
+    void vectorized_insert_gp(const std::vector<K> &keys, const std::vector<V> &values);
+    void vectorized_insert_amac(const std::vector<K> &keys, const std::vector<V> &values, int group_size);
+    void vectorized_insert_coroutine(const std::vector<K> &keys, const std::vector<V> &values, int group_size);
     V& get(const K& key);
-    coroutine get_co(const K& key, std::vector<V>& results, int i);
-    coroutine get_co_exp(const K &key, std::vector<V> &results, int i);
-    coroutine profile_get_co_exp(const K &key, std::vector<V> &results, int i);
-    void vectorized_get(const std::vector<K>& keys, std::vector<V>& results);
-    void vectorized_get_gp(const std::vector<K>& keys, std::vector<V>& results);
-    void vectorized_get_amac(const std::vector<K>& keys, std::vector<V>& results, int group_size);
-    void vectorized_get_coroutine(const std::vector<K>& keys, std::vector<V>& results, int group_size);
-    void vectorized_get_coroutine_exp(const std::vector<K> &keys, std::vector<V> &results, int group_size);
-    void profile_vectorized_get_coroutine_exp(const std::vector<K> &keys, std::vector<V> &results, int group_size);
+    std::optional<V> find(const K &key);
+    coroutine get_co(const K& key, Bucket *bucket, std::vector<V>& results, std::vector<bool>& found, int i);
+    coroutine get_co_exp(const K &key, Bucket *bucket, std::vector<V> &results, std::vector<bool> &found, int i);
+    coroutine profile_get_co_exp(const K &key, Bucket *bucket, std::vector<V> &results, std::vector<bool> &found, int i);
+    void vectorized_get(const std::vector<K>& keys, std::vector<V>& results, std::vector<bool>& found);
+    void vectorized_get_gp(const std::vector<K>& keys, std::vector<V>& results, std::vector<bool>& found);
+    void vectorized_get_amac(const std::vector<K>& keys, std::vector<V>& results, std::vector<bool>& found, int group_size);
+    void vectorized_get_coroutine(const std::vector<K>& keys, std::vector<V>& results, std::vector<bool>& found, int group_size);
+    void vectorized_get_coroutine_exp(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size);
+    void profile_vectorized_get_coroutine_exp(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size);
+    // Looks the batch up in bucket array order (see BatchReorder), regions span at least 2^min_region_shift bytes.
+    void vectorized_get_reorder(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, size_t min_region_shift = BatchReorder::page_shift);
+    // Prefetches the bucket of key i + distance while walking the chain of key i (see rolling_prefetch).
+    void vectorized_get_rolling(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, size_t distance);
+    // Lookups for values that are PayloadArena handles: the record of key i is copied to sink + i * record_size.
+    coroutine get_payload_co(const K &key, Bucket *bucket, const PayloadArena &arena, char *sink, std::vector<bool> &found, int i);
+    void vectorized_get_payload(const std::vector<K> &keys, const PayloadArena &arena, char *sink, std::vector<bool> &found);
+    void vectorized_get_payload_amac(const std::vector<K> &keys, const PayloadArena &arena, char *sink, std::vector<bool> &found, int group_size);
+    void vectorized_get_payload_coroutine(const std::vector<K> &keys, const PayloadArena &arena, char *sink, std::vector<bool> &found, int group_size);
+    // Rolling bucket stage that collects the handles of all hits, then a rolling materialization stage over them.
+    void vectorized_get_payload_rolling(const std::vector<K> &keys, const PayloadArena &arena, char *sink, std::vector<bool> &found, size_t distance);
     void remove(const K& key);
     bool contains(const K& key);
     size_t getSize() const;
     bool isEmpty() const;
+    // Read-only copy in a contiguous layout on the given node, see FrozenHashMap.
+    FrozenHashMap<K, V> freeze(NodeID node, bool use_explicit_huge_pages = false, bool madvise_huge_pages = true);
+};
+
+/**
+ * Bucket of the FrozenHashMap: the first entry is inlined, further entries of the bucket live at
+ * [offset, offset + size - 1) of the overflow arrays.
+ */
+template <typename K, typename V>
+struct FrozenBucket
+{
+    K key;
+    V value;
+    uint32_t offset;
+    uint32_t size;
+};
+
+/**
+ * Read-only hash map in a CSR layout, built from a HashMap by freeze(). One bucket per entry keeps most lookups to
+ * the single cache line of their bucket, the few colliding entries are stored contiguously per bucket instead of in
+ * list nodes. All arrays are allocated on one NUMA node, optionally on huge pages.
+ */
+template <typename K, typename V>
+class FrozenHashMap
+{
+private:
+    using Bucket = FrozenBucket<K, V>;
+
+    // Declared first, so that it outlives the arrays allocated from it.
+    std::unique_ptr<StaticNumaMemoryResource> memory_resource;
+    std::pmr::vector<Bucket> buckets;
+    std::pmr::vector<K> overflow_keys;
+    std::pmr::vector<V> overflow_values;
+    size_t size;
+
+    size_t bucket_index(const K &key) const;
+    void hash_batch(const std::vector<K> &keys, std::vector<const Bucket *> &key_buckets) const;
+    // Checks the inlined entry, returns true if that already decided the lookup.
+    static bool probe_inline(const Bucket &bucket, const K &key, V &value, bool &found);
+    bool probe_overflow(const Bucket &bucket, const K &key, V &value) const;
+    void prefetch_overflow(const Bucket &bucket) const;
+
+    struct AMAC_state
+    {
+        K key;
+        const Bucket *bucket;
+        int stage = 0;
+        int i;
+    };
+
+public:
+    PrefetchProfiler &profiler;
+
+    FrozenHashMap(HashMap<K, V> &map, NodeID node, bool use_explicit_huge_pages, bool madvise_huge_pages);
+    ~FrozenHashMap();
+    V get(const K &key) const;
+    std::optional<V> find(const K &key) const;
+    coroutine get_co(const K &key, const Bucket *bucket, std::vector<V> &results, std::vector<bool> &found, int i);
+    void vectorized_get(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found);
+    void vectorized_get_gp(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found);
+    void vectorized_get_amac(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size);
+    void vectorized_get_coroutine(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size);
+    void vectorized_get_reorder(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, size_t min_region_shift = BatchReorder::page_shift);
+    void vectorized_get_rolling(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, size_t distance);
+    bool contains(const K &key) const;
+    size_t getSize() const;
+    bool isEmpty() const;
+    // Bytes of the buckets and overflow arrays.
+    size_t memory_usage() const;
+};
+
+/**
+ * Cache-line sized bucket of the BucketizedHashMap. The 8-bit tags come first so that one SIMD compare yields all
+ * candidate slots of the bucket; keys and values follow within the same cache line.
+ */
+template <typename K, typename V>
+struct alignas(64) TaggedBucket
+{
+    static constexpr size_t slots = (64 - 1) / (1 + sizeof(K) + sizeof(V));
+    static constexpr uint8_t empty_tag = 0;
+    static constexpr uint8_t deleted_tag = 1;
+
+    uint8_t tags[slots];
+    K keys[slots];
+    V values[slots];
+
+    // Bitmask of the slots whose tag equals the given tag.
+    uint32_t match(uint8_t tag) const;
+};
+
+/**
+ * Open-addressing hash map on cache-line sized buckets. A lookup hashes to one bucket, compares the tags of all slots
+ * at once and only checks the keys of matching slots, so a single prefetch per lookup usually suffices. Full buckets
+ * overflow into the next bucket, a bucket with an empty slot terminates the probe sequence.
+ */
+template <typename K, typename V>
+class BucketizedHashMap
+{
+private:
+    using Bucket = TaggedBucket<K, V>;
+    static constexpr double max_load_factor = 0.8;
+
+    std::pmr::vector<Bucket> table;
+    size_t size;
+    size_t num_buckets;
+    std::pmr::memory_resource &memory_resource;
+
+    Bucket *find(const K &key, uint64_t key_hash, int &slot);
+
+    struct AMAC_state
+    {
+        K key;
+        uint8_t tag;
+        size_t bucket;
+        size_t probes;
+        int stage = 0;
+        int i;
+    };
+
+public:
+    PrefetchProfiler &profiler;
+
+    // capacity is the number of entries the map is sized for.
+    BucketizedHashMap(size_t capacity, PrefetchProfiler &profiler, std::pmr::memory_resource &memory_resource);
+    ~BucketizedHashMap();
+    void insert(const K &key, const V &value);
+    V &get(const K &key);
+    std::optional<V> find(const K &key);
+    coroutine get_co(const K &key, uint64_t key_hash, std::vector<V> &results, std::vector<bool> &found, int i);
+    void vectorized_get(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found);
+    void vectorized_get_gp(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found);
+    void vectorized_get_amac(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size);
+    void vectorized_get_coroutine(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size);
+    void vectorized_get_reorder(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, size_t min_region_shift = BatchReorder::page_shift);
+    void remove(const K &key);
+    bool contains(const K &key);
+    size_t getSize() const;
+    bool isEmpty() const;
+};
+
+/**
+ * Bucketized cuckoo hash map. Every key has exactly two candidate buckets, both known from its hash, so lookups
+ * prefetch both at once and never follow a probe sequence. Inserts into two full buckets displace entries to their
+ * alternate bucket, up to max_kicks times.
+ */
+template <typename K, typename V>
+class CuckooHashMap
+{
+private:
+    using Bucket = TaggedBucket<K, V>;
+    static constexpr double max_load_factor = 0.9;
+    static constexpr size_t max_kicks = 500;
+
+    std::pmr::vector<Bucket> table;
+    size_t size;
+    size_t num_buckets;
+    std::pmr::memory_resource &memory_resource;
+    uint64_t kick_state = 0x2545F4914F6CDD1DULL;
+
+    // The first candidate bucket is bucket_index(hash), the second one comes from a remixed hash.
+    size_t second_bucket(uint64_t hash) const;
+    // Probes both candidate buckets, value is only set if the key was found.
+    bool probe(const K &key, uint64_t key_hash, V &value) const;
+    void prefetch_buckets(uint64_t hash) const;
+    size_t next_kick();
+
+    struct AMAC_state
+    {
+        K key;
+        uint64_t hash;
+        int stage = 0;
+        int i;
+    };
+
+public:
+    PrefetchProfiler &profiler;
+
+    // capacity is the number of entries the map is sized for.
+    CuckooHashMap(size_t capacity, PrefetchProfiler &profiler, std::pmr::memory_resource &memory_resource);
+    ~CuckooHashMap();
+    void insert(const K &key, const V &value);
+    V &get(const K &key);
+    std::optional<V> find(const K &key);
+    coroutine get_co(const K &key, uint64_t key_hash, std::vector<V> &results, std::vector<bool> &found, int i);
+    void vectorized_get(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found);
+    void vectorized_get_gp(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found);
+    void vectorized_get_amac(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size);
+    void vectorized_get_coroutine(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size);
+    void remove(const K &key);
+    bool contains(const K &key);
+    size_t getSize() const;
+    bool isEmpty() const;
+};
+
+/**
+ * Version lock modeled on the OptLock of the OLC BTrees. Writers lock exclusively, readers only remember the version
+ * and validate it after reading; a changed version means they have to restart.
+ */
+struct OptLock
+{
+    std::atomic<uint64_t> version{0b100};
+
+    bool isLocked(uint64_t version) const { return ((version & 0b10) == 0b10); }
+
+    uint64_t readLockOrRestart(bool &needRestart) const
+    {
+        const uint64_t current = version.load();
+        if (isLocked(current))
+        {
+            needRestart = true;
+        }
+        return current;
+    }
+
+    void writeLockOrRestart(bool &needRestart)
+    {
+        uint64_t current = readLockOrRestart(needRestart);
+        if (needRestart)
+            return;
+        upgradeToWriteLockOrRestart(current, needRestart);
+    }
+
+    void upgradeToWriteLockOrRestart(uint64_t &current, bool &needRestart)
+    {
+        if (version.compare_exchange_strong(current, current + 0b10))
+        {
+            current = current + 0b10;
+        }
+        else
+        {
+            needRestart = true;
+        }
+    }
+
+    void writeUnlock() { version.fetch_add(0b10); }
+
+    void readUnlockOrRestart(uint64_t startRead, bool &needRestart) const { needRestart = (startRead != version.load()); }
+};
+
+/**
+ * Bucket of the ConcurrentHashMap: a TaggedBucket with its version lock in the same cache line.
+ */
+template <typename K, typename V>
+struct alignas(64) VersionedBucket
+{
+    static constexpr size_t slots = (64 - sizeof(OptLock)) / (1 + sizeof(K) + sizeof(V));
+    static constexpr uint8_t empty_tag = 0;
+    static constexpr uint8_t deleted_tag = 1;
+
+    OptLock lock;
+    uint8_t tags[slots];
+    K keys[slots];
+    V values[slots];
+
+    uint32_t match(uint8_t tag) const;
+};
+
+/**
+ * Thread-safe variant of the BucketizedHashMap. Every bucket carries a version lock: lookups read optimistically and
+ * restart if a bucket changed underneath them, so they never write shared memory. Writers lock the home bucket of
+ * their key for the whole operation, which serializes all writers of a key, and additionally lock the overflow bucket
+ * they modify.
+ */
+template <typename K, typename V>
+class ConcurrentHashMap
+{
+private:
+    using Bucket = VersionedBucket<K, V>;
+    static constexpr double max_load_factor = 0.8;
+
+    enum class ProbeResult
+    {
+        Found,
+        Miss,
+        Next,
+        Restart
+    };
+
+    size_t num_buckets;
+    std::pmr::vector<Bucket> table;
+    std::atomic<size_t> size;
+    std::pmr::memory_resource &memory_resource;
+
+    static size_t buckets_for(size_t capacity);
+    // Optimistically probes one bucket, value is only set if the key was found.
+    static ProbeResult probe(const Bucket &bucket, const K &key, uint8_t tag, V &value);
+    static void yield(int count);
+    bool find(const K &key, uint64_t key_hash, V &value);
+
+    struct AMAC_state
+    {
+        K key;
+        uint64_t hash;
+        size_t bucket;
+        size_t probes;
+        int stage = 0;
+        int i;
+    };
+
+public:
+    PrefetchProfiler &profiler;
+
+    // capacity is the number of entries the map is sized for.
+    ConcurrentHashMap(size_t capacity, PrefetchProfiler &profiler, std::pmr::memory_resource &memory_resource);
+    ~ConcurrentHashMap();
+    void insert(const K &key, const V &value);
+    // Returns a copy, a reference into the table could be overwritten concurrently.
+    V get(const K &key);
+    std::optional<V> find(const K &key);
+    coroutine get_co(const K &key, uint64_t key_hash, std::vector<V> &results, std::vector<bool> &found, int i);
+    void vectorized_get(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found);
+    void vectorized_get_gp(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found);
+    void vectorized_get_amac(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size);
+    void vectorized_get_coroutine(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size);
+    void remove(const K &key);
+    bool contains(const K &key);
+    size_t getSize() const;
+    bool isEmpty() const;
+};
+
+/**
+ * Bounded lock-free multi-producer/multi-consumer queue (Vyukov). capacity has to be a power of two.
+ */
+template <typename T>
+class MPMCQueue
+{
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    std::vector<Cell> cells;
+    size_t mask;
+    alignas(64) std::atomic<size_t> enqueue_pos{0};
+    alignas(64) std::atomic<size_t> dequeue_pos{0};
+
+public:
+    explicit MPMCQueue(size_t capacity);
+    bool try_push(const T &data);
+    bool try_pop(T &data);
+};
+
+/**
+ * Hash map partitioned by key hash across NUMA nodes. Every partition is a HashMap allocated on its node, served by
+ * worker threads pinned to that node. Lookup batches are split per partition and either delegated to the workers of
+ * the owning node through a per-node queue (vectorized_get_delegated) or executed by the calling thread with remote
+ * prefetching (vectorized_get_remote). Inserts are not delegated and must not run concurrently with lookups.
+ */
+template <typename K, typename V>
+class NumaPartitionedHashMap
+{
+private:
+    struct DelegatedBatch
+    {
+        const std::vector<K> *keys;
+        std::vector<V> *results;
+        std::vector<bool> *found;
+        int group_size;
+        std::atomic<bool> done{false};
+        std::exception_ptr error;
+    };
+
+    struct Partition
+    {
+        NodeID node;
+        std::unique_ptr<StaticNumaMemoryResource> memory_resource;
+        std::unique_ptr<HashMap<K, V>> map;
+        std::unique_ptr<MPMCQueue<DelegatedBatch *>> queue;
+    };
+
+    static constexpr size_t queue_capacity = 1024;
+
+    std::vector<Partition> partitions;
+    // Destroyed before the partitions, stopping the workers first.
+    std::vector<std::jthread> workers;
+
+    size_t partition_of(const K &key) const;
+    void scatter(const std::vector<K> &keys, std::vector<std::vector<K>> &partition_keys, std::vector<std::vector<uint32_t>> &positions) const;
+    void serve(std::stop_token stop, Partition &partition, NodeID cpu);
+
+public:
+    PrefetchProfiler &profiler;
+
+    // number_buckets is split evenly across the partitions, workers use the last CPUs of their node.
+    NumaPartitionedHashMap(const std::vector<NodeID> &nodes, size_t number_buckets, size_t workers_per_node, PrefetchProfiler &profiler);
+    ~NumaPartitionedHashMap();
+    void insert(const K &key, const V &value);
+    V &get(const K &key);
+    void vectorized_get_delegated(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size);
+    void vectorized_get_remote(const std::vector<K> &keys, std::vector<V> &results, std::vector<bool> &found, int group_size);
+    size_t getSize() const;
 };
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory_resource>
+#include <stdexcept>
+
+/**
+ * Arena of fixed-size payload records, addressed by 32 bit handles. Index structures store the handle as their value
+ * and only materialize the record when a lookup hits. Records start on cache line boundaries, so a record of n cache
+ * lines is fetched with exactly n prefetches.
+ */
+class PayloadArena
+{
+public:
+    using Handle = uint32_t;
+    static constexpr size_t cache_line_size = 64;
+
+    PayloadArena(size_t record_size, size_t capacity, std::pmr::memory_resource &memory_resource)
+        : record_size_(record_size), stride((record_size + cache_line_size - 1) / cache_line_size * cache_line_size), capacity(capacity), memory_resource(memory_resource)
+    {
+        if (record_size == 0)
+        {
+            throw std::invalid_argument("PayloadArena records need a size.");
+        }
+        if (capacity > std::numeric_limits<Handle>::max())
+        {
+            throw std::invalid_argument("Too many records for 32 bit handles.");
+        }
+        data = static_cast<char *>(memory_resource.allocate(stride * capacity, cache_line_size));
+    }
+
+    ~PayloadArena()
+    {
+        memory_resource.deallocate(data, stride * capacity, cache_line_size);
+    }
+
+    PayloadArena(const PayloadArena &) = delete;
+    PayloadArena &operator=(const PayloadArena &) = delete;
+
+    // Copies record_size bytes from record into the arena.
+    Handle append(const void *record)
+    {
+        if (count == capacity)
+        {
+            throw std::length_error("PayloadArena is full");
+        }
+        std::memcpy(data + count * stride, record, record_size_);
+        return static_cast<Handle>(count++);
+    }
+
+    char *record(Handle handle) { return data + static_cast<size_t>(handle) * stride; }
+    const char *record(Handle handle) const { return data + static_cast<size_t>(handle) * stride; }
+
+    void prefetch(Handle handle) const
+    {
+        const char *line = record(handle);
+        for (size_t offset = 0; offset < record_size_; offset += cache_line_size)
+        {
+            __builtin_prefetch(line + offset, 0, 3);
+        }
+    }
+
+    void materialize(Handle handle, char *sink) const
+    {
+        std::memcpy(sink, record(handle), record_size_);
+    }
+
+    size_t record_size() const { return record_size_; }
+    size_t size() const { return count; }
+
+private:
+    size_t record_size_;
+    size_t stride;
+    size_t capacity;
+    size_t count = 0;
+    std::pmr::memory_resource &memory_resource;
+    char *data;
+};
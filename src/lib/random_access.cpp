@@ -14,16 +14,33 @@
 */
 
 template <typename V>
-RandomAccess<V>::RandomAccess(size_t num_elements)
-    : num_elements(num_elements)
+RandomAccess<V>::RandomAccess(size_t num_elements, std::pmr::memory_resource &memory_resource)
+    : num_elements(num_elements), memory_resource(memory_resource)
 {
-    data = new V[num_elements];
+    data = static_cast<V *>(memory_resource.allocate(num_elements * sizeof(V), 64));
     for (size_t i = 0; i < num_elements; ++i)
     {
         data[i] = i;
     }
 }
 
+template <typename V>
+RandomAccess<V>::~RandomAccess()
+{
+    memory_resource.deallocate(data, num_elements * sizeof(V), 64);
+}
+
+template <typename V>
+void RandomAccess<V>::prefetch(size_t pos) const
+{
+    const char *element = reinterpret_cast<const char *>(data + pos);
+    const size_t lines = prefetch_all_lines ? lines_per_element : 1;
+    for (size_t line = 0; line < lines; ++line)
+    {
+        __builtin_prefetch(element + line * cache_line_size, 0, 3);
+    }
+}
+
 template <typename V>
 V &RandomAccess<V>::get(size_t pos)
 {
@@ -33,7 +50,7 @@ V &RandomAccess<V>::get(size_t pos)
 template <typename V>
 coroutine RandomAccess<V>::get_co(size_t pos, std::vector<V> &results, int i)
 {
-    __builtin_prefetch(data + pos, 0, 3);
+    prefetch(pos);
     co_await std::suspend_always{};
     results[i] = data[pos];
     co_return;
@@ -66,7 +83,7 @@ void RandomAccess<V>::vectorized_get_gp(const std::vector<size_t> &positions, st
     // function logic. Here this is not required.
     for (auto pos : positions)
     {
-        __builtin_prefetch(data + pos, 0, 3);
+        prefetch(pos);
     }
     for (size_t i = 0; i < positions.size(); ++i)
     {
@@ -84,7 +101,7 @@ void RandomAccess<V>::vectorized_get_amac(const std::vector<size_t> &positions,
         size_t group_offset = group_iteration * group_size;
         for (size_t i = 0; i < std::min(group_size, positions.size() - group_offset); ++i)
         {
-            __builtin_prefetch(data + positions[group_offset + i], 0, 3);
+            prefetch(positions[group_offset + i]);
         }
         for (size_t i = 0; i < std::min(group_size, positions.size() - group_offset); ++i)
         {
@@ -93,6 +110,16 @@ void RandomAccess<V>::vectorized_get_amac(const std::vector<size_t> &positions,
     }
 }
 
+template <typename V>
+void RandomAccess<V>::vectorized_get_rolling(const std::vector<size_t> &positions, std::vector<V> &results, size_t distance)
+{
+    rolling_prefetch(
+        positions.size(), distance, [&](size_t i)
+        { prefetch(positions[i]); },
+        [&](size_t i)
+        { results[i] = data[positions[i]]; });
+}
+
 template <typename V>
 void RandomAccess<V>::vectorized_get_coroutine(const std::vector<size_t> &positions, std::vector<V> &results, size_t group_size)
 {
@@ -175,13 +202,105 @@ void RandomAccess<V>::vectorized_get_coroutine_exp(const std::vector<size_t> &po
     }
 }
 
+#if defined(X86_64) && (defined(__AVX2__) || defined(__AVX512F__))
+#if defined(__AVX512F__)
+constexpr size_t gather_lanes = 8;
+#else
+constexpr size_t gather_lanes = 4;
+#endif
+// Independent gathers in flight per loop iteration.
+constexpr size_t gather_unroll = 4;
+
+template <typename V>
+inline void gather_lanes_at(const V *data, const size_t *positions, V *results)
+{
+#if defined(__AVX512F__)
+    __m512i indices = _mm512_loadu_si512(positions);
+    if constexpr (sizeof(V) == 4)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(results), _mm512_i64gather_epi32(indices, data, 4));
+    }
+    else
+    {
+        _mm512_storeu_si512(results, _mm512_i64gather_epi64(indices, data, 8));
+    }
+#else
+    __m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(positions));
+    if constexpr (sizeof(V) == 4)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(results), _mm256_i64gather_epi32(reinterpret_cast<const int *>(data), indices, 4));
+    }
+    else
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(results), _mm256_i64gather_epi64(reinterpret_cast<const long long *>(data), indices, 8));
+    }
+#endif
+}
+#endif
+
+template <typename V>
+void RandomAccess<V>::vectorized_get_gather(const std::vector<size_t> &positions, std::vector<V> &results, [[maybe_unused]] size_t prefetch_distance)
+{
+#if defined(X86_64) && (defined(__AVX2__) || defined(__AVX512F__))
+    if constexpr (sizeof(V) == 4 || sizeof(V) == 8)
+    {
+        constexpr size_t step = gather_lanes * gather_unroll;
+        const size_t count = positions.size();
+        size_t i = 0;
+        for (; i + step <= count; i += step)
+        {
+            if (prefetch_distance > 0 && i + prefetch_distance + step <= count)
+            {
+                for (size_t j = i + prefetch_distance; j < i + prefetch_distance + step; ++j)
+                {
+                    __builtin_prefetch(data + positions[j], 0, 3);
+                }
+            }
+            for (size_t u = 0; u < gather_unroll; ++u)
+            {
+                gather_lanes_at(data, positions.data() + i + u * gather_lanes, results.data() + i + u * gather_lanes);
+            }
+        }
+        for (; i < count; ++i)
+        {
+            results[i] = data[positions[i]];
+        }
+        return;
+    }
+#endif
+    vectorized_get(positions, results);
+}
+
+template <typename V>
+void RandomAccess<V>::vectorized_get_reorder(const std::vector<size_t> &positions, std::vector<V> &results, size_t min_region_shift)
+{
+    const size_t shift = BatchReorder::region_shift(num_elements * sizeof(V), min_region_shift);
+    std::vector<uint32_t> order;
+    BatchReorder::partition(positions.size(), [&](size_t i)
+                            { return (positions[i] * sizeof(V)) >> shift; }, order);
+    for (auto i : order)
+    {
+        results[i] = data[positions[i]];
+    }
+}
+
 template <typename V>
 size_t RandomAccess<V>::getSize() const
 {
     return num_elements;
 }
 
+template <typename V>
+void RandomAccess<V>::set_prefetch_all_lines(bool all_lines)
+{
+    prefetch_all_lines = all_lines;
+}
+
 template class RandomAccess<uint8_t>;
 template class RandomAccess<uint16_t>;
 template class RandomAccess<uint32_t>;
 template class RandomAccess<uint64_t>;
+template class RandomAccess<Record<64>>;
+template class RandomAccess<Record<128>>;
+template class RandomAccess<Record<256>>;
+template class RandomAccess<Record<512>>;
@@ -1,17 +1,47 @@
 #include <stdint.h>
 #include <cstddef>
 #include <vector>
+#include <memory_resource>
 #include "coroutine.hpp"
+#include "batch_reorder.hpp"
+#include "rolling_prefetch.hpp"
+
+// Fixed-size record spanning Size / 64 cache lines. Only the position it was written for is compared, the rest is
+// payload that every read copies.
+template <size_t Size>
+struct alignas(64) Record
+{
+    static_assert(Size % 64 == 0, "Records span whole cache lines.");
+
+    uint64_t id;
+    uint8_t payload[Size - sizeof(uint64_t)];
+
+    Record() = default;
+    Record(size_t id) : id(id) {}
+    bool operator==(const Record &other) const { return id == other.id; }
+};
 
 template <typename V>
 class RandomAccess
 {
 private:
+    static constexpr size_t cache_line_size = 64;
+    static constexpr size_t lines_per_element = (sizeof(V) + cache_line_size - 1) / cache_line_size;
+
     V *data;
     size_t num_elements;
+    std::pmr::memory_resource &memory_resource;
+    bool prefetch_all_lines = true;
+
+    // Prefetches every line of the element, or only its first line if prefetch_all_lines is off.
+    void prefetch(size_t pos) const;
 
 public:
-    RandomAccess(size_t num_elements);
+    // The elements are allocated from memory_resource, e.g. a NUMA resource to place them on a node or on huge pages.
+    RandomAccess(size_t num_elements, std::pmr::memory_resource &memory_resource = *std::pmr::get_default_resource());
+    ~RandomAccess();
+    RandomAccess(const RandomAccess &) = delete;
+    RandomAccess &operator=(const RandomAccess &) = delete;
     V &get(size_t pos);
     coroutine get_co(size_t pos, std::vector<V> &results, int i);
     coroutine get_co_exp(size_t pos, std::vector<V> &results, int i);
@@ -20,5 +50,15 @@ public:
     void vectorized_get_amac(const std::vector<size_t> &positions, std::vector<V> &results, size_t group_size);
     void vectorized_get_coroutine(const std::vector<size_t> &positions, std::vector<V> &results, size_t group_size);
     void vectorized_get_coroutine_exp(const std::vector<size_t> &positions, std::vector<V> &results, size_t group_size);
+    // Prefetches element i + distance while reading element i (see rolling_prefetch).
+    void vectorized_get_rolling(const std::vector<size_t> &positions, std::vector<V> &results, size_t distance);
+    // Hardware gathers for 32 and 64 bit elements, several independent gathers per iteration. A non-zero
+    // prefetch_distance prefetches the elements that are gathered prefetch_distance positions later.
+    // Other element sizes and targets without AVX2 fall back to vectorized_get.
+    void vectorized_get_gather(const std::vector<size_t> &positions, std::vector<V> &results, size_t prefetch_distance = 0);
+    // Reads the batch region by region (see BatchReorder), regions span at least 2^min_region_shift bytes.
+    void vectorized_get_reorder(const std::vector<size_t> &positions, std::vector<V> &results, size_t min_region_shift = BatchReorder::page_shift);
     size_t getSize() const;
+    // Whether the GP, AMAC and coroutine reads prefetch all lines of multi-line elements or only the first one.
+    void set_prefetch_all_lines(bool all_lines);
 };
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+
+/**
+ * Software-pipelined batch loop: element i + distance is prefetched while element i is consumed, so a steady number
+ * of misses is in flight instead of the bursts of group prefetching. A compile-time distance gives the inner block a
+ * constant trip count that the compiler unrolls; rolling_prefetch dispatches common distances to it.
+ */
+template <typename Distance, typename Prefetch, typename Consume>
+inline void rolling_pipeline(size_t count, Distance distance, Prefetch &&prefetch, Consume &&consume)
+{
+    const size_t d = distance;
+    for (size_t i = 0; i < std::min(d, count); ++i)
+    {
+        prefetch(i);
+    }
+
+    size_t i = 0;
+    if (d > 0)
+    {
+        for (; i + 2 * d <= count; i += d)
+        {
+            for (size_t j = 0; j < distance; ++j)
+            {
+                prefetch(i + d + j);
+                consume(i + j);
+            }
+        }
+    }
+    for (; i < count; ++i)
+    {
+        if (i + d < count)
+        {
+            prefetch(i + d);
+        }
+        consume(i);
+    }
+}
+
+template <typename Prefetch, typename Consume>
+inline void rolling_prefetch(size_t count, size_t distance, Prefetch &&prefetch, Consume &&consume)
+{
+    switch (distance)
+    {
+    case 4:
+        rolling_pipeline(count, std::integral_constant<size_t, 4>{}, prefetch, consume);
+        break;
+    case 8:
+        rolling_pipeline(count, std::integral_constant<size_t, 8>{}, prefetch, consume);
+        break;
+    case 16:
+        rolling_pipeline(count, std::integral_constant<size_t, 16>{}, prefetch, consume);
+        break;
+    case 32:
+        rolling_pipeline(count, std::integral_constant<size_t, 32>{}, prefetch, consume);
+        break;
+    default:
+        rolling_pipeline(count, distance, prefetch, consume);
+    }
+}
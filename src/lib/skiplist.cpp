@@ -15,16 +15,60 @@
  */
 
 #include "skiplist.hpp"
+#include "utils.cpp"
+#include <chrono>
 #include <iostream>
+#include <vector>
+
+// stages of an interleaved lookup
+#define SEARCH_LANE 0
+#define SEARCH_POINTER 1
+#define SEARCH_PROXY 2
+// stage of a range scan that copies one proxy node per step
+#define SCAN_PROXIES 3
+
+// Bump-allocates size bytes from the current chunk, a full chunk is replaced
+// by a new one of CSSL_CHUNK_SIZE bytes from resource
+static void *allocateFromChunks(_CSSL_NodeChunks *chunks, std::pmr::memory_resource *resource, size_t size, size_t alignment)
+{
+  uintptr_t address = ((uintptr_t)chunks->cursor + alignment - 1) & ~(uintptr_t)(alignment - 1);
+  if (chunks->cursor == NULL || address + size > (uintptr_t)chunks->end)
+  {
+    char *chunk = reinterpret_cast<char *>(resource->allocate(CSSL_CHUNK_SIZE, CSSL_CACHE_LINE_SIZE));
+    *reinterpret_cast<void **>(chunk) = chunks->last_chunk;
+    chunks->last_chunk = chunk;
+    chunks->end = chunk + CSSL_CHUNK_SIZE;
+    // the first cache line holds the link to the previous chunk
+    address = (uintptr_t)chunk + CSSL_CACHE_LINE_SIZE;
+  }
+  chunks->cursor = reinterpret_cast<char *>(address + size);
+  return reinterpret_cast<void *>(address);
+}
+
+// Returns all chunks to resource, freeing the nodes allocated from them
+void freeChunks(_CSSL_NodeChunks *chunks, std::pmr::memory_resource *resource)
+{
+  while (chunks->last_chunk != NULL)
+  {
+    void *previous = *reinterpret_cast<void **>(chunks->last_chunk);
+    resource->deallocate(chunks->last_chunk, CSSL_CHUNK_SIZE, CSSL_CACHE_LINE_SIZE);
+    chunks->last_chunk = previous;
+  }
+  chunks->cursor = NULL;
+  chunks->end = NULL;
+}
 
 // Creates a new skip list
-_CSSL_SkipList *createSkipList(uint8_t maxLevel, uint8_t skip)
+_CSSL_SkipList *createSkipList(uint8_t maxLevel, uint8_t skip, std::pmr::memory_resource *resource)
 {
   _CSSL_SkipList *slist = reinterpret_cast<_CSSL_SkipList *>(malloc(sizeof(*slist)));
+  slist->resource = resource;
+  slist->node_chunks = {NULL, NULL, NULL};
+  slist->proxy_chunks = {NULL, NULL, NULL};
 
   slist->max_level = maxLevel;
   slist->num_elements = 0;
-  slist->head = reinterpret_cast<_CSSL_DataNode *>(newNode(0));
+  slist->head = newNode(0, &slist->node_chunks, resource);
   slist->tail = slist->head;
   slist->skip = skip > 1 ? skip : 2;
   slist->sqr_skip = slist->skip * slist->skip;
@@ -44,7 +88,8 @@ _CSSL_SkipList *createSkipList(uint8_t maxLevel, uint8_t skip)
 // Creates a new proxy node in the given skip list
 _CSSL_ProxyNode *newProxyNode(_CSSL_SkipList *slist, _CSSL_DataNode *node)
 {
-  _CSSL_ProxyNode *proxy = reinterpret_cast<_CSSL_ProxyNode *>(malloc(sizeof(*proxy)));
+  _CSSL_ProxyNode *proxy = reinterpret_cast<_CSSL_ProxyNode *>(
+      allocateFromChunks(&slist->proxy_chunks, slist->resource, sizeof(*proxy), alignof(_CSSL_ProxyNode)));
   proxy->keys[0] = node->key;
   proxy->updated = false;
 
@@ -74,14 +119,22 @@ void findAndInsertIntoProxyNode(_CSSL_SkipList *slist, _CSSL_DataNode *node)
 // Inserts a new element into the given skip list (bulk insert)
 void insertElement(_CSSL_SkipList *slist, uint32_t key)
 {
-  _CSSL_DataNode *new_node = newNode(key);
-  bool nodeInserted = true;
-  bool flaneInserted = false;
+  _CSSL_DataNode *new_node = newNode(key, &slist->node_chunks, slist->resource);
 
   // add new node at the end of the data list
   slist->tail->next = (struct _CSSL_DataNode *)new_node;
   slist->tail = new_node;
 
+  appendToFastLanes(slist, new_node);
+}
+
+// Adds a node with a key larger than all keys on the fast lanes to the fast
+// lanes and proxy nodes, without linking it into the data list
+void appendToFastLanes(_CSSL_SkipList *slist, _CSSL_DataNode *new_node)
+{
+  bool nodeInserted = true;
+  bool flaneInserted = false;
+
   // add key to fast lanes
   for (uint8_t level = 0; level < slist->max_level; level++)
   {
@@ -150,7 +203,6 @@ void buildFastLanes(_CSSL_SkipList *slist)
                                      slist->items_per_level[level + 1];
 
     flane_size += slist->items_per_level[level];
-    printf("%i:%i", level, flane_size);
   }
 
   slist->flanes = reinterpret_cast<uint32_t *>(malloc(sizeof(uint32_t) * flane_size));
@@ -209,33 +261,27 @@ void resizeFastLanes(_CSSL_SkipList *slist)
   slist->starts_of_flanes = level_starts;
 }
 
-// Single-key lookup on a given skip list
-uint32_t searchElement(_CSSL_SkipList *slist, uint32_t key)
+// Position of the last key <= key in the (cached) highest fast lane, compared
+// SIMD_SEGMENTS keys at a time. The first key of the list is on every lane.
+static inline uint32_t searchTopLane(_CSSL_SkipList *slist, uint32_t key)
 {
-  uint32_t curPos = 0;
-  uint32_t first = 0;
-  uint32_t last = slist->items_per_level[slist->max_level - 1] - 1;
-  uint32_t middle = 0;
-  // scan highest fast lane with binary search
-  while (first < last)
+  uint32_t items = slist->items_per_level[slist->max_level - 1];
+  uint32_t count = 0;
+  for (uint32_t pos = 0; pos < items; pos += SIMD_SEGMENTS)
   {
-    middle = (first + last) / 2;
-    if (slist->flanes[middle] < key)
-    {
-      first = middle + 1;
-    }
-    else if (slist->flanes[middle] == key)
-    {
-      curPos = middle;
+    uint32_t mask = flaneMaskLessEqual(&slist->flanes[pos], key);
+    count += __builtin_popcount(mask);
+    if (mask != SIMD_FULL_MASK)
       break;
-    }
-    else
-    {
-      last = middle;
-    }
   }
-  if (first > last)
-    curPos = last;
+  return count > 0 ? count - 1 : 0;
+}
+
+// Single-key lookup on a given skip list
+uint32_t searchElement(_CSSL_SkipList *slist, uint32_t key)
+{
+  // scan highest fast lane with the SIMD kernel
+  uint32_t curPos = searchTopLane(slist, key);
   int level;
   // traverse over fast lanes
   for (level = slist->max_level - 1; level >= 0; level--)
@@ -264,30 +310,8 @@ uint32_t searchElement(_CSSL_SkipList *slist, uint32_t key)
 
 uint32_t searchElementPrefetched(_CSSL_SkipList *slist, uint32_t key)
 {
-  uint32_t curPos = 0;
-  uint32_t first = 0;
-  uint32_t last = slist->items_per_level[slist->max_level - 1] - 1;
-  uint32_t middle = 0;
-  // scan highest fast lane with binary search
-  while (first < last)
-  {
-    middle = (first + last) / 2;
-    if (slist->flanes[middle] < key)
-    {
-      first = middle + 1;
-    }
-    else if (slist->flanes[middle] == key)
-    {
-      curPos = middle;
-      break;
-    }
-    else
-    {
-      last = middle;
-    }
-  }
-  if (first > last)
-    curPos = last;
+  // scan highest fast lane with the SIMD kernel
+  uint32_t curPos = searchTopLane(slist, key);
   int level;
   // traverse over fast lanes
   // for (level = slist->max_level - 1; level >= 0; level--)
@@ -390,44 +414,205 @@ uint32_t searchElementPrefetched(_CSSL_SkipList *slist, uint32_t key)
   return INT_MAX;
 }
 
-// Range query on a given skip list using range boundaries startKey and endKey
-_CSSL_RangeSearchResult searchRange(_CSSL_SkipList *slist, uint32_t startKey, uint32_t endKey)
+// Starts an interleaved lookup: SIMD scan of the (cached) highest fast lane,
+// then prefetch the part of it that the first lane step scans
+void startSearch(_CSSL_SkipList *slist, _CSSL_SearchState *state, uint32_t key)
 {
-  // use the cache to determine the section of the first fast lane that
-  // should be used as starting position for search
-  _CSSL_RangeSearchResult result;
-#if defined(AARCH64)
-  // TODO: handle searchRange on AARCH64
-  throw std::runtime_error("SearchRange not implemented on AARCH64!");
-  return result;
-#else
-  __m256 avx_creg, res, avx_sreg;
-  int level, bitmask;
-  uint32_t curPos = 0;
-  uint32_t rPos = 0;
-  uint32_t first = 0;
-  uint32_t last = slist->items_per_level[slist->max_level - 1] - 1;
-  uint32_t middle = 0;
-  // scan highest fast lane with binary search
-  while (first < last)
-  {
-    middle = (first + last) / 2;
-    if (slist->flanes[middle] < startKey)
+  uint32_t curPos = searchTopLane(slist, key);
+
+  state->key = key;
+  state->curPos = curPos;
+  state->level = slist->max_level - 1;
+  state->stage = SEARCH_LANE;
+  prefetch<T0>(slist->flanes + curPos + 1);
+}
+
+// Advances an interleaved lookup by one dependent access and prefetches the
+// next one. Returns true once the lookup finished and wrote its result.
+bool stepSearch(_CSSL_SkipList *slist, _CSSL_SearchState *state, uint32_t *result)
+{
+  uint32_t key = state->key;
+  switch (state->stage)
+  {
+  case SEARCH_LANE:
+  {
+    uint32_t curPos = state->curPos;
+    uint32_t rPos = curPos - slist->starts_of_flanes[state->level];
+    while (rPos < slist->items_per_level[state->level] &&
+           key >= slist->flanes[++curPos])
+      rPos++;
+    if (state->level > 0)
     {
-      first = middle + 1;
+      // descend and prefetch the keys the next lane step compares against
+      state->level--;
+      curPos = slist->starts_of_flanes[state->level] + rPos * slist->skip;
+      state->curPos = curPos;
+      prefetch<T0>(slist->flanes + curPos + 1);
+      prefetch<T0>(slist->flanes + curPos + slist->skip);
+      return false;
     }
-    else if (slist->flanes[middle] == startKey)
+    state->curPos = --curPos;
+    if (key == slist->flanes[curPos])
     {
-      curPos = middle;
-      break;
+      *result = key;
+      return true;
     }
-    else
+    prefetch<T0>(slist->flane_pointers + (curPos - slist->starts_of_flanes[0]));
+    state->stage = SEARCH_POINTER;
+    return false;
+  }
+  case SEARCH_POINTER:
+    prefetch<T0>(slist->flane_pointers[state->curPos - slist->starts_of_flanes[0]]);
+    state->stage = SEARCH_PROXY;
+    return false;
+  default:
+  {
+    _CSSL_ProxyNode *proxy = slist->flane_pointers[state->curPos - slist->starts_of_flanes[0]];
+    *result = INT_MAX;
+    for (uint8_t i = 1; i < slist->skip; i++)
+    {
+      if (proxy->keys[i] == key)
+      {
+        *result = key;
+        break;
+      }
+    }
+    return true;
+  }
+  }
+}
+
+// Group prefetching: all lookups of the batch advance one step per round
+void searchElementsGP(_CSSL_SkipList *slist, const uint32_t *keys, uint32_t *results, uint32_t count)
+{
+  std::vector<_CSSL_SearchState> states(count);
+  std::vector<uint32_t> active(count);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    startSearch(slist, &states[i], keys[i]);
+    active[i] = i;
+  }
+
+  uint32_t num_active = count;
+  while (num_active > 0)
+  {
+    uint32_t still_active = 0;
+    for (uint32_t a = 0; a < num_active; a++)
+    {
+      uint32_t i = active[a];
+      if (!stepSearch(slist, &states[i], &results[i]))
+        active[still_active++] = i;
+    }
+    num_active = still_active;
+  }
+}
+
+// AMAC: group_size lookups in flight, a finished lookup is replaced by the next key
+void searchElementsAMAC(_CSSL_SkipList *slist, const uint32_t *keys, uint32_t *results, uint32_t count, uint32_t group_size)
+{
+  if (count == 0)
+    return;
+  // a group size of 0 still interleaves one lookup
+  group_size = std::max(1u, std::min(group_size, count));
+  std::vector<_CSSL_SearchState> states(group_size);
+  std::vector<uint32_t> indices(group_size);
+  uint32_t next = 0;
+  for (; next < group_size; next++)
+  {
+    startSearch(slist, &states[next], keys[next]);
+    indices[next] = next;
+  }
+
+  uint32_t num_finished = 0;
+  uint32_t slot = 0;
+  while (num_finished < count)
+  {
+    if (indices[slot] != UINT32_MAX &&
+        stepSearch(slist, &states[slot], &results[indices[slot]]))
     {
-      last = middle;
+      num_finished++;
+      if (next < count)
+      {
+        startSearch(slist, &states[slot], keys[next]);
+        indices[slot] = next++;
+      }
+      else
+      {
+        indices[slot] = UINT32_MAX;
+      }
     }
+    slot = (slot + 1) == group_size ? 0 : slot + 1;
   }
-  if (first > last)
-    curPos = last;
+}
+
+coroutine searchElementCo(_CSSL_SkipList *slist, uint32_t key, uint32_t *result)
+{
+  _CSSL_SearchState state;
+  startSearch(slist, &state, key);
+  do
+  {
+    co_await std::suspend_always{};
+  } while (!stepSearch(slist, &state, result));
+}
+
+void searchElementsCoroutine(_CSSL_SkipList *slist, const uint32_t *keys, uint32_t *results, uint32_t count, uint32_t group_size)
+{
+  // a group size of 0 still interleaves one lookup
+  group_size = std::max(1u, std::min(group_size, count));
+  CircularBuffer<std::coroutine_handle<promise>> buff(group_size);
+
+  uint32_t num_finished = 0;
+  uint32_t i = 0;
+
+  while (num_finished < count)
+  {
+    std::coroutine_handle<promise> &handle = buff.next_state();
+    if (!handle)
+    {
+      if (i < group_size)
+      {
+        handle = searchElementCo(slist, keys[i], &results[i]);
+        i++;
+      }
+      continue;
+    }
+
+    if (handle.done())
+    {
+      num_finished++;
+      handle.destroy();
+      if (i < count)
+      {
+        handle = searchElementCo(slist, keys[i], &results[i]);
+        ++i;
+      }
+      else
+      {
+        handle = nullptr;
+        continue;
+      }
+    }
+
+    handle.resume();
+  }
+}
+
+// Range query on a given skip list using range boundaries startKey and endKey
+_CSSL_RangeSearchResult searchRange(_CSSL_SkipList *slist, uint32_t startKey, uint32_t endKey)
+{
+  // use the cache to determine the section of the first fast lane that
+  // should be used as starting position for search
+  _CSSL_RangeSearchResult result = {NULL, NULL, 0};
+  // the first key of the lowest fast lane is the smallest key of the list, no
+  // proxy node covers a range that ends before it
+  if (slist->flane_items[0] == 0 || endKey < startKey ||
+      endKey < slist->flanes[slist->starts_of_flanes[0]])
+    return result;
+
+  int level;
+  uint32_t rPos = 0;
+  // scan highest fast lane with the SIMD kernel
+  uint32_t curPos = searchTopLane(slist, startKey);
 
   for (level = slist->max_level - 1; level >= 0; level--)
   {
@@ -447,8 +632,6 @@ _CSSL_RangeSearchResult searchRange(_CSSL_SkipList *slist, uint32_t startKey, ui
     curPos--;
   }
 
-  result.count = 0;
-
   _CSSL_ProxyNode *proxy = slist->flane_pointers[curPos - slist->starts_of_flanes[0]];
   result.start = (_CSSL_DataNode *)proxy->pointers[slist->skip - 1]->next;
   for (uint8_t i = 0; i < slist->skip; i++)
@@ -461,16 +644,11 @@ _CSSL_RangeSearchResult searchRange(_CSSL_SkipList *slist, uint32_t startKey, ui
   }
 
   // search for the range's last matching node
-  avx_sreg = _mm256_castsi256_ps(_mm256_set1_epi32(endKey));
   uint32_t itemsInFlane = slist->items_per_level[0] - SIMD_SEGMENTS;
   rPos = curPos - start_of_flane;
   while (rPos < itemsInFlane)
   {
-    avx_creg = _mm256_castsi256_ps(
-        _mm256_loadu_si256((__m256i const *)&slist->flanes[curPos]));
-    res = _mm256_cmp_ps(avx_sreg, avx_creg, 30);
-    bitmask = _mm256_movemask_ps(res);
-    if (bitmask < 0xff)
+    if (flaneMaskLessEqual(&slist->flanes[curPos], endKey) != SIMD_FULL_MASK)
       break;
     curPos += SIMD_SEGMENTS;
     rPos += SIMD_SEGMENTS;
@@ -480,8 +658,11 @@ _CSSL_RangeSearchResult searchRange(_CSSL_SkipList *slist, uint32_t startKey, ui
   rPos--;
   itemsInFlane += SIMD_SEGMENTS;
 
-  while (endKey >= slist->flanes[++curPos] && rPos < itemsInFlane)
+  // rPos wraps around if the kernel stopped at the first key, so test the
+  // bound on rPos + 1 before reading the next key
+  while (rPos + 1 < itemsInFlane && endKey >= slist->flanes[curPos + 1])
   {
+    curPos++;
     rPos++;
   }
 
@@ -497,13 +678,368 @@ _CSSL_RangeSearchResult searchRange(_CSSL_SkipList *slist, uint32_t startKey, ui
   }
 
   return result;
-#endif
 }
 
-// Creates a new node
-_CSSL_DataNode *newNode(uint32_t key)
+// Starts a range scan: the fast lanes are descended as by an interleaved
+// lookup for startKey, one lane per step
+void startRangeScan(_CSSL_SkipList *slist, _CSSL_RangeState *state, uint32_t startKey, uint32_t endKey, uint32_t *buffer, uint32_t capacity)
+{
+  uint32_t curPos = searchTopLane(slist, startKey);
+
+  state->startKey = startKey;
+  state->endKey = endKey;
+  state->curPos = curPos;
+  state->level = slist->max_level - 1;
+  state->stage = SEARCH_LANE;
+  state->buffer = buffer;
+  state->capacity = capacity;
+  state->count = 0;
+  prefetch<T0>(slist->flanes + curPos + 1);
+}
+
+// Prefetches the proxy node at index pos if its first key is in the range
+static inline void prefetchRangeProxy(_CSSL_SkipList *slist, _CSSL_RangeState *state, uint32_t pos)
+{
+  if (pos < slist->flane_items[0] &&
+      slist->flanes[slist->starts_of_flanes[0] + pos] <= state->endKey)
+    prefetch<T0>(slist->flane_pointers[pos]);
+}
+
+// Prefetches the data nodes of the proxy node at index pos that are in the range
+static inline void prefetchRangeNodes(_CSSL_SkipList *slist, _CSSL_RangeState *state, uint32_t pos)
+{
+  if (pos >= slist->flane_items[0] ||
+      slist->flanes[slist->starts_of_flanes[0] + pos] > state->endKey)
+    return;
+  _CSSL_ProxyNode *proxy = slist->flane_pointers[pos];
+  for (uint8_t i = 0; i < slist->skip && proxy->keys[i] <= state->endKey; i++)
+    prefetch<T0>(proxy->pointers[i]);
+}
+
+// Advances a range scan by one lane or one proxy node. While scanning, the
+// proxy nodes 2 * RANGE_PREFETCH_DISTANCE ahead and the data nodes of the
+// proxy nodes RANGE_PREFETCH_DISTANCE ahead are prefetched, so the data
+// nodes are not reached one dependent miss at a time. Returns true once the
+// range is exhausted or the buffer is full.
+bool stepRangeScan(_CSSL_SkipList *slist, _CSSL_RangeState *state)
+{
+  if (state->stage == SEARCH_LANE)
+  {
+    uint32_t curPos = state->curPos;
+    uint32_t rPos = curPos - slist->starts_of_flanes[state->level];
+    while (rPos < slist->items_per_level[state->level] &&
+           state->startKey >= slist->flanes[++curPos])
+      rPos++;
+    if (state->level > 0)
+    {
+      state->level--;
+      curPos = slist->starts_of_flanes[state->level] + rPos * slist->skip;
+      state->curPos = curPos;
+      prefetch<T0>(slist->flanes + curPos + 1);
+      prefetch<T0>(slist->flanes + curPos + slist->skip);
+      return false;
+    }
+    // the last proxy node with a first key <= startKey, or the first one
+    uint32_t pos = curPos - 1 - slist->starts_of_flanes[0];
+    state->curPos = pos;
+    state->stage = SCAN_PROXIES;
+    for (uint32_t i = 0; i < 2 * RANGE_PREFETCH_DISTANCE; i++)
+      prefetchRangeProxy(slist, state, pos + i);
+    for (uint32_t i = 0; i < RANGE_PREFETCH_DISTANCE; i++)
+      prefetchRangeNodes(slist, state, pos + i);
+    return false;
+  }
+
+  uint32_t pos = state->curPos;
+  if (pos >= slist->flane_items[0])
+    return true;
+  prefetchRangeProxy(slist, state, pos + 2 * RANGE_PREFETCH_DISTANCE);
+  prefetchRangeNodes(slist, state, pos + RANGE_PREFETCH_DISTANCE);
+
+  _CSSL_ProxyNode *proxy = slist->flane_pointers[pos];
+  for (uint8_t i = 0; i < slist->skip; i++)
+  {
+    // empty slots of the last proxy node hold INT_MAX
+    if (proxy->keys[i] > state->endKey)
+      return true;
+    if (proxy->keys[i] >= state->startKey)
+    {
+      if (state->count == state->capacity)
+        return true;
+      state->buffer[state->count++] = proxy->pointers[i]->key;
+    }
+  }
+  state->curPos = pos + 1;
+  return false;
+}
+
+// Range query that copies the keys of [startKey, endKey] in ascending order
+// into buffer, returns the number of copied keys (at most capacity)
+uint32_t scanRange(_CSSL_SkipList *slist, uint32_t startKey, uint32_t endKey, uint32_t *buffer, uint32_t capacity)
+{
+  _CSSL_RangeState state;
+  startRangeScan(slist, &state, startKey, endKey, buffer, capacity);
+  while (!stepRangeScan(slist, &state))
+    ;
+  return state.count;
+}
+
+// AMAC range scans: group_size scans in flight, each advancing one lane or
+// one proxy node per turn. Range i is copied to buffer + i * capacity and
+// its number of keys is written to counts[i].
+void scanRangesAMAC(_CSSL_SkipList *slist, const uint32_t *startKeys, const uint32_t *endKeys, uint32_t count, uint32_t *buffer, uint32_t capacity, uint32_t *counts, uint32_t group_size)
+{
+  if (count == 0)
+    return;
+  // a group size of 0 still interleaves one scan
+  group_size = std::max(1u, std::min(group_size, count));
+  std::vector<_CSSL_RangeState> states(group_size);
+  std::vector<uint32_t> indices(group_size);
+  uint32_t next = 0;
+  for (; next < group_size; next++)
+  {
+    startRangeScan(slist, &states[next], startKeys[next], endKeys[next],
+                   buffer + (size_t)next * capacity, capacity);
+    indices[next] = next;
+  }
+
+  uint32_t num_finished = 0;
+  uint32_t slot = 0;
+  while (num_finished < count)
+  {
+    if (indices[slot] != UINT32_MAX && stepRangeScan(slist, &states[slot]))
+    {
+      counts[indices[slot]] = states[slot].count;
+      num_finished++;
+      if (next < count)
+      {
+        startRangeScan(slist, &states[slot], startKeys[next], endKeys[next],
+                       buffer + (size_t)next * capacity, capacity);
+        indices[slot] = next++;
+      }
+      else
+      {
+        indices[slot] = UINT32_MAX;
+      }
+    }
+    slot = (slot + 1) == group_size ? 0 : slot + 1;
+  }
+}
+
+// Frees a skip list with its fast lanes and the nodes it allocated, data
+// nodes added with appendToFastLanes are owned by their creator
+void freeFastLanes(_CSSL_SkipList *slist)
+{
+  freeChunks(&slist->proxy_chunks, slist->resource);
+  freeChunks(&slist->node_chunks, slist->resource);
+  free(slist->flanes);
+  free(slist->flane_pointers);
+  free(slist->items_per_level);
+  free(slist->starts_of_flanes);
+  free(slist->flane_items);
+  free(slist);
+}
+
+static void rebuildFastLanes(_CSSL_ConcurrentSkipList *clist);
+
+// Background thread of a concurrent skip list: rebuilds the fast lanes once
+// rebuild_threshold inserts are not covered by the published lanes
+static void runFastLaneBuilder(_CSSL_ConcurrentSkipList *clist)
+{
+  while (!__atomic_load_n(&clist->stop, __ATOMIC_ACQUIRE))
+  {
+    if (__atomic_load_n(&clist->pending_inserts, __ATOMIC_RELAXED) >= clist->rebuild_threshold)
+      rebuildFastLanes(clist);
+    else
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+}
+
+// Creates a new skip list that supports concurrent inserts
+_CSSL_ConcurrentSkipList *createConcurrentSkipList(uint8_t maxLevel, uint8_t skip, uint32_t rebuildThreshold, std::pmr::memory_resource *resource)
+{
+  _CSSL_ConcurrentSkipList *clist = new _CSSL_ConcurrentSkipList;
+
+  clist->max_level = maxLevel;
+  clist->skip = skip > 1 ? skip : 2;
+  clist->resource = resource;
+  clist->node_chunks = {NULL, NULL, NULL};
+  clist->head = newNode(0, &clist->node_chunks, resource);
+  clist->lanes = createSkipList(1, clist->skip, resource);
+  clist->num_elements = 0;
+  clist->pending_inserts = 0;
+  clist->rebuild_threshold = rebuildThreshold > 0 ? rebuildThreshold : 1;
+  clist->stop = false;
+  clist->epoch = 0;
+  clist->readers[0] = 0;
+  clist->readers[1] = 0;
+  clist->builder = new std::thread(runFastLaneBuilder, clist);
+
+  return clist;
+}
+
+// Stops the builder and frees the skip list, no thread may use it anymore
+void destroyConcurrentSkipList(_CSSL_ConcurrentSkipList *clist)
+{
+  __atomic_store_n(&clist->stop, true, __ATOMIC_RELEASE);
+  clist->builder->join();
+  delete clist->builder;
+
+  freeFastLanes(clist->lanes);
+  freeChunks(&clist->node_chunks, clist->resource);
+  delete clist;
+}
+
+// Returns the published fast lanes, which stay valid until releaseFastLanes
+// is called with the returned epoch
+_CSSL_SkipList *acquireFastLanes(_CSSL_ConcurrentSkipList *clist, uint32_t *epoch)
+{
+  while (true)
+  {
+    uint32_t e = __atomic_load_n(&clist->epoch, __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&clist->readers[e & 1], 1, __ATOMIC_SEQ_CST);
+    // a reader that registered after the builder moved on to the next epoch
+    // is not waited for, so it must retry in the new epoch
+    if (__atomic_load_n(&clist->epoch, __ATOMIC_SEQ_CST) == e)
+    {
+      *epoch = e;
+      return __atomic_load_n(&clist->lanes, __ATOMIC_SEQ_CST);
+    }
+    __atomic_fetch_sub(&clist->readers[e & 1], 1, __ATOMIC_SEQ_CST);
+  }
+}
+
+void releaseFastLanes(_CSSL_ConcurrentSkipList *clist, uint32_t epoch)
+{
+  __atomic_fetch_sub(&clist->readers[epoch & 1], 1, __ATOMIC_RELEASE);
+}
+
+// Builds new fast lanes over the current data list and publishes them. The
+// replaced lanes are freed once all readers that may still use them released
+// them. Inserts that race with the data list walk count towards the next
+// rebuild, lookups find them on the data list until then. Only the builder
+// thread rebuilds, the epochs assume a single writer of the lanes.
+static void rebuildFastLanes(_CSSL_ConcurrentSkipList *clist)
+{
+  __atomic_store_n(&clist->pending_inserts, 0, __ATOMIC_SEQ_CST);
+
+  // as few levels as cover the current elements with a top lane of at most
+  // TOP_LANE_BLOCK keys, the lanes are rebuilt before they grow much
+  uint32_t num_elements = __atomic_load_n(&clist->num_elements, __ATOMIC_RELAXED);
+  uint8_t levels = 1;
+  for (uint64_t covered = TOP_LANE_BLOCK * clist->skip;
+       levels < clist->max_level && covered < num_elements; covered *= clist->skip)
+    levels++;
+
+  _CSSL_SkipList *lanes = createSkipList(levels, clist->skip, clist->resource);
+  _CSSL_DataNode *node = __atomic_load_n(&clist->head->next, __ATOMIC_ACQUIRE);
+  while (node != NULL)
+  {
+    appendToFastLanes(lanes, node);
+    node = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+  }
+
+  _CSSL_SkipList *old_lanes = __atomic_exchange_n(&clist->lanes, lanes, __ATOMIC_SEQ_CST);
+  uint32_t e = __atomic_fetch_add(&clist->epoch, 1, __ATOMIC_SEQ_CST);
+  while (__atomic_load_n(&clist->readers[e & 1], __ATOMIC_ACQUIRE) > 0)
+    std::this_thread::yield();
+  freeFastLanes(old_lanes);
+}
+
+// Finds the data node with the largest key < key that the fast lanes know,
+// or the head. Sets found if a proxy node holds key.
+static _CSSL_DataNode *findPredecessor(_CSSL_ConcurrentSkipList *clist, _CSSL_SkipList *lanes, uint32_t key, bool *found)
+{
+  _CSSL_DataNode *pred = clist->head;
+  *found = false;
+  if (lanes->flane_items[0] == 0)
+    return pred;
+
+  // snapshots are sized to their elements, so a lane may be full and each
+  // lane is bounded by its number of keys rather than its capacity
+  uint32_t rPos = searchTopLane(lanes, key);
+  for (int level = lanes->max_level - 1; level >= 0; level--)
+  {
+    uint32_t *lane = lanes->flanes + lanes->starts_of_flanes[level];
+    while (rPos + 1 < lanes->flane_items[level] && key >= lane[rPos + 1])
+      rPos++;
+    if (level > 0)
+      rPos *= lanes->skip;
+  }
+
+  _CSSL_ProxyNode *proxy = lanes->flane_pointers[rPos];
+  for (uint8_t i = 0; i < lanes->skip && proxy->keys[i] <= key; i++)
+  {
+    if (proxy->keys[i] == key)
+    {
+      *found = true;
+      break;
+    }
+    pred = proxy->pointers[i];
+  }
+  return pred;
+}
+
+// Inserts key into the data list with CAS on the predecessor's next pointer,
+// in any key order and concurrently with other inserts and lookups. Returns
+// false if key is already in the list.
+bool insertElementConcurrent(_CSSL_ConcurrentSkipList *clist, uint32_t key)
+{
+  uint32_t epoch;
+  _CSSL_SkipList *lanes = acquireFastLanes(clist, &epoch);
+  bool found;
+  _CSSL_DataNode *pred = findPredecessor(clist, lanes, key, &found);
+  releaseFastLanes(clist, epoch);
+  if (found)
+    return false;
+
+  // data nodes are never removed, so pred stays valid without the lanes
+  _CSSL_DataNode *node;
+  {
+    std::lock_guard<std::mutex> lock(clist->chunk_lock);
+    node = newNode(key, &clist->node_chunks, clist->resource);
+  }
+  while (true)
+  {
+    _CSSL_DataNode *next = __atomic_load_n(&pred->next, __ATOMIC_ACQUIRE);
+    while (next != NULL && next->key < key)
+    {
+      pred = next;
+      next = __atomic_load_n(&pred->next, __ATOMIC_ACQUIRE);
+    }
+    // the unused node stays in its chunk until the list is destroyed
+    if (next != NULL && next->key == key)
+      return false;
+    node->next = next;
+    if (__atomic_compare_exchange_n(&pred->next, &next, node, false,
+                                    __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+      break;
+  }
+  __atomic_fetch_add(&clist->num_elements, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&clist->pending_inserts, 1, __ATOMIC_RELAXED);
+  return true;
+}
+
+// Single-key lookup on acquired fast lanes, keys inserted after the lanes
+// were built are found on the data list behind their proxy node
+uint32_t searchElementConcurrent(_CSSL_ConcurrentSkipList *clist, _CSSL_SkipList *lanes, uint32_t key)
+{
+  bool found;
+  _CSSL_DataNode *node = findPredecessor(clist, lanes, key, &found);
+  if (found)
+    return key;
+
+  node = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+  while (node != NULL && node->key < key)
+    node = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+  return (node != NULL && node->key == key) ? key : INT_MAX;
+}
+
+// Creates a new node in the given chunks
+_CSSL_DataNode *newNode(uint32_t key, _CSSL_NodeChunks *chunks, std::pmr::memory_resource *resource)
 {
-  _CSSL_DataNode *node = reinterpret_cast<_CSSL_DataNode *>(malloc(sizeof(*node)));
+  _CSSL_DataNode *node = reinterpret_cast<_CSSL_DataNode *>(
+      allocateFromChunks(chunks, resource, sizeof(*node), alignof(_CSSL_DataNode)));
   node->key = key;
   node->next = NULL;
 
@@ -18,11 +18,11 @@
 #define __CSSL_SkipList_H
 
 #define MAX_SKIP 5
-// initial size of the highest fast lane with number
-// of keys that fit into one cache line
-#define TOP_LANE_BLOCK 16
-// number of keys that can be stored in one SIMD register
-#define SIMD_SEGMENTS 8
+// number of proxy nodes whose data nodes a range scan prefetches ahead,
+// the proxy nodes themselves are prefetched twice as far ahead
+#define RANGE_PREFETCH_DISTANCE 4
+// data and proxy nodes are bump-allocated in chunks of one huge page
+#define CSSL_CHUNK_SIZE (2 * 1024 * 1024)
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -33,11 +33,13 @@
 #include <limits.h>
 #include <math.h>
 
-#if defined(X86_64)
-#include <immintrin.h>
-#endif
+#include <memory_resource>
+#include <mutex>
+#include <thread>
 
+#include "cssl_simd.hpp"
 #include "utils/utils.hpp"
+#include "coroutine.hpp"
 
 // data list node
 typedef struct _CSSL_DataNode
@@ -54,6 +56,16 @@ typedef struct _CSSL_ProxyNode
   bool updated;
 } _CSSL_ProxyNode;
 
+// chunks of a memory resource that nodes of one kind are bump-allocated from,
+// nodes allocated in key order are contiguous and key-ordered in memory
+typedef struct _CSSL_NodeChunks
+{
+  char *cursor;
+  char *end;
+  // chunks are linked through their first bytes
+  void *last_chunk;
+} _CSSL_NodeChunks;
+
 typedef struct _CSSL_SkipList
 {
   uint8_t max_level;
@@ -66,8 +78,61 @@ typedef struct _CSSL_SkipList
   _CSSL_ProxyNode **flane_pointers;
   _CSSL_DataNode *head, *tail;
   uint8_t sqr_skip;
+  std::pmr::memory_resource *resource;
+  _CSSL_NodeChunks node_chunks;
+  _CSSL_NodeChunks proxy_chunks;
 } _CSSL_SkipList;
 
+// state of an interleaved single-key lookup, advanced one lane at a time
+typedef struct _CSSL_SearchState
+{
+  uint32_t key;
+  uint32_t curPos;
+  int level;
+  uint8_t stage;
+} _CSSL_SearchState;
+
+// state of a range scan that copies the keys of [startKey, endKey] into buffer
+typedef struct _CSSL_RangeState
+{
+  uint32_t startKey;
+  uint32_t endKey;
+  // flane position while descending, proxy index while scanning
+  uint32_t curPos;
+  int level;
+  uint8_t stage;
+  uint32_t *buffer;
+  uint32_t capacity;
+  uint32_t count;
+} _CSSL_RangeState;
+
+// skip list with concurrent inserts: the data list is linked with CAS on next,
+// the fast lanes are immutable snapshots over it that a background thread
+// rebuilds and publishes atomically
+typedef struct _CSSL_ConcurrentSkipList
+{
+  uint8_t max_level;
+  uint8_t skip;
+  // sentinel node, never on a fast lane
+  _CSSL_DataNode *head;
+  // published fast lanes, may miss the latest inserts
+  _CSSL_SkipList *lanes;
+  uint32_t num_elements;
+  // inserts since the builder started the published lanes
+  uint32_t pending_inserts;
+  uint32_t rebuild_threshold;
+  bool stop;
+  std::thread *builder;
+  // data nodes of concurrent inserts, allocated under chunk_lock
+  std::pmr::memory_resource *resource;
+  _CSSL_NodeChunks node_chunks;
+  std::mutex chunk_lock;
+  // readers register with the epoch they load the lanes in, the builder waits
+  // for the readers of the previous epoch before freeing replaced lanes
+  alignas(64) uint32_t epoch;
+  alignas(64) uint32_t readers[2];
+} _CSSL_ConcurrentSkipList;
+
 // result of a range query
 typedef struct _CSSL_RangeSearchResult
 {
@@ -76,7 +141,7 @@ typedef struct _CSSL_RangeSearchResult
   uint32_t count;
 } _CSSL_RangeSearchResult;
 
-_CSSL_SkipList *createSkipList(uint8_t maxLevel, uint8_t skip);
+_CSSL_SkipList *createSkipList(uint8_t maxLevel, uint8_t skip, std::pmr::memory_resource *resource = std::pmr::new_delete_resource());
 void insertElement(_CSSL_SkipList *slist, uint32_t key);
 uint32_t insertItemIntoFastLane(_CSSL_SkipList *slist,
                                 int8_t level,
@@ -85,6 +150,30 @@ void buildFastLanes(_CSSL_SkipList *slist);
 void resizeFastLanes(_CSSL_SkipList *slist);
 uint32_t searchElement(_CSSL_SkipList *slist, uint32_t key);
 uint32_t searchElementPrefetched(_CSSL_SkipList *slist, uint32_t key);
+// Batched lookups writing key on a hit and INT_MAX on a miss to results, interleaving the lookups and prefetching
+// every lane transition, the proxy pointer and the proxy node
+void startSearch(_CSSL_SkipList *slist, _CSSL_SearchState *state, uint32_t key);
+bool stepSearch(_CSSL_SkipList *slist, _CSSL_SearchState *state, uint32_t *result);
+void searchElementsGP(_CSSL_SkipList *slist, const uint32_t *keys, uint32_t *results, uint32_t count);
+void searchElementsAMAC(_CSSL_SkipList *slist, const uint32_t *keys, uint32_t *results, uint32_t count, uint32_t group_size);
+coroutine searchElementCo(_CSSL_SkipList *slist, uint32_t key, uint32_t *result);
+void searchElementsCoroutine(_CSSL_SkipList *slist, const uint32_t *keys, uint32_t *results, uint32_t count, uint32_t group_size);
 _CSSL_RangeSearchResult searchRange(_CSSL_SkipList *slist, uint32_t startKey, uint32_t endKey);
-_CSSL_DataNode *newNode(uint32_t key);
+void startRangeScan(_CSSL_SkipList *slist, _CSSL_RangeState *state, uint32_t startKey, uint32_t endKey, uint32_t *buffer, uint32_t capacity);
+bool stepRangeScan(_CSSL_SkipList *slist, _CSSL_RangeState *state);
+uint32_t scanRange(_CSSL_SkipList *slist, uint32_t startKey, uint32_t endKey, uint32_t *buffer, uint32_t capacity);
+void scanRangesAMAC(_CSSL_SkipList *slist, const uint32_t *startKeys, const uint32_t *endKeys, uint32_t count, uint32_t *buffer, uint32_t capacity, uint32_t *counts, uint32_t group_size);
+// Concurrent inserts with lookups on published fast lanes, lookups keep the
+// lanes they acquired until they release them
+_CSSL_ConcurrentSkipList *createConcurrentSkipList(uint8_t maxLevel, uint8_t skip, uint32_t rebuildThreshold, std::pmr::memory_resource *resource = std::pmr::new_delete_resource());
+void destroyConcurrentSkipList(_CSSL_ConcurrentSkipList *clist);
+bool insertElementConcurrent(_CSSL_ConcurrentSkipList *clist, uint32_t key);
+_CSSL_SkipList *acquireFastLanes(_CSSL_ConcurrentSkipList *clist, uint32_t *epoch);
+void releaseFastLanes(_CSSL_ConcurrentSkipList *clist, uint32_t epoch);
+uint32_t searchElementConcurrent(_CSSL_ConcurrentSkipList *clist, _CSSL_SkipList *lanes, uint32_t key);
+void appendToFastLanes(_CSSL_SkipList *slist, _CSSL_DataNode *node);
+void freeFastLanes(_CSSL_SkipList *slist);
+_CSSL_DataNode *newNode(uint32_t key, _CSSL_NodeChunks *chunks, std::pmr::memory_resource *resource);
+_CSSL_ProxyNode *newProxyNode(_CSSL_SkipList *slist, _CSSL_DataNode *node);
+void freeChunks(_CSSL_NodeChunks *chunks, std::pmr::memory_resource *resource);
 #endif
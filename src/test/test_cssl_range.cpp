@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "skiplist.hpp"
+
+const uint32_t NUM_KEYS = 10000;
+const uint32_t KEY_STRIDE = 10;
+const uint32_t FIRST_KEY = 100;
+
+// Walks the data list from the start to the end node of the range and compares it with the first num_keys keys in
+// [startKey, endKey].
+int check_range(_CSSL_SkipList *slist, uint32_t num_keys, uint32_t startKey, uint32_t endKey)
+{
+    _CSSL_RangeSearchResult result = searchRange(slist, startKey, endKey);
+    std::vector<uint32_t> expected;
+    for (uint32_t i = 0; i < num_keys; ++i)
+    {
+        const uint32_t key = FIRST_KEY + i * KEY_STRIDE;
+        if (key >= startKey && key <= endKey)
+        {
+            expected.push_back(key);
+        }
+    }
+
+    if (expected.empty())
+    {
+        if (result.count != 0 || result.start != NULL || result.end != NULL)
+        {
+            std::cerr << "[" << startKey << ", " << endKey << "]: expected an empty result" << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    std::vector<uint32_t> found;
+    for (_CSSL_DataNode *node = result.start; node != NULL; node = node->next)
+    {
+        found.push_back(node->key);
+        if (node == result.end)
+        {
+            break;
+        }
+    }
+    if (found != expected)
+    {
+        std::cerr << "[" << startKey << ", " << endKey << "]: found " << found.size() << " of " << expected.size() << " keys" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Compares the keys copied by scanRange with the keys in [startKey, endKey], truncated to capacity keys.
+int check_scan(_CSSL_SkipList *slist, const std::vector<uint32_t> &keys, uint32_t startKey, uint32_t endKey, uint32_t capacity)
+{
+    std::vector<uint32_t> expected;
+    if (startKey <= endKey)
+    {
+        auto first = std::lower_bound(keys.begin(), keys.end(), startKey);
+        auto last = std::upper_bound(keys.begin(), keys.end(), endKey);
+        expected.assign(first, first + std::min<size_t>(last - first, capacity));
+    }
+
+    std::vector<uint32_t> buffer(capacity);
+    const uint32_t count = scanRange(slist, startKey, endKey, buffer.data(), capacity);
+    buffer.resize(count);
+    if (buffer != expected)
+    {
+        std::cerr << "scan [" << startKey << ", " << endKey << "]: copied " << count << " of " << expected.size() << " keys" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Runs all ranges through scanRangesAMAC and compares each one with scanRange.
+int check_scans_amac(_CSSL_SkipList *slist, const std::vector<uint32_t> &startKeys, const std::vector<uint32_t> &endKeys, uint32_t capacity, uint32_t group_size)
+{
+    const uint32_t count = startKeys.size();
+    std::vector<uint32_t> buffer((size_t)count * capacity);
+    std::vector<uint32_t> counts(count);
+    scanRangesAMAC(slist, startKeys.data(), endKeys.data(), count, buffer.data(), capacity, counts.data(), group_size);
+
+    int failures = 0;
+    std::vector<uint32_t> expected(capacity);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const uint32_t expected_count = scanRange(slist, startKeys[i], endKeys[i], expected.data(), capacity);
+        if (counts[i] != expected_count || !std::equal(expected.begin(), expected.begin() + expected_count, buffer.begin() + (size_t)i * capacity))
+        {
+            std::cerr << "AMAC scan [" << startKeys[i] << ", " << endKeys[i] << "] with group size " << group_size << ": copied " << counts[i] << " of " << expected_count << " keys" << std::endl;
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+int main()
+{
+    _CSSL_SkipList *slist = createSkipList(5, 5);
+
+    int failures = 0;
+
+    // --- Test 1 -> Ranges on an empty list ---
+    std::cout << "--- Test 1 ---" << std::endl;
+    failures += check_range(slist, 0, 0, 1000);
+    const std::vector<uint32_t> no_keys;
+    failures += check_scan(slist, no_keys, 0, 1000, 16);
+    failures += check_scans_amac(slist, {0, 500}, {1000, 100}, 16, 4);
+
+    std::vector<uint32_t> keys;
+    for (uint32_t i = 0; i < NUM_KEYS; ++i)
+    {
+        insertElement(slist, FIRST_KEY + i * KEY_STRIDE);
+        keys.push_back(FIRST_KEY + i * KEY_STRIDE);
+    }
+
+    // --- Test 2 -> Ranges that end before the smallest key or are inverted ---
+    std::cout << "--- Test 2 ---" << std::endl;
+    failures += check_range(slist, NUM_KEYS, 0, 0);
+    failures += check_range(slist, NUM_KEYS, 0, FIRST_KEY - 1);
+    failures += check_range(slist, NUM_KEYS, FIRST_KEY - 50, FIRST_KEY - 10);
+    failures += check_range(slist, NUM_KEYS, FIRST_KEY + 500, FIRST_KEY);
+    failures += check_scan(slist, keys, 0, FIRST_KEY - 1, 16);
+    failures += check_scan(slist, keys, FIRST_KEY + 500, FIRST_KEY, 16);
+
+    // --- Test 3 -> Ranges at the boundaries of the list ---
+    std::cout << "--- Test 3 ---" << std::endl;
+    const uint32_t last_key = FIRST_KEY + (NUM_KEYS - 1) * KEY_STRIDE;
+    failures += check_range(slist, NUM_KEYS, 0, FIRST_KEY);
+    failures += check_range(slist, NUM_KEYS, FIRST_KEY, FIRST_KEY);
+    failures += check_range(slist, NUM_KEYS, 0, last_key);
+    failures += check_range(slist, NUM_KEYS, last_key, last_key);
+    failures += check_scan(slist, keys, 0, FIRST_KEY + 100, 16);
+    failures += check_scan(slist, keys, last_key, UINT32_MAX, 16);
+
+    // --- Test 4 -> Random ranges that contain at least one key ---
+    std::cout << "--- Test 4 ---" << std::endl;
+    std::mt19937 gen(42);
+    for (int i = 0; i < 10000; ++i)
+    {
+        const uint32_t first = gen() % NUM_KEYS;
+        const uint32_t last = first + gen() % (NUM_KEYS - first);
+        const uint32_t startKey = FIRST_KEY + first * KEY_STRIDE - gen() % KEY_STRIDE;
+        const uint32_t endKey = FIRST_KEY + last * KEY_STRIDE + gen() % KEY_STRIDE;
+        failures += check_range(slist, NUM_KEYS, startKey, endKey);
+    }
+
+    // --- Test 5 -> Scans that fill the buffer before the end of the range ---
+    std::cout << "--- Test 5 ---" << std::endl;
+    failures += check_scan(slist, keys, 0, last_key, 1);
+    failures += check_scan(slist, keys, FIRST_KEY + 5, last_key, 100);
+    failures += check_scan(slist, keys, FIRST_KEY, FIRST_KEY + 100 * KEY_STRIDE, 100);
+
+    // --- Test 6 -> Random scans, single and interleaved with AMAC ---
+    std::cout << "--- Test 6 ---" << std::endl;
+    const uint32_t capacity = 256;
+    std::vector<uint32_t> startKeys;
+    std::vector<uint32_t> endKeys;
+    for (int i = 0; i < 10000; ++i)
+    {
+        uint32_t startKey = gen() % (last_key + 2 * FIRST_KEY);
+        uint32_t endKey = startKey + gen() % (2 * capacity * KEY_STRIDE);
+        if (i % 8 == 0)
+        {
+            std::swap(startKey, endKey);
+        }
+        failures += check_scan(slist, keys, startKey, endKey, capacity);
+        startKeys.push_back(startKey);
+        endKeys.push_back(endKey);
+    }
+    for (uint32_t group_size : {0u, 1u, 8u, 64u})
+    {
+        failures += check_scans_amac(slist, startKeys, endKeys, capacity, group_size);
+    }
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " ranges failed" << std::endl;
+        return 1;
+    }
+    std::cout << "all ranges succeeded" << std::endl;
+    return 0;
+}
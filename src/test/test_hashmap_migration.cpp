@@ -0,0 +1,86 @@
+#include <iostream>
+#include <memory_resource>
+#include <vector>
+
+#include "hashmap.hpp"
+
+const size_t CAPACITY = 64;
+
+// Looks up all keys while the table is in the middle of an incremental migration.
+int check_keys(HashMap<uint32_t, uint32_t> &map, uint32_t num_keys, const char *phase)
+{
+    int failures = 0;
+    for (uint32_t key = 0; key < num_keys; ++key)
+    {
+        auto value = map.find(key);
+        if (!value || *value != key * 2)
+        {
+            std::cerr << phase << ": find(" << key << ") missed" << std::endl;
+            ++failures;
+        }
+    }
+
+    std::vector<uint32_t> keys(num_keys);
+    for (uint32_t key = 0; key < num_keys; ++key)
+    {
+        keys[key] = key;
+    }
+    std::vector<uint32_t> results(num_keys);
+    std::vector<bool> found;
+    map.vectorized_get(keys, results, found);
+    for (uint32_t key = 0; key < num_keys; ++key)
+    {
+        if (!found[key] || results[key] != key * 2)
+        {
+            std::cerr << phase << ": vectorized_get(" << key << ") missed" << std::endl;
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+int main()
+{
+    PrefetchProfiler profiler{30};
+    std::pmr::memory_resource &mem_res = *std::pmr::new_delete_resource();
+    HashMap<uint32_t, uint32_t> map{CAPACITY, profiler, mem_res, 1.0};
+
+    int failures = 0;
+
+    // --- Test 1 -> The 65th insert exceeds the load factor and starts a migration ---
+    std::cout << "--- Test 1 ---" << std::endl;
+    for (uint32_t key = 0; key <= CAPACITY; ++key)
+    {
+        map.insert(key, key * 2);
+    }
+    failures += check_keys(map, CAPACITY + 1, "after growth");
+
+    // --- Test 2 -> Updates of existing keys during the migration must not duplicate them ---
+    std::cout << "--- Test 2 ---" << std::endl;
+    for (uint32_t key = 0; key <= CAPACITY; ++key)
+    {
+        map.insert(key, key * 2);
+    }
+    if (map.getSize() != CAPACITY + 1)
+    {
+        std::cerr << "size is " << map.getSize() << " instead of " << CAPACITY + 1 << std::endl;
+        ++failures;
+    }
+    failures += check_keys(map, CAPACITY + 1, "after updates");
+
+    // --- Test 3 -> Further inserts finish the migration ---
+    std::cout << "--- Test 3 ---" << std::endl;
+    for (uint32_t key = CAPACITY + 1; key < 4 * CAPACITY; ++key)
+    {
+        map.insert(key, key * 2);
+    }
+    failures += check_keys(map, 4 * CAPACITY, "after migration");
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " lookups failed" << std::endl;
+        return 1;
+    }
+    std::cout << "all lookups succeeded" << std::endl;
+    return 0;
+}